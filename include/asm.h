@@ -4,11 +4,13 @@
 
 /*      DECLARAÇÕES DAS FUNÇÕES      */
 int constCheck (std::string&, int&);
-int spaceCommand (std::stringstream&, std::string&, std::vector<int>&, int&, std::vector<Label>&, int&);
-int constCommand (std::stringstream&, std::string&, std::vector<int>&, int&, std::vector<Label>&, int&);
-int assembleInstr (Instr&, int&, std::vector<int>&, std::vector<Label>&, std::stringstream&, std::vector<Instr>&, std::vector<Dir>&, int&);
-std::vector<int> asmParser (std::ifstream&, std::vector<Label>&, int&, int&, std::vector<int>&, std::vector<Instr>&, std::vector<Dir>&, int&, int&, std::vector<int>&, std::vector<std::string>&, std::vector<Error>&);
-void assembleCode (std::string, std::string, std::vector<int>&, std::vector<Instr>&, std::vector<Dir>&,std::vector<Error>&);
+int spaceCommand (TokenStream&, std::string_view, std::uint32_t, std::vector<int>&, int&, SymbolTable&, int&);
+int constCommand (TokenStream&, std::string_view, std::uint32_t, std::vector<int>&, int&, SymbolTable&, int&);
+int assembleInstr (Instr&, int&, std::vector<int>&, SymbolTable&, TokenStream&, Tables&, int&);
+void asmParser (TokenLine, SymbolTable&, int&, int&, const LineDict&, Tables&, int&, int&, std::vector<int>&, std::vector<Error>&);
+int resolveCode (SymbolTable&, std::vector<int>&, const LineDict&, std::pmr::vector<std::string_view>&, std::vector<Error>&, std::vector<int>* = nullptr, std::vector<int>* = nullptr);
+std::size_t writeCode (std::string, std::vector<int>&, int, int, int);
+void assembleCode (McrState&, PreState&, std::string, Tables&, std::vector<Error>&, int);
 
 
 
@@ -64,12 +66,12 @@ spaceCommand: executa a diretiva space, e configura o rótulo
 entrada:
 saida: codigo de erro
 */
-int spaceCommand (std::stringstream &lineStream, std::string &labelName, std::vector<int> &partialMachineCode, int &addrCounter, std::vector<Label> &labelList, int& pos) {
+int spaceCommand (TokenStream &lineStream, std::string_view labelName, std::uint32_t labelId, std::vector<int> &partialMachineCode, int &addrCounter, SymbolTable &labelList, int& pos) {
     
     int amount; // número de espaços a serem reservados
     
     // token do argumento
-    std::string token2;
+    std::string_view token2;
     lineStream >> token2;
     
     pos = 6;
@@ -86,7 +88,7 @@ int spaceCommand (std::stringstream &lineStream, std::string &labelName, std::ve
     }
     
     // extrai novo token 
-    std::string token3;
+    std::string_view token3;
     lineStream >> token3;
     
     pos += token2.size() + 1;
@@ -95,9 +97,10 @@ int spaceCommand (std::stringstream &lineStream, std::string &labelName, std::ve
     if (!token3.empty())
         return -3;
     
-    for (int i = 0; i < amount; ++i) { // coloca a reserva no codigo de maquina
-        partialMachineCode.push_back(0);
-        addrCounter++;
+    // coloca a reserva no codigo de maquina de uma vez
+    if (amount > 0) {
+        partialMachineCode.insert(partialMachineCode.end(), amount, 0);
+        addrCounter += amount;
     }
     
     pos = 0;
@@ -108,11 +111,10 @@ int spaceCommand (std::stringstream &lineStream, std::string &labelName, std::ve
         
     } else {
         // procura o rótulo e ajusta as características
-        for (unsigned int i = 0; i < labelList.size(); ++i) {
-            if (labelList[i].name == labelName) {
-                labelList[i].isConst = 0;
-                labelList[i].vectSize = amount;
-            }
+        int found = labelList.find(labelId);
+        if (found >= 0) {
+            labelList[found].isConst = 0;
+            labelList[found].vectSize = amount;
         }
     }
     
@@ -127,12 +129,12 @@ constCommand: executa a diretiva const, e configura o rótulo
 entrada:
 saida: codigo de erro
 */
-int constCommand (std::stringstream &lineStream, std::string &labelName, std::vector<int> &partialMachineCode, int &addrCounter, std::vector<Label> &labelList, int& pos) {
+int constCommand (TokenStream &lineStream, std::string_view labelName, std::uint32_t labelId, std::vector<int> &partialMachineCode, int &addrCounter, SymbolTable &labelList, int& pos) {
     
     int constant;
     
     // le o proximo token
-    std::string token2;
+    std::string_view token2;
     lineStream >> token2;
     
     pos = 6;
@@ -142,15 +144,16 @@ int constCommand (std::stringstream &lineStream, std::string &labelName, std::ve
     if (token2.empty()) // checa se foi dado um argumento
         return -1;
         
-    int status = constCheck (token2, constant); // checa se é um numero valido
+    std::string value (token2); // constCheck precisa de uma string que pode ser reescrita (hexa terminado em 'H')
+    int status = constCheck (value, constant); // checa se é um numero valido
     if (status == 0)
         return -2;
         
     // le mais um token
-    std::string token3;
+    std::string_view token3;
     lineStream >> token3;
     
-    pos += token2.size() + 1;
+    pos += value.size() + 1;
     
     // se conseguir ler, o numero de argumento eh invalido
     if (!token3.empty())
@@ -166,14 +169,13 @@ int constCommand (std::stringstream &lineStream, std::string &labelName, std::ve
     
     // se foi, arruma o rotulo
     } else {
-        for (unsigned int i = 0; i < labelList.size(); ++i) {
-            if (labelList[i].name == labelName) {
-                if (constant == 0)
-                    labelList[i].isConst = 2; // 2 indica que é zero
-                else
-                    labelList[i].isConst = 1;
-                labelList[i].vectSize = 1;
-            }
+        int found = labelList.find(labelId);
+        if (found >= 0) {
+            if (constant == 0)
+                labelList[found].isConst = 2; // 2 indica que é zero
+            else
+                labelList[found].isConst = 1;
+            labelList[found].vectSize = 1;
         }
     }
         
@@ -188,7 +190,7 @@ assembleInstr: le a instrucao e seus argumentos, e passa para codigo de maquina
 entrada:
 saida: codigo de erro da montagem
 */
-int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMachineCode, std::vector<Label> &labelList, std::stringstream &lineStream, std::vector<Instr> &instrList, std::vector<Dir> &dirList, int &pos) {
+int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMachineCode, SymbolTable &labelList, TokenStream &lineStream, Tables &tables, int &pos) {
     
     // salva o codigo de maquina da instrucao
     partialMachineCode.push_back(instr.opcode);
@@ -201,9 +203,10 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
     // le os argumentos esperados pela funcao
     for (int i = 0; i < instr.numArg; ++i) {
         
-        // le um token
-        std::string token;
+        // le um token (o identificador eh o do nome sem ':' ou ',' no final, que eh o que chega na busca pelo rotulo)
+        std::string_view token;
         lineStream >> token;
+        std::uint32_t tokenId = lineStream.id();
         
         // retorna -1 se faltam argumentos (token vazio antes de chegar ao final do for)
         if (token.empty()) // pos += 0
@@ -243,7 +246,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
             // se no final do token tiver virgula
             if (token.back() == ',') {
                 
-                token.pop_back(); // tira a virgula
+                token.remove_suffix(1); // tira a virgula
                 
                 if (token.empty()) // pos += 0
                     return -20; // se tiver colocado só uma vírgula
@@ -254,7 +257,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                     return -16;
                 
                 aux = 0;
-                int valid = labelCheck(token, instrList, dirList, aux); // procura erros no rotulo
+                int valid = labelCheck(token, tables, aux); // procura erros no rotulo
                 if (valid <= -1 && valid >= -4) {
                     pos += aux;
                     return valid-8;
@@ -273,7 +276,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                     return -16;
                 
                 aux = 0;
-                int valid = labelCheck(token, instrList, dirList, aux); // procura erros no rotulo
+                int valid = labelCheck(token, tables, aux); // procura erros no rotulo
                 if (valid <= -1 && valid >= -4) {
                     pos += aux;
                     return valid-8;
@@ -283,7 +286,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                 pos = pos + token.size() + 1;
                 
                 // le o proximo token (esperado que seja um +)
-                std::string token2;
+                std::string_view token2;
                 lineStream >> token2;
                 
                 if (token2.empty()) // pos += 0
@@ -294,7 +297,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                     
                 else if (token2 != "+") {
                     int auxPos;
-                    int valid = labelCheck(token2, instrList, dirList, auxPos); // procura erros no rotulo
+                    int valid = labelCheck(token2, tables, auxPos); // procura erros no rotulo
                     if (valid == 0) // pos += 0
                         return -7; // faltando virgula entre os operandos
                     else {
@@ -306,7 +309,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                 }
                 
                 // le o proximo token (esperado que seja um numero valido)
-                std::string token3;
+                std::string_view token3;
                 lineStream >> token3;
                 
                 // ajeita a posicao de novo
@@ -317,7 +320,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                 
                 // esperado que tenha uma virgula depois do numero
                 if (token3.back() == ',') {
-                    token3.pop_back();
+                    token3.remove_suffix(1);
                     if (token3.empty()) // pos += 0
                         return -13;
                     int status = integerCheck (token3, offset);
@@ -330,7 +333,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                     if ((status == 1 && offset < 0) || status == 0)  // tem que ser maior ou igual a 0
                         return -8; // pos += 0
                     //  se for valido, le o proximo token (esse token ta errado de qualquer forma)
-                    std::string token4;
+                    std::string_view token4;
                     lineStream >> token4;
                     pos = pos + token3.size() + 1;
                     if (token4.empty()) // pos += 0
@@ -372,7 +375,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
             
             // se no final tiver virgula, ve se foi colocado mais um argumento (invalido)
             if (token.back() == ',') {
-                std::string token2;
+                std::string_view token2;
                 lineStream >> token2;
                 if (!token2.empty()) {
                     pos = pos + token.size() + 1;
@@ -387,7 +390,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
             
             // procura erros no rotulo
             aux = 0;
-            int valid = labelCheck(token, instrList, dirList, aux);
+            int valid = labelCheck(token, tables, aux);
             if (valid <= -1 && valid >= -4) {
                 pos += aux;
                 return valid-8;    
@@ -396,13 +399,13 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
             pos = pos + token.size() + 1;
             
             // le o proximo token
-            std::string token2;
+            std::string_view token2;
             lineStream >> token2;
             
             if (token2 == "+" && !token2.empty()) {
                 
                 // le mais um token
-                std::string token3;
+                std::string_view token3;
                 lineStream >> token3;
                 
                 pos = pos + token2.size() + 1;
@@ -416,7 +419,7 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                 int popped = 0;
                 if (token3.back() == ',') {
                     popped = 1;
-                    token3.pop_back();
+                    token3.remove_suffix(1);
                 }    
                 
                 // verica se o numero eh valido
@@ -425,11 +428,11 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                     return -8;
                 
                 if (popped) 
-                    token3.push_back(',');
+                    token3 = std::string_view(token3.data(), token3.size()+1); // devolve a virgula
                     
                 // se no final tiver virgula, ve se foi colocado mais um argumento (invalido)
                 if (token3.back() == ',') {
-                    std::string token4;
+                    std::string_view token4;
                     lineStream >> token4;
                     if (!token4.empty()) {
                         pos = pos + token3.size() + 1;
@@ -444,16 +447,16 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
                 
                 // checa se esta tentando declarar outro rotulo
                 if (token2.back() == ':') {
-                    token2.pop_back();
+                    token2.remove_suffix(1);
                     int aux;
-                    int valid = labelCheck(token2, instrList, dirList, aux);
+                    int valid = labelCheck(token2, tables, aux);
                     if (valid == 0) // se for um rotulo valido, estava tentando declarar dois rotulos
                         return -17; // pos += 0
                     else // se nao era, operacao de indexacao invalida
                         return -6; // pos += 0
                 } else {
                     int aux;
-                    int valid = labelCheck(token2, instrList, dirList, aux); // checa se eh um rotulo valido
+                    int valid = labelCheck(token2, tables, aux); // checa se eh um rotulo valido
                     if (valid == 0) // pos += 0
                         return -1; // se for, numero de argumento invalido
                     else // pos += 0
@@ -471,92 +474,62 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
             argPos = secArgPos;
         
         // procura o token na tabela de simbolos
-        int found = -1;
-        for (unsigned int i = 0; (i < labelList.size()) && (found < 0); ++i) {
-            if (token == labelList[i].name)
-                found = i;
-        }
+        int found = labelList.find(tokenId);
         
-        // se nao ta na tabela, bota na tabela e coloca a pendencia
-        if (found < 0) {
-            
-            Label label;
-            label.name = token;
-            label.isDefined = 0;
+        // se nao ta na tabela ou ainda nao foi definido, coloca a pendencia (a tabela cria o rotulo se preciso)
+        if (found < 0 || !labelList[found].isDefined) {
             
+            int auxInfo;
             if (instr.name == "DIV")
-                label.auxInfoList.push_back(1); // 1 indica instrucao de divisao
+                auxInfo = 1; // 1 indica instrucao de divisao
             else if (instr.name == "JMP" || instr.name == "JMPP" || instr.name == "JMPN" || instr.name == "JMPZ")
-                label.auxInfoList.push_back(2); // 2 indica instrucao de pulo
+                auxInfo = 2; // 2 indica instrucao de pulo
             else if ((instr.name == "COPY" && i == 1) || instr.name == "STORE" || instr.name == "INPUT")
-                label.auxInfoList.push_back(3); // 3 indica instrucao modificando a memoria
+                auxInfo = 3; // 3 indica instrucao modificando a memoria
             else
-                label.auxInfoList.push_back(0); // 0 indica instrucao padrao
+                auxInfo = 0; // 0 indica instrucao padrao
             
-            label.posList.push_back(argPos);
-                
-            label.pendList.push_back(addrCounter);
-            labelList.push_back(label);
-            partialMachineCode.push_back(offset);
+            partialMachineCode.push_back(labelList.addPending(tokenId, addrCounter, auxInfo, argPos, offset));
             
         } else {
             
-            // se ta na tabela e nao ta definido, coloca mais uma pendencia
-            if (!labelList[found].isDefined) {
-                
-                if (instr.name == "DIV")
-                    labelList[found].auxInfoList.push_back(1); // 1 indica instrucao de divisao
-                else if (instr.name == "JMP" || instr.name == "JMPP" || instr.name == "JMPN" || instr.name == "JMPZ")
-                    labelList[found].auxInfoList.push_back(2); // 2 indica instrucao de pulo
-                else if ((instr.name == "COPY" && i == 1) || instr.name == "STORE" || instr.name == "INPUT")
-                    labelList[found].auxInfoList.push_back(3); // 3 indica instrucao modificando a memoria
-                else
-                    labelList[found].auxInfoList.push_back(0); // 0 indica instrucao padrao
-                
-                labelList[found].posList.push_back(argPos);
-                    
-                labelList[found].pendList.push_back(addrCounter);
-                partialMachineCode.push_back(offset);
-            }
-            
             // se ta na tabela e ta definido, ja indica os problemas e copia o endereço no codigo de maquina
-            else {
-                
-                int posBkp = pos;
-                pos = argPos;
-                
-                if (instr.name == "DIV") {
-                    if (labelList[found].isConst == 2)
-                        return -3; // -3 indica divisao por zero
-                } else if (instr.name == "JMP" || instr.name == "JMPP" || instr.name == "JMPN" || instr.name == "JMPZ") {
-                    if (labelList[found].vectSize != 0) // vectSize = 0 indica que o rotulo é da seção de texto
-                        return -4; // -4 indica pulo para a seção de dados
-                } else if ((instr.name == "COPY" && i == 1) || instr.name == "STORE" || instr.name == "INPUT") {
-                    if (labelList[found].isConst != 0)
-                        return -5; // -5 indica tentativa de modificar valor constante
-                }
-                        
-                // o acesso a memoria não pode usar um rótulo da seção de texto
-                if (labelList[found].vectSize == 0 && instr.name != "JMP" && instr.name != "JMPP" && instr.name != "JMPN" && instr.name != "JMPZ")
-                    return -14;
-                
-                pos = pos + token.size() + 1 + 1 + 1;
+            int posBkp = pos;
+            pos = argPos;
+            
+            if (instr.name == "DIV") {
+                if (labelList[found].isConst == 2)
+                    return -3; // -3 indica divisao por zero
+            } else if (instr.name == "JMP" || instr.name == "JMPP" || instr.name == "JMPN" || instr.name == "JMPZ") {
+                if (labelList[found].vectSize != 0) // vectSize = 0 indica que o rotulo é da seção de texto
+                    return -4; // -4 indica pulo para a seção de dados
+            } else if ((instr.name == "COPY" && i == 1) || instr.name == "STORE" || instr.name == "INPUT") {
+                if (labelList[found].isConst != 0)
+                    return -5; // -5 indica tentativa de modificar valor constante
+            }
                     
-                // nao se pode usar offset com pulos
-                if (instr.opcode >= 5 && instr.opcode <= 8) {
-                    if (offset != 0)
-                        return -15;
-                }
-                
-                // checa se o tamanho do rotulo bate com o indice n (rotulo + n)
-                if (offset >= labelList[found].vectSize && labelList[found].vectSize > 0)
-                    return -(found+21); // retorna onde ta o rotulo
+            // o acesso a memoria não pode usar um rótulo da seção de texto
+            if (labelList[found].vectSize == 0 && instr.name != "JMP" && instr.name != "JMPP" && instr.name != "JMPN" && instr.name != "JMPZ")
+                return -14;
+            
+            pos = pos + token.size() + 1 + 1 + 1;
                 
-                pos = posBkp;
-                int address = labelList[found].value;
-                partialMachineCode.push_back(address+offset);
+            // nao se pode usar offset com pulos
+            if (instr.opcode >= 5 && instr.opcode <= 8) {
+                if (offset != 0)
+                    return -15;
             }
             
+            // checa se o tamanho do rotulo bate com o indice n (rotulo + n)
+            if (offset >= labelList[found].vectSize && labelList[found].vectSize > 0)
+                return -(found+21); // retorna onde ta o rotulo
+            
+            pos = posBkp;
+            int address = labelList[found].value;
+            if (!labelList.chained)
+                labelList.resolvedList.push_back(addrCounter);
+            partialMachineCode.push_back(address+offset);
+            
         }
         
         addrCounter++;
@@ -564,14 +537,14 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
     }
     
     // le mais um token
-    std::string token2;
+    std::string_view token2;
     lineStream >> token2;
     
     // checa se esta tentando declarar outro rotulo
-    if (token2.back() == ':') {
-        token2.pop_back();
+    if (!token2.empty() && token2.back() == ':') {
+        token2.remove_suffix(1);
         int auxPos;
-        int valid = labelCheck(token2, instrList, dirList, auxPos);
+        int valid = labelCheck(token2, tables, auxPos);
         if (valid == 0) // se for um rotulo valido, estava tentando declarar dois rotulos
             return -17; // pos += 0
         else // se nao era, so fala que o rotulo é invalido
@@ -589,38 +562,36 @@ int assembleInstr (Instr &instr, int &addrCounter, std::vector<int> &partialMach
 
 /*
 asmParser: traduz uma linha em código máquina
-entrada:
-saida: código de máquina parcial num vetor de inteiros
+entrada: linha a ser montada com os tokens dela (vinda da passagem de macros), o estado da montagem e o codigo de maquina
+saida: nenhuma (código de máquina da linha anexado ao final do codigo de maquina)
 */
-std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelList, int &lineCounter, int &addrCounter, std::vector<int> &lineDict, std::vector<Instr> &instrList, std::vector<Dir> &dirList, int &section, int &sectionText, std::vector<int> &addrDict, std::vector<std::string> &lines, std::vector<Error> &errorList) {
-    
-    std::vector<int> partialMachineCode;
+void asmParser (TokenLine tokenLine, SymbolTable &labelList, int &lineCounter, int &addrCounter, const LineDict &lineDict, Tables &tables, int &section, int &sectionText, std::vector<int> &machineCode, std::vector<Error> &errorList) {
     
-    // le a proxima linha
-    std::string line;
-    getline (mcrFile, line);
-    std::stringstream lineStream (line);
+    // o codigo da linha vai direto para o final do codigo de maquina (sem um vetor novo por linha), e as pendencias feitas nela guardam a linha
+    labelList.lineNum = lineCounter;
     
-    // salva a linha do arquivo (para uso no final da execucao, para mostrar alguns erros
-    lines.push_back(line);
+    std::string_view line = tokenLine.text;
+    TokenStream lineStream (tokenLine);
     
     // nao le a ultima linha em branco do arquivo
     if (line.empty())
-        return partialMachineCode;
+        return;
     
-    std::string token;
+    std::string_view token;
     lineStream >> token;
     
-    std::string labelNameBackup;
+    std::string_view labelNameBackup;
+    std::uint32_t labelId = NO_SYMBOL;
     
     int colon = 0;
+    int cmdColumn = 0; // posicao do comando na linha (depois do rotulo, se tiver)
     
-    if (token.back() == ':') {
+    if (lineStream.kind() == TOKEN_LABEL) {
         
         // verifica se o rótulo é válido
-        token.pop_back();
+        token.remove_suffix(1);
         int pos = 0;
-        int valid = labelCheck(token, instrList, dirList, pos);
+        int valid = labelCheck(token, tables, pos);
         if (valid == -1)
             errorList.push_back(Error("tamanho do rótulo deve ser menor ou igual a 100 caracteres", "léxico", lineDict[lineCounter-1], line, pos));
         else if (valid == -2)
@@ -634,42 +605,14 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
         
         if (!token.empty()) {
             
-            // verifica se o rótulo já está na lista de rótulos e se já foi definido
-            int alreadyDefined = 0;
-            int alreadyMentioned = 0;
-            int labelPos = -1;
-            for (unsigned int i = 0; i < labelList.size(); ++i) {
-                if (labelList[i].name == token) {
-                    alreadyMentioned = 1;
-                    labelPos = i;
-                    if (labelList[i].isDefined)
-                        alreadyDefined = 1;
-                }
-            }
+            // define o rotulo na tabela de simbolos (se ja tiver sido mencionado, resolve a entrada pendente)
+            labelId = lineStream.id();
+            int labelPos = labelList.define(labelId, addrCounter);
             
             // ja foi definido (da erro de simbolo ja definido)
-            if (alreadyDefined) {
+            if (labelPos < 0) {
                 int pos = 0;
                 errorList.push_back(Error("símbolo já definido", "semântico", lineDict[lineCounter-1], line, pos));
-            }   
-                
-            // nao foi definido mas ja foi mencionado (define ele agora)
-            else if (alreadyMentioned) {
-                labelList[labelPos].value = addrCounter;
-                labelList[labelPos].isDefined = 1;
-                labelList[labelPos].vectSize = 0; // indica que é rotulo da area de texto (pode mudar se for chamada uma diretiva da área de dados)
-                labelList[labelPos].isConst = 0;
-            }
-            
-            // nunca foi chamado nem definido (acrescenta novo rotulo definido)
-            else {
-                Label label;
-                label.name = token;
-                label.value = addrCounter;
-                label.isDefined = 1;
-                label.vectSize = 0;
-                label.isConst = 0;
-                labelList.push_back(label);
             }
             
             // salva o nome do rotulo
@@ -679,36 +622,25 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
             colon = 1;
         
         // coloca um novo token no lugar do rótulo, que já foi processado
+        cmdColumn = lineStream.nextColumn();
         lineStream >> token;
         
         // ja checa pra ver se não é mais um rótulo
-        if (token.back() == ':') {
-            int pos = labelNameBackup.size()+1 + 1;
+        if (!token.empty() && token.back() == ':') {
+            int pos = cmdColumn;
             errorList.push_back(Error ("mais de um rótulo em uma linha", "sintático", lineDict[lineCounter-1], line, pos));
         }
         
     }
     
     // agora que lidou com os possiveis rotulos, analisa o primeiro token e ve se é instrucao ou diretiva
-    int isInstruction = -1;
-    for (unsigned int i = 0; i < instrList.size(); ++i) {
-        if (token == instrList[i].name)
-            isInstruction = i;
-    }
-    int isDirective = -1;
-    for (unsigned int i = 0; i < dirList.size(); ++i) {
-        if (token == dirList[i].name)
-            isDirective = i;
-    }
+    int isInstruction = tables.findInstr(token);
+    int isDirective = tables.findDir(token);
     
     // se nao encontrar o comando em nenhuma tabela, nao é um comando reconhecido
     if (isInstruction == -1 && isDirective == -1) {
-        if (token.back() != ':') {
-            int pos = 0;
-            if (!labelNameBackup.empty())
-                pos = labelNameBackup.size()+1 + 1;
-            else if (colon)
-                pos += 2;
+        if (token.empty() || token.back() != ':') {
+            int pos = cmdColumn;
             errorList.push_back(Error("comando não reconhecido", "léxico", lineDict[lineCounter-1], line, pos));
         }
             
@@ -716,14 +648,10 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
         
         // se for uma instrução, monta
         if (isInstruction >= 0) {
-            int pos = 0;
-            if (!labelNameBackup.empty())
-                pos = labelNameBackup.size()+1 + 1;
-            else if (colon)
-                pos += 2;
-            Instr instr = instrList[isInstruction];
-            pos += instr.name.size()+1;
-            int status = assembleInstr (instr, addrCounter, partialMachineCode, labelList, lineStream, instrList, dirList, pos);
+            int pos = cmdColumn;
+            Instr &instr = tables.instrList[isInstruction];
+            pos = cmdColumn + token.size()+1; // primeiro argumento (se a linha so tiver o rotulo, o token continua sendo o nome dele)
+            int status = assembleInstr (instr, addrCounter, machineCode, labelList, lineStream, tables, pos);
             if (status == -1) {
                 if (instr.numArg == 0)
                     errorList.push_back(Error("não é esperado nenhum argumento para "+instr.name, "sintático", lineDict[lineCounter-1], line, pos));
@@ -771,22 +699,18 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
                 errorList.push_back(Error ("é esperado um argumento antes da vírgula", "sintático", lineDict[lineCounter-1], line, pos));
             else if (status <= -21) {
                 int labelPos = -(status+21); // recupera a posicao do rotulo
-                errorList.push_back(Error ("indíce excede o tamanho do vetor "+labelList[labelPos].name, "semântico", lineDict[lineCounter-1], line, pos));
+                errorList.push_back(Error ("indíce excede o tamanho do vetor "+std::string(labelList.name(labelPos)), "semântico", lineDict[lineCounter-1], line, pos));
             }
                 
             if (section != 0) {
-                int pos = 0;
-                if (!labelNameBackup.empty())
-                    pos = labelNameBackup.size()+1 + 1;
-                else if (colon)
-                    pos += 2;
+                int pos = cmdColumn;
                 errorList.push_back(Error("instruções devem estar na seção de texto", "semântico", lineDict[lineCounter-1], line, pos));
             }
             
         // se for uma diretiva, faz uma função específica
         } else if (isDirective >= 0) {
             
-            Dir dir = dirList[isDirective];
+            Dir &dir = tables.dirList[isDirective];
             
             // se for SECTION, atualiza a informação da seção
             if (dir.name == "SECTION") {
@@ -796,26 +720,21 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
                     errorList.push_back(Error("não podem ser declarados rótulos em seções", "sintático", lineDict[lineCounter-1], line, pos));
                 }
                 
-                std::string token2;
+                int pos = cmdColumn + token.size()+1;
+                std::string_view token2;
                 lineStream >> token2;
                 if (token2 == "TEXT") {
                     section = 0;
                     sectionText = 0;
                 } else if (token2 == "DATA")
                     section = 1;
-                else {
-                    int pos = token.size()+1;
-                    if (!labelNameBackup.empty())
-                        pos += labelNameBackup.size()+1 + 1;
-                    else if (colon)
-                        pos += 2;
+                else
                     errorList.push_back(Error("seção não reconhecida", "sintático", lineDict[lineCounter-1], line, pos));
-                }
             
             // se for SPACE, verifica os argumentos e coloca no código de máquina as reservas
             } else if (dir.name == "SPACE") {
                 int pos = 0;
-                int status = spaceCommand (lineStream, labelNameBackup, partialMachineCode, addrCounter, labelList, pos);
+                int status = spaceCommand (lineStream, labelNameBackup, labelId, machineCode, addrCounter, labelList, pos);
                 if (colon)
                     pos += 2;
                 if (status == -1)
@@ -826,11 +745,7 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
                     errorList.push_back(Error("é esperado um ou nenhum argumento para SPACE", "léxico", lineDict[lineCounter-1], line, pos));
                     
                 if (section != 1) {
-                    int pos = 0;
-                    if (!labelNameBackup.empty())
-                        pos = labelNameBackup.size()+1 + 1;
-                    else if (colon)
-                        pos += 2;
+                    int pos = cmdColumn;
                     errorList.push_back(Error("SPACE deve estar na seção de dados", "semântico", lineDict[lineCounter-1], line, pos));
                 }
                     
@@ -838,7 +753,7 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
             // se for CONST, verifica o argumento e salva no código de máquina
             } else if (dir.name == "CONST") {
                 int pos = 0;
-                int status = constCommand (lineStream, labelNameBackup, partialMachineCode, addrCounter, labelList, pos);
+                int status = constCommand (lineStream, labelNameBackup, labelId, machineCode, addrCounter, labelList, pos);
                 if (colon)
                     pos += 2;
                 if (status == -1)
@@ -849,11 +764,7 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
                     errorList.push_back(Error("a diretiva CONST precisa ser precedida de um rótulo", "sintático", lineDict[lineCounter-1], line, pos));
                     
                 if (section != 1) {
-                    int pos = 0;
-                    if (!labelNameBackup.empty())
-                        pos = labelNameBackup.size()+1 + 1;
-                    else if (colon)
-                        pos += 2;
+                    int pos = cmdColumn;
                     errorList.push_back(Error("CONST deve estar na seção de dados", "semântico", lineDict[lineCounter-1], line, pos));
                 }
                       
@@ -861,12 +772,154 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
         }
     }
     
-    // coloca os endereços no dicionario de endereços
-    for (unsigned int i = 0; i < partialMachineCode.size(); ++i)
-        addrDict.push_back(lineCounter);
+}
+
+
+
+/*
+resolveCode: resolve as pendências no código de máquina (as da tabela e as encadeadas no proprio codigo) e reporta os erros que só podem ser vistos no final
+entrada: tabela de simbolos (com a linha de cada pendencia), codigo de maquina, dicionario de linhas, linhas da saida das macros (vazio se nao estiverem em memoria:
+os erros ficam sem o texto da linha), lista de erros e, se pedidas, listas onde vao a linha da saida das macros e o endereco da referencia de cada erro reportado
+saida: numero de pendencias resolvidas (codigo de maquina completo)
+*/
+int resolveCode (SymbolTable &labelList, std::vector<int> &machineCode, const LineDict &lineDict, std::pmr::vector<std::string_view> &lines, std::vector<Error> &errorList, std::vector<int> *errorLines, std::vector<int> *errorAddresses) {
     
-    return partialMachineCode;
+    int numResolved = 0;
     
+    // confere e resolve uma pendencia do rotulo i. a linha e a coluna da referencia so sao procuradas (where) se houver erro
+    auto resolve = [&] (int i, int address, int auxInfo, int offset, auto where) {
+        
+        // reporta um erro na linha da pendencia, deslocado da posição do rótulo na linha
+        auto report = [&] (std::string message, int shift) {
+            int mcrLine, argPos;
+            where(mcrLine, argPos);
+            errorList.push_back(Error (std::move(message), "semântico", lineDict[mcrLine-1], ((int) lines.size() >= mcrLine) ? lines[mcrLine-1] : std::string_view(), argPos + shift));
+            if (errorLines)
+                errorLines->push_back(mcrLine);
+            if (errorAddresses)
+                errorAddresses->push_back(address);
+        };
+        
+        // sem definicao, a palavra fica so com o deslocamento
+        machineCode[address] = offset;
+        
+        if (!labelList[i].isDefined) { // rotulo nunca foi definido
+            report("rótulo "+std::string(labelList.name(i))+" não definido", 0);
+            return;
+        }
+        
+        if (auxInfo == 1) { // é uma divisão
+            if (labelList[i].isConst == 2)
+                report("divisão por zero", 0);
+        } else if (auxInfo == 2) { // é um pulo
+            if (labelList[i].vectSize != 0)
+                report("pulo para seção inválida", 0);
+        } else if (auxInfo == 3) { // tá modificando o rótulo
+            if (labelList[i].isConst != 0)
+                report("valores constantes não podem ser modificados", 0);
+        }
+        
+        // se não for pulo, não pode acessar a área de texto
+        if (labelList[i].vectSize == 0 && auxInfo != 2)
+            report("acesso à seção de texto só é permitido para pulos", 0);
+        
+        int shift = labelList.name(i).size() + 1 + 1 + 1;
+        
+        // nao se pode usar offset com pulos
+        if (auxInfo == 2 && offset != 0)
+            report("o deslocamento de pulos deve ser zero", shift);
+        
+        // checa se o tamanho do rotulo bate com o indice n (rotulo + n)
+        if (offset >= labelList[i].vectSize && auxInfo != 2 && labelList[i].vectSize > 0)
+            report("indíce excede o tamanho do vetor "+std::string(labelList.name(i)), shift);
+        
+        machineCode[address] = labelList[i].value+offset;
+        numResolved++;
+        
+    };
+    
+    // pendencias da tabela: agrupa por rotulo, para os erros sairem na mesma ordem (rotulo por rotulo) e a varredura ser uma so
+    FixupTable &fixups = labelList.fixups;
+    fixups.sortByLabel(labelList.size());
+    for (int k = 0; k < fixups.size(); ++k)
+        resolve(fixups.label[k], fixups.address[k], fixups.kind[k], machineCode[fixups.address[k]], [&] (int &mcrLine, int &argPos) { mcrLine = fixups.line[k]; argPos = fixups.column[k]; });
+    
+    // pendencias encadeadas: cada elo so eh conhecido depois de ler o anterior, entao as cadeias de varios rotulos sao percorridas juntas, um elo de cada por vez,
+    // para as leituras de cadeias diferentes nao esperarem umas pelas outras. depois resolve rotulo por rotulo, na ordem em que as referencias foram feitas
+    const int group = 16; // cadeias percorridas juntas
+    ChainTable &refs = labelList.refs;
+    std::vector<int> chain[group]; // enderecos de cada cadeia do grupo, da referencia mais nova para a mais antiga
+    int member[group], next[group]; // rotulo de cada cadeia do grupo e proximo elo a ler (-1: cadeia terminou)
+    int i = 0;
+    while (i < labelList.size()) {
+        
+        // junta os proximos rotulos com pendencias
+        int size = 0, active = 0;
+        for (; i < labelList.size() && size < group; ++i) {
+            if (labelList[i].chain < 0)
+                continue;
+            member[size] = i;
+            next[size] = labelList[i].chain;
+            chain[size].clear();
+            labelList[i].chain = -1;
+            size++;
+            active++;
+        }
+        
+        // percorre as cadeias do grupo
+        while (active > 0) {
+            for (int g = 0; g < size; ++g) {
+                if (next[g] < 0)
+                    continue;
+                chain[g].push_back(next[g]);
+                next[g] = ChainTable::prev(machineCode[next[g]]);
+                if (next[g] < 0)
+                    active--;
+            }
+        }
+        
+        // resolve na ordem dos rotulos
+        for (int g = 0; g < size; ++g) {
+            for (int k = chain[g].size()-1; k >= 0; --k) {
+                int address = chain[g][k], word = machineCode[address];
+                int offset = ChainTable::hasOffset(word) ? refs.offsetAt(address) : 0;
+                resolve(member[g], address, ChainTable::kind(word), offset, [&] (int &mcrLine, int &argPos) { int r = refs.find(address); mcrLine = refs.line[r]; argPos = refs.column[r]; });
+            }
+        }
+        
+    }
+    
+    return numResolved;
+}
+
+
+
+/*
+writeCode: escreve o codigo de maquina final no arquivo '.o', em texto (numeros separados por espaco) ou no formato binario
+entrada: nome do arquivo de saida, codigo de maquina, formato (0: texto, 1: binario), endereco do comeco da secao de texto e da secao de dados (-1 se nao houver)
+saida: numero de bytes escritos
+*/
+std::size_t writeCode (std::string outFileName, std::vector<int> &machineCode, int binary, int textAddr, int dataAddr) {
+    
+    if (binary) {
+        // a secao de texto vai do seu comeco ate o comeco da secao de dados (se vier depois) ou ate o final
+        int textSize = 0;
+        if (textAddr >= 0)
+            textSize = ((dataAddr > textAddr) ? dataAddr : (int) machineCode.size()) - textAddr;
+        return writeObject(outFileName, machineCode, (textAddr < 0) ? 0 : textAddr, textSize);
+    }
+    
+    OutputBuffer outFile;
+    outFile.open(outFileName);
+    
+    // escreve o codigo de maquina final no arquivo
+    for (unsigned int i = 0; i < machineCode.size(); ++i) {
+        outFile.putInt(machineCode[i]);
+        outFile.putChar(' ');
+    }
+    
+    outFile.close();
+    return outFile.written;
 }
 
 
@@ -875,114 +928,90 @@ std::vector<int> asmParser (std::ifstream &mcrFile, std::vector<Label> &labelLis
 assembleCode: faz a passagem de montagem no arquivo, que inclui:
     - (todo o processo de passagem unica)
     - (detectar erros blabla)
-entrada: nome do arquivo de entrada '.mcr'
-saida: nome do arquivo de saida '.o'
+as linhas vem direto da passagem de macros, em memoria (sem reler o arquivo '.mcr')
+entrada: estado da passagem de macros e do preprocessamento, nome do arquivo de saida '.o', tabelas, lista de erros e formato da saida (0: texto, 1: binario)
+saida: nenhuma (arquivo '.o' escrito)
 */
-void assembleCode (std::string mcrFileName, std::string outFileName, std::vector<int> &lineDict, std::vector<Instr> &instrList, std::vector<Dir> &dirList, std::vector<Error> &errorList) {
+void assembleCode (McrState &mcr, PreState &pre, std::string outFileName, Tables &tables, std::vector<Error> &errorList, int binary) {
     
-    std::ifstream mcrFile (mcrFileName);
-    std::ofstream outFile (outFileName);
+    LineDict lineDict (mcr.lineMap, pre.lineDict); // linha da saida das macros -> linha do arquivo original (composto so quando um erro eh reportado)
     
-    std::vector<Label> labelList; // lista de rotulos
+    SymbolTable labelList (pre.symbols); // tabela de simbolos (com os nomes compartilhados pelas passagens)
+    labelList.chained = 1; // as pendencias ficam encadeadas no codigo de maquina, que fica inteiro em memoria ate o final
     
     std::vector<int> machineCode; // codigo de maquina
     
-    std::vector<int> addrDict; // look up table pra traduzir um endereco em uma linha
+    RunArena arena; // memoria da montagem, liberada de uma vez no final
     
-    std::vector<std::string> lines; // linhas do arquivo .mcr (para uso nas mensagens de erro)
+    std::pmr::vector<std::string_view> lines (arena.get()); // linhas da saida das macros, copiadas na arena (para uso nas mensagens de erro)
     
     int lineCounter = 1;
     int addrCounter = 0;
     int section = -1; // -1: nenhuma, 0: text, 1: data
     int sectionText = -1; // -1: não encontrou seção texto, 0: encontrou
+    int textAddr = -1, dataAddr = -1; // endereço onde começa cada seção (para o cabeçalho do formato binário)
+    
+    RunStats *stats = mcr.stats;
+    int caller = stats ? stats->enter(STATS_ASM) : -1;
     
-    while (!mcrFile.eof()) {
+    TokenLine line;
+    while (mcrNextLine(mcr, pre, line, tables, errorList)) {
         
-        // le o codigo de maquina parcial da linha
-        std::vector<int> partialMachineCode = asmParser(mcrFile, labelList, lineCounter, addrCounter, lineDict, instrList, dirList, section, sectionText, addrDict, lines, errorList);
+        // guarda a linha na arena (para as mensagens de erro do final) e monta com os tokens que ja vieram separados
+        int lastSection = section;
+        lines.push_back(arena.copy(line.text));
+        asmParser(TokenLine (lines.back(), line.tokens, line.numTokens), labelList, lineCounter, addrCounter, lineDict, tables, section, sectionText, machineCode, errorList);
         
-        // anexa os codigos parciais
-        for (unsigned int i = 0; i < partialMachineCode.size(); ++i)
-            machineCode.push_back(partialMachineCode[i]);
+        // guarda onde cada seção começou pela primeira vez
+        if (section != lastSection && section == 0 && textAddr < 0)
+            textAddr = addrCounter;
+        if (section != lastSection && section == 1 && dataAddr < 0)
+            dataAddr = addrCounter;
+        
+        // os elos nao alcancam enderecos muito grandes: dai em diante as pendencias vao para a tabela
+        if (labelList.chained && addrCounter >= CHAIN_LIMIT)
+            labelList.unchain(machineCode);
         
         lineCounter++;
         
     }
     
+    // se o limite de erros interrompeu a leitura, o resto do arquivo nao foi visto: as pendencias e a secao de texto nao podem ser conferidas e o '.o' nao eh escrito
+    if (pre.stopped) {
+        if (stats)
+            stats->enter(caller);
+        return;
+    }
+    
     if (sectionText == -1)
         errorList.push_back(Error ("seção texto é obrigatória", "semântico", -1, "", 0));
     
     // resolve as listas de pendências (e reporta erros)
-    for (unsigned int i = 0; i < labelList.size(); ++i) {
-        
-        if (!labelList[i].isDefined) { // rotulo nunca foi definido
-            
-            for (unsigned int j = 0; j < labelList[i].pendList.size(); ++j) {
-                int argPos = labelList[i].posList[j];
-                int mcrLine = addrDict[labelList[i].pendList[j]]; // linha do arquivo .mcr
-                int origLine = lineDict[mcrLine-1]; // linha do arquivo original
-                errorList.push_back(Error ("rótulo "+labelList[i].name+" não definido", "semântico", origLine, lines[mcrLine-1], argPos));
-            }
-            
-        } else {
-            
-            for (unsigned int j = 0; j < labelList[i].pendList.size(); ++j) {
-                
-                // pega o proximo endereço na lista de pendencias
-                int address = labelList[i].pendList[j];
-                
-                // pega a informacao adicional para indicar problemas
-                int auxInfo = labelList[i].auxInfoList[j];
-                
-                // ja faz uma traducao das linhas
-                int mcrLine = addrDict[address]; // linha do arquivo .mcr
-                int origLine = lineDict[mcrLine-1]; // linha do arquivo original
-                
-                // recupera o offset da instrucao
-                int offset = machineCode[address];
-                
-                // recupera a posição do rótulo na linha
-                int argPos = labelList[i].posList[j];
-                
-                if (auxInfo == 1) { // é uma divisão
-                    if (labelList[i].isConst == 2)
-                        errorList.push_back(Error ("divisão por zero", "semântico", origLine, lines[mcrLine-1], argPos));
-                } else if (auxInfo == 2) { // é um pulo
-                    if (labelList[i].vectSize != 0)
-                        errorList.push_back(Error ("pulo para seção inválida", "semântico", origLine, lines[mcrLine-1], argPos));
-                } else if (auxInfo == 3) { // tá modificando o rótulo
-                    if (labelList[i].isConst != 0)
-                        errorList.push_back(Error ("valores constantes não podem ser modificados", "semântico", origLine, lines[mcrLine-1], argPos));
-                }
-                
-                // se não for pulo, não pode acessar a área de texto
-                if (labelList[i].vectSize == 0 && auxInfo != 2)
-                    errorList.push_back(Error ("acesso à seção de texto só é permitido para pulos", "semântico", origLine, lines[mcrLine-1], argPos));
-                
-                argPos = argPos + labelList[i].name.size() + 1 + 1 + 1;
-                    
-                // nao se pode usar offset com pulos
-                if (auxInfo == 2 && offset != 0)
-                    errorList.push_back(Error ("o deslocamento de pulos deve ser zero", "semântico", origLine, lines[mcrLine-1], argPos));
-                
-                // checa se o tamanho do rotulo bate com o indice n (rotulo + n)
-                if (offset >= labelList[i].vectSize && auxInfo != 2 && labelList[i].vectSize > 0)
-                    errorList.push_back(Error ("indíce excede o tamanho do vetor "+labelList[i].name, "semântico", origLine, lines[mcrLine-1], argPos));
-                
-                machineCode[address] = labelList[i].value+offset;
-                
-            }
-            
-        }
-        
-    }
+    if (stats)
+        stats->enter(STATS_FIXUP);
+    int numFixups = labelList.numPending();
+    int numResolved = resolveCode(labelList, machineCode, lineDict, lines, errorList);
     
     // escreve o codigo de maquina final no arquivo
-    for (unsigned int i = 0; i < machineCode.size(); ++i)
-        outFile << machineCode[i] << " ";
-    
-    mcrFile.close();
-    outFile.close();
+    if (stats)
+        stats->enter(STATS_OUTPUT);
+    std::size_t numBytes = writeCode(outFileName, machineCode, binary, textAddr, dataAddr);
+    
+    // contadores da montagem
+    if (stats) {
+        stats->enter(caller);
+        stats->linesIn[STATS_ASM] = lines.size();
+        stats->linesOut[STATS_ASM] = machineCode.size();
+        stats->linesIn[STATS_FIXUP] = numFixups;
+        stats->linesOut[STATS_FIXUP] = numResolved;
+        stats->linesIn[STATS_OUTPUT] = machineCode.size();
+        stats->linesOut[STATS_OUTPUT] = numBytes;
+        stats->fixups = numFixups;
+        stats->words = machineCode.size();
+        stats->bytesWritten += numBytes;
+        for (int i = 0; i < labelList.size(); ++i)
+            stats->labels += labelList[i].isDefined;
+    }
     
     return;
 }
\ No newline at end of file
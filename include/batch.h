@@ -0,0 +1,236 @@
+/*      BATCH.H: execução das passagens sobre um arquivo e modo em lote (vários arquivos em paralelo)        */
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// BatchJob: um arquivo do modo em lote e o relatorio de erros dele
+struct BatchJob {
+    // membros
+    std::string inFileName; // arquivo de entrada '.asm'
+    std::string outFileName; // arquivo de saida '.o'
+    std::string report; // erros ja formatados, prontos para serem mostrados
+    int numErrors; // quantidade de erros encontrados
+    int done; // se o arquivo ja foi processado (protegido pelo mutex do lote)
+    // metodos
+    BatchJob (): numErrors(0), done(0) {};
+    BatchJob (std::string in, std::string out): inFileName(in), outFileName(out), numErrors(0), done(0) {};
+};
+
+
+
+// WorkQueue: fila de trabalho de uma thread. a dona tira do fim, as outras roubam do comeco
+struct WorkQueue {
+    // membros
+    std::deque<int> jobs; // indices dos arquivos a serem processados
+    std::mutex mutex; // protege a fila
+    // metodos
+    WorkQueue () {};
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+int processFile (std::string, std::string, std::string, Options&, Tables&, std::vector<Error>&, RunStats* = nullptr);
+int nextJob (std::vector<WorkQueue>&, int);
+void batchWorker (std::vector<WorkQueue>&, int, std::vector<BatchJob>&, std::string, Options&, Tables&, std::mutex&, std::condition_variable&);
+void runBatch (Options&, Tables&);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+processFile: executa as passagens pedidas sobre um arquivo de entrada
+entrada: operacao (-p, -m ou -o), nome do arquivo de entrada e de saida, opcoes, tabelas (so lidas, podem ser compartilhadas entre threads), lista de erros
+e estatisticas a serem preenchidas (nullptr se nao forem pedidas)
+saida: 1 se o limite de erros (--max-errors) interrompeu a leitura do arquivo, 0 se nao (arquivos de saida escritos e erros na lista)
+*/
+int processFile (std::string operation, std::string inFileName, std::string outFileName, Options &options, Tables &tables, std::vector<Error> &errorList, RunStats *stats) {
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    // cria os nomes dos arquivos com as extensoes '.pre' e '.mcr'
+    std::string preFileName (o2pre(outFileName)),
+        mcrFileName (o2mcr(outFileName));
+    
+    // as passagens entregam as linhas umas para as outras em memoria. os arquivos intermediarios
+    // so sao escritos quando pedidos pela operacao (-p, -m) ou pela opcao --keep
+    PreState pre;
+    McrState mcr;
+    std::ofstream preFile, mcrFile;
+    pre.asmFile.open(inFileName);
+    pre.stats = stats;
+    mcr.stats = stats;
+    pre.maxErrors = options.maxErrors;
+    if (operation == "-p" || operation == "-m" || options.keepIntermediates) {
+        preFile.open(preFileName);
+        pre.preFile = &preFile;
+    }
+    if (operation == "-m" || options.keepIntermediates) {
+        mcrFile.open(mcrFileName);
+        mcr.mcrFile = &mcrFile;
+    }
+    
+    // passagem de pre processamento (sozinha)
+    if (operation == "-p")
+        preProcessFile (pre, tables, errorList);
+    
+    // passagem de macros (puxando as linhas do preprocessamento)
+    if (operation == "-m")
+        expandMacros (mcr, pre, tables, errorList);
+    
+    // passagem normal (puxando as linhas da passagem de macros). no modo em lote os arquivos ja sao montados em paralelo
+    if (operation == "-o") {
+        int numThreads = options.jobs;
+        if (numThreads < 1)
+            numThreads = std::thread::hardware_concurrency();
+        if (options.incremental)
+            assembleIncremental (pre, outFileName, tables, errorList, options.binary, options.batch ? 1 : numThreads);
+        else if (options.parallel && !options.batch && numThreads > 1)
+            assembleCodeParallel (mcr, pre, outFileName, tables, errorList, options.binary, numThreads);
+        else if (options.stream)
+            assembleCodeStream (mcr, pre, outFileName, tables, errorList, options.binary);
+        else
+            assembleCode (mcr, pre, outFileName, tables, errorList, options.binary);
+    }
+    
+    // contadores do preprocessamento e da passagem de macros (os da montagem ja foram preenchidos por ela)
+    if (stats) {
+        stats->linesIn[STATS_PRE] = pre.lineCounter-1;
+        stats->linesOut[STATS_PRE] = pre.lineDict.size();
+        stats->linesIn[STATS_MCR] = std::min(mcr.lineCounter-1, (int) pre.lineDict.size());
+        stats->equs = pre.equTable.size();
+        stats->macros = mcr.macroList.size();
+        stats->errors = errorList.size();
+        stats->bytesRead = pre.asmFile.size;
+        if (preFile.is_open())
+            stats->bytesWritten += (long long) preFile.tellp();
+        if (mcrFile.is_open())
+            stats->bytesWritten += (long long) mcrFile.tellp();
+        stats->total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return pre.stopped;
+}
+
+
+
+/*
+nextJob: pega o proximo arquivo para a thread. primeiro tenta a propria fila e, se estiver vazia, rouba de outra
+entrada: filas de todas as threads e indice da thread atual
+saida: indice do arquivo a ser processado, ou -1 se nao houver mais trabalho
+*/
+int nextJob (std::vector<WorkQueue> &queues, int self) {
+    
+    // tira do fim da propria fila
+    {
+        std::lock_guard<std::mutex> lock (queues[self].mutex);
+        if (!queues[self].jobs.empty()) {
+            int job = queues[self].jobs.back();
+            queues[self].jobs.pop_back();
+            return job;
+        }
+    }
+    
+    // rouba do comeco das filas das outras threads
+    for (unsigned int i = 1; i < queues.size(); ++i) {
+        WorkQueue &victim = queues[(self+i) % queues.size()];
+        std::lock_guard<std::mutex> lock (victim.mutex);
+        if (!victim.jobs.empty()) {
+            int job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return job;
+        }
+    }
+    
+    return -1;
+}
+
+
+
+/*
+batchWorker: laco de uma thread do modo em lote. processa arquivos ate acabar o trabalho de todas as filas
+entrada: filas de trabalho, indice da thread, arquivos do lote, operacao, opcoes, tabelas e mutex/condicao para avisar que um arquivo terminou
+saida: nenhuma (relatorio de cada arquivo preenchido)
+*/
+void batchWorker (std::vector<WorkQueue> &queues, int self, std::vector<BatchJob> &jobs, std::string operation, Options &options, Tables &tables, std::mutex &doneMutex, std::condition_variable &doneCond) {
+    
+    int i;
+    while ((i = nextJob(queues, self)) >= 0) {
+        
+        // processa o arquivo com a sua propria lista de erros
+        std::vector<Error> errorList;
+        int stopped = processFile(operation, jobs[i].inFileName, jobs[i].outFileName, options, tables, errorList);
+        
+        // formata os erros ja na ordem das linhas (so os primeiros, se houver limite)
+        sortErrors (errorList);
+        std::string notice = limitErrors(errorList, options.maxErrors, stopped);
+        std::ostringstream report;
+        reportList (errorList, report, jobs[i].inFileName, options.machineErrors);
+        report << notice;
+        
+        // avisa que o arquivo terminou
+        {
+            std::lock_guard<std::mutex> lock (doneMutex);
+            jobs[i].report = report.str();
+            jobs[i].numErrors = errorList.size();
+            jobs[i].done = 1;
+        }
+        doneCond.notify_all();
+    }
+
+}
+
+
+
+/*
+runBatch: monta todos os arquivos do lote em paralelo. as tabelas sao compartilhadas (so leitura) e os erros de cada arquivo
+sao mostrados juntos, na ordem em que os arquivos foram dados, independente de qual thread terminou primeiro
+entrada: opcoes (com a lista de arquivos) e tabelas
+saida: nenhuma (arquivos de saida escritos e erros no terminal)
+*/
+void runBatch (Options &options, Tables &tables) {
+    
+    std::vector<BatchJob> jobs;
+    for (unsigned int i = 0; i < options.inFileNames.size(); ++i)
+        jobs.push_back(BatchJob(options.inFileNames[i], options.outFileNames[i]));
+    
+    // numero de threads: o pedido, ou o numero de nucleos, mas nunca mais que o numero de arquivos
+    int numThreads = options.jobs;
+    if (numThreads < 1)
+        numThreads = std::thread::hardware_concurrency();
+    if (numThreads < 1)
+        numThreads = 1;
+    if (numThreads > (int) jobs.size())
+        numThreads = jobs.size();
+    
+    // distribui os arquivos entre as filas. cada thread processa a propria fila na ordem, e as que terminarem antes roubam das outras
+    std::vector<WorkQueue> queues (numThreads);
+    for (unsigned int i = 0; i < jobs.size(); ++i)
+        queues[i % numThreads].jobs.push_front(i);
+    
+    std::mutex doneMutex;
+    std::condition_variable doneCond;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+        threads.push_back(std::thread(batchWorker, std::ref(queues), t, std::ref(jobs), options.operation, std::ref(options), std::ref(tables), std::ref(doneMutex), std::ref(doneCond)));
+    
+    // mostra os relatorios na ordem dos arquivos, assim que cada um fica pronto
+    for (unsigned int i = 0; i < jobs.size(); ++i) {
+        std::unique_lock<std::mutex> lock (doneMutex);
+        doneCond.wait(lock, [&jobs, i] { return jobs[i].done; });
+        std::string report;
+        report.swap(jobs[i].report);
+        int numErrors = jobs[i].numErrors;
+        lock.unlock();
+        // no formato para maquinas cada erro ja tem o nome do arquivo
+        if (!options.machineErrors)
+            std::cout << jobs[i].inFileName << ": " << numErrors << (numErrors == 1 ? " erro" : " erros") << "\n";
+        std::cout << report;
+    }
+    
+    for (unsigned int t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+}
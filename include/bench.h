@@ -0,0 +1,416 @@
+/*      BENCH.H: gerador de programas grandes e medição do tempo de cada passagem sobre eles        */
+
+
+
+/*      DEFINIÇÕES DA MEDIÇÃO       */
+
+const int BENCH_STAGES = 3; // preprocessamento, macros (puxando o preprocessamento) e montagem (puxando as duas)
+const char* const BENCH_STAGE_NAMES[BENCH_STAGES] = {"pre", "mcr", "asm"};
+const int BENCH_REPEAT = 3; // cada passagem eh medida algumas vezes e fica o menor tempo
+const int BENCH_DEFAULT_LINES = 100000; // tamanho do programa gerado quando nao eh dado
+const int BENCH_DEFAULT_SIZES[] = {10000, 100000, 1000000};
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// GenConfig: tamanho e composicao do programa gerado (as chaves de --mix tem os nomes dos membros)
+struct GenConfig {
+    // membros
+    int lines; // linhas de instrucao da secao de texto (sem contar IF, macros e dados)
+    int labels; // % das linhas de instrucao com rotulo
+    int forward; // % dos desvios para rotulos definidos mais adiante
+    int equs; // numero de EQU no comeco do arquivo
+    int ifs; // % das linhas de instrucao precedidas por um IF
+    int macros; // numero de macros definidas
+    int calls; // % das linhas que chamam uma macro
+    int data; // rotulos da secao de dados, em % das linhas de instrucao
+    int space; // maior tamanho de um SPACE
+    int errors; // linhas com erro a cada 1000 linhas
+    int seed; // semente do gerador (o mesmo programa sai da mesma configuracao)
+    // metodos
+    GenConfig (): lines(BENCH_DEFAULT_LINES), labels(10), forward(50), equs(16), ifs(2), macros(32), calls(5), data(5), space(16), errors(0), seed(1) {};
+    // muda um membro pelo nome. retorna 1 se a chave existe, 0 se nao
+    int set (std::string_view key, int value) {
+        std::string_view names[] = {"lines", "labels", "forward", "equs", "ifs", "macros", "calls", "data", "space", "errors", "seed"};
+        int *fields[] = {&lines, &labels, &forward, &equs, &ifs, &macros, &calls, &data, &space, &errors, &seed};
+        for (unsigned int i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+            if (key == names[i]) {
+                *fields[i] = value;
+                return 1;
+            }
+        }
+        return 0;
+    };
+};
+
+
+
+// BenchResult: medicao de uma passagem
+struct BenchResult {
+    // membros
+    double seconds; // tempo da passagem (e das que ela puxa)
+    long maxRss; // pico de memoria residente do processo que a executou, em KB
+    int numErrors; // erros encontrados
+    // metodos
+    BenchResult (): seconds(0), maxRss(0), numErrors(0) {};
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+int genConfig (std::string, GenConfig&);
+long long generateProgram (GenConfig&, OutputBuffer&);
+BenchResult benchStage (int, std::string, std::string, Tables&);
+BenchResult benchFork (int, std::string, std::string, Tables&);
+void runGenerator (Options&);
+void runBench (Options&, Tables&);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+genConfig: le a composicao do programa no formato "chave=valor,chave=valor" (chaves de GenConfig; as que faltam ficam com o padrao)
+entrada: texto de --mix e configuracao a ser preenchida
+saida: 1 se leu tudo, 0 se alguma chave nao existe ou algum valor nao eh um inteiro nao negativo (a mensagem ja foi mostrada)
+*/
+int genConfig (std::string mix, GenConfig &config) {
+    
+    std::stringstream mixStream (mix);
+    std::string item;
+    while (getline(mixStream, item, ',')) {
+        if (item.empty())
+            continue;
+        std::size_t equal = item.find('=');
+        int value;
+        if (equal == std::string::npos || !integerCheck(std::string_view(item).substr(equal+1), value) || value < 0
+            || !config.set(std::string_view(item).substr(0, equal), value)) {
+            std::cout << "Parâmetro inválido em --mix: " << item << "\n";
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+
+
+/*
+generateProgram: escreve um programa valido (a menos dos erros pedidos) com o tamanho e a composicao dados:
+    - EQU no comeco, usados pelos IF
+    - na secao de texto, as definicoes das macros e depois as linhas de instrucao, algumas com rotulo, chamando macro ou precedidas por IF
+    - desvios para rotulos de texto ja definidos ou definidos mais adiante
+    - na secao de dados, os rotulos usados pelas instrucoes (SPACE de varios tamanhos, acessados com deslocamento, e CONST)
+entrada: configuracao e saida (com o arquivo '.asm' aberto)
+saida: numero de linhas escritas
+*/
+long long generateProgram (GenConfig &config, OutputBuffer &out) {
+    
+    std::mt19937 random (config.seed);
+    long long numLines = 0;
+    std::string line;
+    auto emit = [&] () {
+        line += '\n';
+        out.putBytes(line.data(), line.size());
+        line.clear();
+        numLines++;
+    };
+    
+    // os rotulos de dados sao sorteados antes, para que os deslocamentos caibam nos SPACE (tamanho 0: CONST)
+    int numData = std::max(1, (int) ((long long) config.lines * config.data / 100));
+    std::vector<int> dataSize (numData), spaceLabels;
+    for (int i = 0; i < numData; ++i) {
+        dataSize[i] = (i > 0 && random() % 4 == 0) ? 0 : 1 + random() % std::max(1, config.space);
+        if (dataSize[i] > 0)
+            spaceLabels.push_back(i);
+    }
+    // operando de leitura (qualquer dado, as vezes com deslocamento) ou de escrita (so SPACE)
+    auto operand = [&] (int writable) {
+        int label = writable ? spaceLabels[random() % spaceLabels.size()] : random() % numData;
+        line += 'D';
+        line += std::to_string(label);
+        if (dataSize[label] > 1 && random() % 4 == 0) {
+            line += " + ";
+            line += std::to_string(random() % dataSize[label]);
+        }
+    };
+    
+    // EQU
+    for (int i = 0; i < config.equs; ++i) {
+        line = "E" + std::to_string(i) + ": EQU " + std::to_string(random() % 2);
+        emit();
+    }
+    
+    line = "SECTION TEXT";
+    emit();
+    
+    // macros (sem rotulos nem desvios, para poderem ser chamadas em qualquer lugar)
+    const char *bodyInstrs[] = {"LOAD ", "ADD ", "SUB ", "STORE ", "OUTPUT "};
+    for (int i = 0; i < config.macros; ++i) {
+        line = "M" + std::to_string(i) + ": MACRO";
+        emit();
+        int bodySize = 1 + random() % 4;
+        for (int j = 0; j < bodySize; ++j) {
+            int instr = random() % 5;
+            line = bodyInstrs[instr];
+            operand (instr == 3);
+            emit();
+        }
+        line = "END";
+        emit();
+    }
+    
+    // linhas de instrucao. os rotulos de texto sao espalhados por igual, entao sempre se sabe quantos ja foram definidos
+    int numLabels = (long long) config.lines * std::min(config.labels, 100) / 100, defined = 0;
+    const char *errorLines[] = {"LOAD X", "ADD", "FOO D0", "COPY D0 D0"};
+    for (int i = 0; i < config.lines; ++i) {
+        int labeled = numLabels > 0 && (long long) (i+1) * numLabels / config.lines > (long long) i * numLabels / config.lines;
+        if (labeled) {
+            line = "T" + std::to_string(defined) + ": ";
+            defined++;
+        } else {
+            // erro injetado: rotulo indefinido, operando faltando, instrucao inexistente ou virgula faltando
+            if ((int) (random() % 1000) < config.errors) {
+                line = errorLines[random() % 4];
+                if (line == "LOAD X")
+                    line += std::to_string(i);
+                emit();
+                continue;
+            }
+            if (config.equs > 0 && (int) (random() % 100) < config.ifs) {
+                line = "IF E" + std::to_string(random() % config.equs);
+                emit();
+            }
+            if (config.macros > 0 && (int) (random() % 100) < config.calls) {
+                line = "M" + std::to_string(random() % config.macros);
+                emit();
+                continue;
+            }
+        }
+        
+        int kind = random() % 100;
+        if (kind < 30) {
+            const char *arith[] = {"ADD ", "SUB ", "MULT ", "DIV "};
+            line += arith[random() % 4];
+            operand (0);
+        } else if (kind < 50) {
+            line += "LOAD ";
+            operand (0);
+        } else if (kind < 65) {
+            line += "STORE ";
+            operand (1);
+        } else if (kind < 75) {
+            line += "COPY ";
+            operand (0);
+            line += ", ";
+            operand (1);
+        } else if (kind < 90 && numLabels > 0) {
+            // desvio para frente (se ainda houver rotulos) ou para tras (se ja houver)
+            const char *jumps[] = {"JMP ", "JMPN ", "JMPP ", "JMPZ "};
+            line += jumps[random() % 4];
+            int target;
+            if (defined == 0 || (defined < numLabels && (int) (random() % 100) < config.forward))
+                target = defined + random() % (numLabels - defined);
+            else
+                target = random() % defined;
+            line += 'T';
+            line += std::to_string(target);
+        } else if (kind < 98) {
+            line += (kind % 2) ? "INPUT " : "OUTPUT ";
+            operand (kind % 2);
+        } else
+            line += "STOP";
+        emit();
+    }
+    line = "STOP";
+    emit();
+    
+    // dados
+    line = "SECTION DATA";
+    emit();
+    for (int i = 0; i < numData; ++i) {
+        line = "D" + std::to_string(i) + ": ";
+        if (dataSize[i] == 0)
+            line += "CONST " + std::to_string(1 + random() % 1000);
+        else if (dataSize[i] == 1)
+            line += "SPACE";
+        else
+            line += "SPACE " + std::to_string(dataSize[i]);
+        emit();
+    }
+    
+    return numLines;
+}
+
+
+
+/*
+benchStage: executa uma passagem sobre o arquivo, do mesmo jeito que processFile mas sem escrever os arquivos intermediarios
+entrada: passagem (0: pre, 1: mcr, 2: asm), arquivo '.asm', arquivo '.o' (so escrito pela montagem) e tabelas
+saida: tempo e numero de erros (o pico de memoria fica com quem chamou)
+*/
+BenchResult benchStage (int stage, std::string asmFileName, std::string objFileName, Tables &tables) {
+    
+    PreState pre;
+    McrState mcr;
+    std::vector<Error> errorList;
+    BenchResult result;
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pre.asmFile.open(asmFileName);
+    if (stage == 0)
+        preProcessFile (pre, tables, errorList);
+    else if (stage == 1)
+        expandMacros (mcr, pre, tables, errorList);
+    else
+        assembleCode (mcr, pre, objFileName, tables, errorList, 0);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.numErrors = errorList.size();
+    
+    return result;
+}
+
+
+
+/*
+benchFork: executa uma passagem num processo filho, para que o pico de memoria seja so o dela
+entrada: passagem, arquivo '.asm', arquivo '.o' e tabelas
+saida: tempo, pico de memoria e numero de erros (se nao der para criar o processo, a passagem roda neste, e o pico eh o do processo todo)
+*/
+BenchResult benchFork (int stage, std::string asmFileName, std::string objFileName, Tables &tables) {
+    
+    BenchResult result;
+    int channel[2];
+    pid_t child = -1;
+    if (pipe(channel) == 0) {
+        child = fork();
+        if (child < 0) {
+            ::close(channel[0]);
+            ::close(channel[1]);
+        }
+    }
+    
+    if (child < 0) {
+        result = benchStage(stage, asmFileName, objFileName, tables);
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        result.maxRss = usage.ru_maxrss;
+        return result;
+    }
+    
+    // filho: mede e manda o resultado pelo pipe
+    if (child == 0) {
+        ::close(channel[0]);
+        result = benchStage(stage, asmFileName, objFileName, tables);
+        ssize_t written = ::write(channel[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+    
+    ::close(channel[1]);
+    std::size_t done = 0;
+    while (done < sizeof(result)) {
+        ssize_t n = ::read(channel[0], (char*) &result + done, sizeof(result) - done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    ::close(channel[0]);
+    int status;
+    struct rusage usage;
+    wait4(child, &status, 0, &usage);
+    result.maxRss = usage.ru_maxrss;
+    
+    return result;
+}
+
+
+
+/*
+runGenerator: escreve um programa gerado no arquivo pedido (--generate), com o tamanho de --lines e a composicao de --mix
+entrada: opcoes
+saida: nenhuma
+*/
+void runGenerator (Options &options) {
+    
+    GenConfig config;
+    if (options.lines > 0)
+        config.lines = options.lines;
+    if (!genConfig(options.mix, config))
+        return;
+    
+    OutputBuffer out;
+    if (!out.open(options.generateFileName)) {
+        std::cout << "Erro ao criar o arquivo: " << options.generateFileName << "\n";
+        return;
+    }
+    long long numLines = generateProgram(config, out);
+    out.close();
+    
+    std::cout << numLines << " linhas escritas em " << options.generateFileName << "\n";
+
+}
+
+
+
+/*
+runBench: gera um programa de cada tamanho pedido (--sizes, com a composicao de --mix) e mede cada passagem sobre ele.
+o tempo de uma passagem eh o da execucao dela puxando as anteriores, menos o das anteriores sozinhas; o pico de memoria eh o dessa execucao
+entrada: opcoes e tabelas
+saida: nenhuma
+*/
+void runBench (Options &options, Tables &tables) {
+    
+    GenConfig config;
+    if (!genConfig(options.mix, config))
+        return;
+    std::vector<int> sizes (options.benchSizes);
+    if (sizes.empty())
+        sizes.assign(std::begin(BENCH_DEFAULT_SIZES), std::end(BENCH_DEFAULT_SIZES));
+    
+    // o programa e o '.o' ficam em arquivos temporarios
+    char asmPath[] = "/tmp/sbbenchXXXXXX.asm";
+    int fd = mkstemps(asmPath, 4);
+    if (fd < 0) {
+        std::cout << "Erro ao criar o arquivo temporário: " << asmPath << "\n";
+        return;
+    }
+    ::close(fd);
+    std::string asmFileName (asmPath), objFileName (asm2o(asmFileName));
+    
+    for (int size : sizes) {
+        
+        config.lines = size;
+        OutputBuffer out;
+        out.open(asmFileName);
+        long long numLines = generateProgram(config, out);
+        out.close();
+        struct stat info;
+        stat(asmFileName.c_str(), &info);
+        
+        BenchResult best[BENCH_STAGES];
+        for (int stage = 0; stage < BENCH_STAGES; ++stage) {
+            for (int r = 0; r < BENCH_REPEAT; ++r) {
+                BenchResult result = benchFork(stage, asmFileName, objFileName, tables);
+                if (r == 0 || result.seconds < best[stage].seconds)
+                    best[stage].seconds = result.seconds;
+                best[stage].maxRss = std::max(best[stage].maxRss, result.maxRss);
+                best[stage].numErrors = result.numErrors;
+            }
+        }
+        
+        std::cout << "tamanho " << size << ": " << numLines << " linhas, " << (info.st_size + 999999) / 1000000 << " MB, " << best[BENCH_STAGES-1].numErrors << " erros\n";
+        for (int stage = 0; stage < BENCH_STAGES; ++stage) {
+            double seconds = best[stage].seconds - (stage > 0 ? best[stage-1].seconds : 0);
+            std::cout << "    " << BENCH_STAGE_NAMES[stage] << ": " << seconds << " s";
+            if (seconds > 0)
+                std::cout << " (" << (long long) (numLines / seconds) << " linhas por segundo)";
+            std::cout << ", pico de memória " << (best[stage].maxRss + 1023) / 1024 << " MB\n";
+        }
+        std::cout << "    total: " << best[BENCH_STAGES-1].seconds << " s (" << (long long) (numLines / best[BENCH_STAGES-1].seconds) << " linhas por segundo)\n";
+    }
+    
+    unlink(asmFileName.c_str());
+    unlink(objFileName.c_str());
+
+}
@@ -3,63 +3,319 @@
 
 
 /*      DECLARAÇÕES DAS FUNÇÕES     */
-int errorCheck (int, char**, std::string, std::string);
+int errorCheck (int, char**, Options&);
+int fileCheck (std::string, std::string, std::ostream& = std::cout);
+std::string asm2o (std::string);
 std::string o2pre (std::string);
 std::string o2mcr (std::string);
+std::string o2state (std::string);
 std::vector<Instr> getInstrList (std::string);
 std::vector<Dir> getDirList (std::string);
-int integerCheck (std::string, int&);
-void reportError (std::string, std::string, int, std::string);
-int labelCheck (std::string, std::vector<Instr>&, std::vector<Dir>&, int&);
+Tables getTables (std::string, std::string);
+int integerCheck (std::string_view, int&);
+int labelCheck (std::string_view, Tables&, int&);
+void sortErrors (std::vector<Error>&);
+void formatErrors (std::vector<Error>&, std::string&, const std::string&, int);
+void reportList (std::vector<Error>&, std::ostream&, const std::string& = "", int = 0);
+std::string limitErrors (std::vector<Error>&, int, int);
+void statsReport (RunStats&, std::ostream&);
+void statsJson (RunStats&, std::ostream&);
 bool operator< (const Error&, const Error&);
 
 
 /*      DEFINIÇÕES DAS FUNÇÕES     */
 
 /*
-errorCheck: verifica se ha algum erro nos argumentos de entrada do programa ou no arquivo do codigo de entrada
-entrada: argc e argv recebidos pela funcao main()
+errorCheck: le os argumentos de entrada do programa e verifica se ha algum erro neles ou no arquivo do codigo de entrada
+entrada: argc e argv recebidos pela funcao main() e as opcoes a serem preenchidas
 saida: um inteiro indicando se houve erro (0 se nao, -1 se sim)
+opcoes aceitas antes dos argumentos:
+    --instr-table arquivo: le a tabela de instrucoes do arquivo em vez de usar a embutida
+    --dir-table arquivo: le a tabela de diretivas do arquivo em vez de usar a embutida
+    --keep: na montagem, escreve tambem os arquivos intermediarios '.pre' e '.mcr'
+    --batch: modo em lote. os argumentos passam a ser a operacao seguida de varios arquivos '.asm' (cada um gera o '.o' de mesmo nome)
+    --manifest arquivo: (modo em lote) le os pares "entrada.asm saida.o" do arquivo, um por linha
+    --jobs n: (modo em lote ou --parallel) numero de threads (padrao: numero de nucleos da maquina)
+    --binary: na montagem, escreve o '.o' no formato binario (ver obj.h) em vez de texto
+    --parallel: na montagem de um arquivo so, divide o codigo em blocos montados em paralelo (a saida eh a mesma)
+    --incremental: na montagem, guarda o estado num arquivo '.state' e, na proxima montagem do mesmo '.o', so processa de novo as linhas editadas (a saida eh a mesma; nao vale com --keep)
+    --stream: na montagem, escreve o codigo no disco enquanto monta e corrige as pendencias no arquivo, sem guardar o codigo e as linhas em memoria (a saida eh a mesma)
+    --run arquivo.o: executa o arquivo objeto no simulador (ver sim.h), sem outros argumentos
+    --jit: no simulador, traduz o codigo para x86-64 nativo enquanto executa (ver jit.h)
+    --generate arquivo.asm: escreve um programa gerado (com --lines n linhas de instrucao e a composicao de --mix), sem outros argumentos (ver bench.h)
+    --bench: mede o tempo e a memoria de cada passagem sobre programas gerados dos tamanhos de --sizes n,n,... (com a composicao de --mix), sem outros argumentos
+    --stats: depois de processar um arquivo (sem --parallel ou --incremental), mostra o tempo e os contadores de cada etapa
+    --stats-json arquivo: como --stats, mas escreve as estatisticas em JSON no arquivo (ou na saida padrao, com '-')
+    --max-errors n: para de processar o arquivo quando chega em n erros e mostra so os n primeiros (sem --parallel ou --incremental)
+    --machine-errors: mostra os erros sem cores, um por linha, no formato "arquivo:linha:coluna: erro tipo: mensagem"
+    --server caminho: modo servidor. atende requisicoes de montagem no socket unix 'caminho' (ou na entrada/saida padrao, com '-'), sem outros argumentos (ver srv.h)
 */
-int errorCheck (int argc, char *argv[], std::string instrFileName, std::string dirFileName) {
+int errorCheck (int argc, char *argv[], Options &options) {
+    
+    // separa as opcoes (comecam com "--") dos argumentos
+    std::vector<std::string> args;
+    int runLater = 0; // se o '.o' do --run vem depois de outras opcoes (--run --jit yyy.o)
+    for (int i = 1; i < argc; ++i) {
+        std::string arg (*(argv+i));
+        if (arg.substr(0, 2) != "--") {
+            args.push_back(arg);
+        } else if (arg == "--keep") {
+            options.keepIntermediates = 1;
+        } else if (arg == "--batch") {
+            options.batch = 1;
+        } else if (arg == "--parallel") {
+            options.parallel = 1;
+        } else if (arg == "--binary") {
+            options.binary = 1;
+        } else if (arg == "--incremental") {
+            options.incremental = 1;
+        } else if (arg == "--stream") {
+            options.stream = 1;
+        } else if (arg == "--jit") {
+            options.jit = 1;
+        } else if (arg == "--bench") {
+            options.bench = 1;
+        } else if (arg == "--stats") {
+            options.stats = 1;
+        } else if (arg == "--machine-errors") {
+            options.machineErrors = 1;
+        } else if (arg == "--run" && i+1 < argc && std::string(*(argv+i+1)).substr(0, 2) == "--") {
+            runLater = 1;
+        } else if (arg == "--instr-table" || arg == "--dir-table" || arg == "--manifest" || arg == "--jobs" || arg == "--server" || arg == "--run"
+            || arg == "--generate" || arg == "--lines" || arg == "--mix" || arg == "--sizes" || arg == "--stats-json"
+            || arg == "--max-errors") {
+            if (i+1 >= argc) {
+                std::cout << "Opção sem argumento: " << arg << "\n";
+                return -1;
+            }
+            std::string value (*(argv+i+1));
+            if (arg == "--instr-table")
+                options.instrFileName = value;
+            else if (arg == "--dir-table")
+                options.dirFileName = value;
+            else if (arg == "--manifest")
+                options.manifestFileName = value;
+            else if (arg == "--server")
+                options.serverPath = value;
+            else if (arg == "--run")
+                options.runFileName = value;
+            else if (arg == "--generate")
+                options.generateFileName = value;
+            else if (arg == "--mix")
+                options.mix = value;
+            else if (arg == "--stats-json")
+                options.statsFileName = value;
+            else if (arg == "--max-errors") {
+                if (!integerCheck(value, options.maxErrors) || options.maxErrors < 1) {
+                    std::cout << "Limite de erros inválido: " << value << "\n";
+                    return -1;
+                }
+            } else if (arg == "--lines") {
+                if (!integerCheck(value, options.lines) || options.lines < 1) {
+                    std::cout << "Número de linhas inválido: " << value << "\n";
+                    return -1;
+                }
+            } else if (arg == "--sizes") {
+                std::stringstream sizeStream (value);
+                std::string size;
+                while (getline(sizeStream, size, ',')) {
+                    int conv;
+                    if (!integerCheck(size, conv) || conv < 1) {
+                        std::cout << "Tamanho inválido: " << size << "\n";
+                        return -1;
+                    }
+                    options.benchSizes.push_back(conv);
+                }
+            }
+            else if (!integerCheck(value, options.jobs) || options.jobs < 1) {
+                std::cout << "Número de threads inválido: " << value << "\n";
+                return -1;
+            }
+            ++i;
+        } else {
+            std::cout << "Opção inválida: " << arg << "\n";
+            return -1;
+        }
+    }
+    
+    // o '.o' do --run que veio antes de outras opcoes eh o primeiro argumento
+    if (runLater) {
+        if (args.empty()) {
+            std::cout << "Opção sem argumento: --run" << "\n";
+            return -1;
+        }
+        options.runFileName = args[0];
+        args.erase(args.begin());
+    }
+    
+    // no modo servidor, os arquivos vem nas requisicoes
+    if (!options.serverPath.empty()) {
+        
+        if (!args.empty() || options.batch || !options.manifestFileName.empty() || !options.runFileName.empty()) {
+            std::cout << "O modo servidor não aceita arquivos na linha de comando" << "\n";
+            return -1;
+        }
+        
+    // no simulador, o unico arquivo eh o '.o' a ser executado
+    } else if (!options.runFileName.empty()) {
+        
+        if (!args.empty() || options.batch || !options.manifestFileName.empty()) {
+            std::cout << "O simulador não aceita outros arquivos: " << options.runFileName << "\n";
+            return -1;
+        }
+        
+    // o gerador e a medicao criam os proprios programas
+    } else if (!options.generateFileName.empty() || options.bench) {
+        
+        if (!args.empty() || options.batch || !options.manifestFileName.empty() || (!options.generateFileName.empty() && options.bench)) {
+            std::cout << "O gerador e a medição não aceitam outros arquivos nem modos" << "\n";
+            return -1;
+        }
+        
+    // no modo em lote, a operacao vem seguida de qualquer numero de arquivos de entrada
+    } else if (options.batch || !options.manifestFileName.empty()) {
+        
+        options.batch = 1;
+        
+        if (args.empty()) {
+            std::cout << "Número inválido de argumentos: 0 (operação e arquivos de entrada esperados)" << "\n";
+            return -1;
+        }
+        options.operation = args[0];
+        for (unsigned int i = 1; i < args.size(); ++i) {
+            options.inFileNames.push_back(args[i]);
+            options.outFileNames.push_back(asm2o(args[i]));
+        }
+        
+        // le os pares do manifesto (a saida eh opcional)
+        if (!options.manifestFileName.empty()) {
+            std::ifstream manifestFile (options.manifestFileName);
+            if (!manifestFile.is_open()) {
+                std::cout << "Erro ao abrir o manifesto: " << options.manifestFileName << "\n";
+                return -1;
+            }
+            std::string manifestLine;
+            while (getline(manifestFile, manifestLine)) {
+                std::stringstream lineStream (manifestLine);
+                std::string inFileName, outFileName;
+                lineStream >> inFileName >> outFileName;
+                if (inFileName.empty() || inFileName[0] == '#')
+                    continue;
+                options.inFileNames.push_back(inFileName);
+                options.outFileNames.push_back(outFileName.empty() ? asm2o(inFileName) : outFileName);
+            }
+        }
+        
+        if (options.inFileNames.empty()) {
+            std::cout << "Nenhum arquivo de entrada para o modo em lote" << "\n";
+            return -1;
+        }
+        
+    // senao, sao esperados exatamente a operacao, a entrada e a saida
+    } else {
+        
+        // verifica o numero de argumentos dados
+        if (args.size() != 3) {
+            std::cout << "Número inválido de argumentos: " << args.size() << " (3 esperados)" << "\n";
+            return -1;
+        }
+        
+        // guarda os argumentos
+        options.operation = args[0];
+        options.inFileName = args[1];
+        options.outFileName = args[2];
+        options.inFileNames.push_back(args[1]);
+        options.outFileNames.push_back(args[2]);
+    }
     
-    // verifica o numero de argumentos dados
-    if (argc != 4) {
-        std::cout << "Número inválido de argumentos: " << argc-1 << " (3 esperados)" << "\n";
+    // as estatisticas sao de uma execucao normal sobre um arquivo
+    if ((options.stats || !options.statsFileName.empty()) && (options.operation.empty() || options.batch || options.parallel || options.incremental)) {
+        std::cout << "--stats só vale para um arquivo, sem --batch, --parallel ou --incremental" << "\n";
         return -1;
     }
     
-    // guarda os argumentos em strings
-    std::string operation (*(argv+1)),
-        inFileName (*(argv+2)),
-        outFileName (*(argv+3));
+    // o limite de erros interrompe as passagens em serie (a montagem em blocos e a incremental precisam do arquivo inteiro)
+    if (options.maxErrors > 0 && (options.operation.empty() || options.parallel || options.incremental)) {
+        std::cout << "--max-errors só vale para a montagem normal ou em lote, sem --parallel ou --incremental" << "\n";
+        return -1;
+    }
+    
+    // a montagem incremental so le de novo as linhas editadas, entao nao tem os arquivos intermediarios inteiros para escrever
+    if (options.incremental && options.keepIntermediates) {
+        std::cout << "--incremental não vale junto com --keep" << "\n";
+        return -1;
+    }
+    
+    // a montagem em fluxo substitui a montagem normal (as outras ja tem seu proprio jeito de guardar o codigo)
+    if (options.stream && (options.operation != "-o" || options.parallel || options.incremental)) {
+        std::cout << "--stream só vale para a montagem (-o), sem --parallel ou --incremental" << "\n";
+        return -1;
+    }
     
     // verifica se a operacao eh valida
-    if (operation != "-p" && operation != "-m" && operation != "-o") {
-        std::cout << "Operação inválida: " << operation << "\n";
+    if (options.serverPath.empty() && options.runFileName.empty() && options.generateFileName.empty() && !options.bench && options.operation != "-p" && options.operation != "-m" && options.operation != "-o") {
+        std::cout << "Operação inválida: " << options.operation << "\n";
         return -1;
     }
     
+    // verifica os nomes e a existencia de cada arquivo
+    for (unsigned int i = 0; i < options.inFileNames.size(); ++i) {
+        if (fileCheck(options.inFileNames[i], options.outFileNames[i]) == -1)
+            return -1;
+    }
+        
+    // se foi pedida uma tabela de instrucoes em arquivo, verifica se ela existe
+    if (!options.instrFileName.empty()) {
+        std::ifstream instrFile (options.instrFileName);
+        if (!instrFile.is_open()) {
+            std::cout << "Erro ao abrir a tabela de instruções: " << options.instrFileName << "\n";
+            return -1;
+        } else
+            instrFile.close();
+    }
+    
+    // se foi pedida uma tabela de diretivas em arquivo, verifica se ela existe
+    if (!options.dirFileName.empty()) {
+        std::ifstream dirFile (options.dirFileName);
+        if (!dirFile.is_open()) {
+            std::cout << "Erro ao abrir a tabela de diretivas: " << options.dirFileName << "\n";
+            return -1;
+        } else
+            dirFile.close();
+    }
+    
+    return 0;
+}
+
+
+
+/*
+fileCheck: verifica as extensoes dos arquivos de entrada e saida e se o arquivo de entrada existe
+entrada: nome do arquivo de entrada e de saida e stream onde o erro eh mostrado (o terminal, ou um buffer no modo servidor)
+saida: um inteiro indicando se houve erro (0 se nao, -1 se sim)
+*/
+int fileCheck (std::string inFileName, std::string outFileName, std::ostream &out) {
+    
     // verifica se as extensao do arquivo de entrada eh .asm
     if (inFileName.size() < 5) {
-        std::cout << "Extensão do arquivo de entrada não suportada (somente .asm)" << "\n";
+        out << "Extensão do arquivo de entrada não suportada (somente .asm)" << "\n";
         return -1;
     } else {
         std::string inExt = inFileName.substr(inFileName.size() - 4);
         if (inExt != ".asm") {
-            std::cout << "Extensão do arquivo de entrada não suportada (somente .asm)" << "\n";
+            out << "Extensão do arquivo de entrada não suportada (somente .asm)" << "\n";
             return -1;
         }
     }
     
     // verifica se as extensao do arquivo de saida eh .o
     if (outFileName.size() < 3) {
-        std::cout << "Extensão do arquivo de saída não suportada (somente .o)" << "\n";
+        out << "Extensão do arquivo de saída não suportada (somente .o)" << "\n";
         return -1;
     } else {
         std::string outExt = outFileName.substr(outFileName.size() - 2);
         if (outExt != ".o") {
-            std::cout << "Extensão do arquivo de saída não suportada (somente .o)" << "\n";
+            out << "Extensão do arquivo de saída não suportada (somente .o)" << "\n";
             return -1;
         }
     }
@@ -67,32 +323,36 @@ int errorCheck (int argc, char *argv[], std::string instrFileName, std::string d
     // verifica se o arquivo de entrada existe
     std::ifstream asmFile (inFileName);
     if (!asmFile.is_open()) {
-        std::cout << "Erro ao abrir o arquivo de entrada: " << inFileName << "\n";
+        out << "Erro ao abrir o arquivo de entrada: " << inFileName << "\n";
         return -1;
     } else
         asmFile.close();
-        
-    // verifica se o arquivo com a lista de instrucoes existe
-    std::ifstream instrFile (instrFileName);
-    if (!instrFile.is_open()) {
-        std::cout << "Erro ao abrir a tabela de instruções: " << instrFileName << "\n";
-        return -1;
-    } else
-        instrFile.close();
-    
-    // verifica se o arquivo com a lista de diretivas existe
-    std::ifstream dirFile (dirFileName);
-    if (!dirFile.is_open()) {
-        std::cout << "Erro ao abrir a tabela de diretivas: " << dirFileName << "\n";
-        return -1;
-    } else
-        dirFile.close();
     
     return 0;
 }
 
 
 
+/*
+asm2o: passa uma string com extensao '.asm' para extensao '.o'
+entrada: string com o nome original com a extensao '.asm'
+saida: string com o nome alterado com a extensao '.o'
+*/
+std::string asm2o (std::string original) {
+    
+    std::string altered (original);
+    
+    if (altered.size() >= 4 && altered.substr(altered.size() - 4) == ".asm")
+        altered.resize(altered.size() - 3);
+    else
+        altered.push_back('.');
+    altered.append("o");
+    
+    return altered;
+}
+
+
+
 /*
 o2pre: passa uma string com extensao '.o' para extensao '.pre'
 entrada: string com o nome original com a extensao '.o'
@@ -127,6 +387,23 @@ std::string o2mcr (std::string original) {
 
 
 
+/*
+o2state: passa uma string com extensao '.o' para extensao '.state' (arquivo de estado da montagem incremental)
+entrada: string com o nome original com a extensao '.o'
+saida: string com o nome alterado com a extensao '.state'
+*/
+std::string o2state (std::string original) {
+    
+    std::string altered (original);
+    
+    altered.pop_back();
+    altered.append("state");
+    
+    return altered;
+}
+
+
+
 /*
 getInstrList: constroi a tabela de instrucoes num vetor 
 entrada: nome do arquivo que contem a tabela
@@ -205,15 +482,52 @@ std::vector<Dir> getDirList (std::string dirFileName) {
 
 
 
+/*
+getTables: monta as tabelas de instrucoes e diretivas. sem nome de arquivo usa as tabelas embutidas (sem ler nada do disco)
+entrada: nome do arquivo da tabela de instrucoes e de diretivas (vazios para usar as embutidas)
+saida: tabelas prontas para busca
+*/
+Tables getTables (std::string instrFileName, std::string dirFileName) {
+
+    Tables tables;
+
+    // tabela de instrucoes
+    if (instrFileName.empty()) {
+        for (int i = 0; i < INSTR_TAB_SIZE; ++i)
+            tables.instrList.push_back(Instr(INSTR_TAB[i].name, INSTR_TAB[i].opcode, INSTR_TAB[i].numArg));
+        tables.builtinInstr = 1;
+    } else {
+        tables.instrList = getInstrList(instrFileName);
+        for (unsigned int i = 0; i < tables.instrList.size(); ++i)
+            tables.instrIndex[tables.instrList[i].name] = i; // se houver repeticao, vale a ultima
+    }
+
+    // tabela de diretivas
+    if (dirFileName.empty()) {
+        for (int i = 0; i < DIR_TAB_SIZE; ++i)
+            tables.dirList.push_back(Dir(DIR_TAB[i]));
+        tables.builtinDir = 1;
+    } else {
+        tables.dirList = getDirList(dirFileName);
+        for (unsigned int i = 0; i < tables.dirList.size(); ++i)
+            tables.dirIndex[tables.dirList[i].name] = i;
+    }
+
+    return tables;
+}
+
+
+
 /*
 integerCheck: checa se a string pode ser convertida em um numero sem erros
 entrada: string a ser convertida e inteiro que armazenará o resultado
 saida: inteiro que determina se houve ou não erro na conversão (1 ok, 0 erro)
 */
-int integerCheck (std::string value, int &conv) {
+int integerCheck (std::string_view value, int &conv) {
     
     char *ptr = nullptr; // ponteiro para um caracter
-    const char *cValue = value.c_str(); // array de caracteres equivalente à string
+    std::string cString (value); // strtol precisa de uma string terminada em '\0' (tokens curtos nao alocam)
+    const char *cValue = cString.c_str(); // array de caracteres equivalente à string
     conv = strtol(cValue, &ptr, 10); // converte o array para um numero e altera ptr para o ultimo caracter lido
     
     // se o ultimo caracter lido foi um '\0', entao a string foi convertida em um numero sem nenhum problema
@@ -228,7 +542,7 @@ labelCheck: verifica se o rotulo eh valido
 entrada: rotulo a ser verificado
 saida: inteiro indicando se rotulo é válido
 */
-int labelCheck (std::string label, std::vector<Instr> &instrList, std::vector<Dir> &dirList, int &pos) {
+int labelCheck (std::string_view label, Tables &tables, int &pos) {
     
     // checa se o rótulo está vazio
     if (label.empty())
@@ -252,17 +566,9 @@ int labelCheck (std::string label, std::vector<Instr> &instrList, std::vector<Di
         }
     }
     
-    // verifica se o rótulo tem o nome de uma instrução
-    for (unsigned int i = 0; i < instrList.size(); ++i) {
-        if (label == instrList[i].name)
-            return -4;
-    }
-    
-    // verifica se o rótulo tem o nome de uma diretiva
-    for (unsigned int i = 0; i < dirList.size(); ++i) {
-        if (label == dirList[i].name)
-            return -4;
-    }
+    // verifica se o rótulo tem o nome de uma instrução ou de uma diretiva
+    if (tables.findInstr(label) >= 0 || tables.findDir(label) >= 0)
+        return -4;
         
     return 0;
 }
@@ -270,39 +576,103 @@ int labelCheck (std::string label, std::vector<Instr> &instrList, std::vector<Di
 
 
 /*
-reportList: reporta todos os erros, na ordem das linhas. mostra no terminal a mensagem de erro passada pelo programa, junto com o tipo de erro e a linha
+sortErrors: coloca os erros na ordem das linhas. cada passagem ja produz os seus erros quase sempre em ordem, entao a lista eh
+dividida nas sequencias que ja estao ordenadas e elas sao juntadas duas a duas (erros da mesma linha ficam na ordem em que foram encontrados)
 entrada: lista de erros
-saida: nenhuma (erros no terminal)
+saida: nenhuma (lista ordenada)
+*/
+void sortErrors (std::vector<Error> &errorList) {
+    
+    // onde comeca cada sequencia ordenada (e o final da ultima)
+    std::vector<std::size_t> runs (1, 0);
+    for (std::size_t i = 1; i < errorList.size(); ++i) {
+        if (errorList[i] < errorList[i-1])
+            runs.push_back(i);
+    }
+    runs.push_back(errorList.size());
+    
+    // junta as sequencias vizinhas ate sobrar uma so
+    while (runs.size() > 2) {
+        std::vector<std::size_t> merged (1, 0);
+        for (std::size_t k = 0; k+2 < runs.size(); k += 2) {
+            std::inplace_merge(errorList.begin() + runs[k], errorList.begin() + runs[k+1], errorList.begin() + runs[k+2]);
+            merged.push_back(runs[k+2]);
+        }
+        if (merged.back() != errorList.size())
+            merged.push_back(errorList.size());
+        runs.swap(merged);
+    }
+    
+}
+    
+
+
+/*
+formatErrors: formata os erros no final do buffer. no formato normal (colorido), mostra a mensagem, o tipo, a linha e um apontador
+para a posicao do erro; no formato para maquinas, uma linha sem cores por erro: "arquivo:linha:coluna: erro tipo: mensagem"
+entrada: lista de erros, buffer, nome do arquivo de entrada (so usado no formato para maquinas) e formato (0: normal, 1: para maquinas)
+saida: nenhuma (texto anexado no buffer)
 */
-void reportList (std::vector<Error> &errorList) {
+void formatErrors (std::vector<Error> &errorList, std::string &buffer, const std::string &fileName, int machine) {
     
     // configura algumas cores
-    std::string escRed = "\033[31;1m",
-    escGreen = "\033[32;1m",
-    escYellow = "\033[33;1m",
-    escBlue = "\033[34;1m",
-    escReset = "\033[0m";
-    
-    // mostra os erros
-    for (unsigned int i = 0; i < errorList.size(); ++i) {
-        
-        // erro atual
-        Error error = errorList[i];
+    const char *escRed = "\033[31;1m",
+    *escGreen = "\033[32;1m",
+    *escYellow = "\033[33;1m",
+    *escBlue = "\033[34;1m",
+    *escReset = "\033[0m";
+    
+    for (const Error &error : errorList) {
         
-        // offset para ajustar o apontador de erro na linha
-        std::string offset;
-        for (int i = 0; i < error.pos; ++i)
-            offset.push_back(' ');
+        // para maquinas: a coluna comeca em 1, e um erro sem linha especifica fica sem linha e coluna
+        if (machine) {
+            buffer += fileName;
+            if (error.lineNum != -1) {
+                buffer += ':';
+                buffer += std::to_string(error.lineNum);
+                buffer += ':';
+                buffer += std::to_string(error.pos+1);
+            }
+            buffer += ": erro ";
+            buffer += error.type;
+            buffer += ": ";
+            buffer += error.message;
+            buffer += '\n';
         
         // para o caso de não ter linha específica
-        if (error.lineNum == -1) {
-            std::cout << escRed << "Erro" << escReset << " no arquivo de entrada: " << escYellow << error.message << escReset << " (erro " << error.type << ")" << "\n\n";
+        } else if (error.lineNum == -1) {
+            buffer += escRed;
+            buffer += "Erro";
+            buffer += escReset;
+            buffer += " no arquivo de entrada: ";
+            buffer += escYellow;
+            buffer += error.message;
+            buffer += escReset;
+            buffer += " (erro " + error.type + ")\n\n";
         
-        // quando tem linha específica
+        // quando tem linha específica (o apontador fica embaixo da posicao do erro)
         } else {
-            std::cout << escRed << "Erro" << escReset << " na linha " << escRed << error.lineNum << escReset << " do arquivo de entrada: " << escYellow << error.message << escReset << " (erro " << error.type << ")" << "\n";
-            std::cout << "\t" << escBlue << error.line << escReset << "\n";
-            std::cout << "\t" << offset << escGreen << "^" << escReset << "\n\n";
+            buffer += escRed;
+            buffer += "Erro";
+            buffer += escReset;
+            buffer += " na linha ";
+            buffer += escRed;
+            buffer += std::to_string(error.lineNum);
+            buffer += escReset;
+            buffer += " do arquivo de entrada: ";
+            buffer += escYellow;
+            buffer += error.message;
+            buffer += escReset;
+            buffer += " (erro " + error.type + ")\n\t";
+            buffer += escBlue;
+            buffer += error.line;
+            buffer += escReset;
+            buffer += "\n\t";
+            buffer.append(std::max(error.pos, 0), ' ');
+            buffer += escGreen;
+            buffer += '^';
+            buffer += escReset;
+            buffer += "\n\n";
         }
         
     }
@@ -311,6 +681,78 @@ void reportList (std::vector<Error> &errorList) {
 
 
 
+/*
+reportList: reporta todos os erros, na ordem das linhas. mostra no terminal a mensagem de erro passada pelo programa, junto com o tipo de erro e a linha
+(tudo formatado num buffer so, escrito de uma vez)
+entrada: lista de erros, stream de saida (o terminal, ou um buffer no modo em lote), nome do arquivo de entrada e formato (como em formatErrors)
+saida: nenhuma (erros no terminal)
+*/
+void reportList (std::vector<Error> &errorList, std::ostream &out, const std::string &fileName, int machine) {
+    
+    std::string buffer;
+    formatErrors (errorList, buffer, fileName, machine);
+    out.write(buffer.data(), buffer.size());
+    
+}
+
+
+
+/*
+limitErrors: corta a lista ordenada nos primeiros erros, se houver um limite (--max-errors)
+entrada: lista de erros (ja em ordem), limite (0: sem limite) e se o processamento foi interrompido pelo limite
+saida: aviso a ser mostrado depois dos erros (vazio se nada foi cortado nem interrompido)
+*/
+std::string limitErrors (std::vector<Error> &errorList, int maxErrors, int stopped) {
+    
+    if (maxErrors <= 0 || (!stopped && (int) errorList.size() <= maxErrors))
+        return "";
+    if ((int) errorList.size() > maxErrors)
+        errorList.resize(maxErrors);
+    return "Limite de " + std::to_string(maxErrors) + " erros atingido" + (stopped ? ": o resto do arquivo não foi processado" : "") + "\n";
+}
+
+
+
+/*
+statsReport: mostra o tempo e os contadores de cada etapa de uma execucao
+entrada: estatisticas e stream de saida
+saida: nenhuma
+*/
+void statsReport (RunStats &stats, std::ostream &out) {
+    
+    const char *unitsIn[STATS_NUM_STAGES] = {"linhas lidas", "linhas recebidas", "linhas recebidas", "pendências", "palavras"};
+    const char *unitsOut[STATS_NUM_STAGES] = {"linhas entregues", "linhas entregues", "palavras", "resolvidas", "bytes"};
+    
+    out << "estatísticas: " << stats.total << " s no total\n";
+    for (int stage = 0; stage < STATS_NUM_STAGES; ++stage)
+        out << "    " << STATS_STAGE_NAMES[stage] << ": " << stats.seconds[stage] << " s, " << stats.linesIn[stage] << " " << unitsIn[stage] << ", " << stats.linesOut[stage] << " " << unitsOut[stage] << "\n";
+    out << "    EQU: " << stats.equs << ", macros: " << stats.macros << ", expansões: " << stats.expansions << ", rótulos: " << stats.labels << ", pendências: " << stats.fixups << "\n";
+    out << "    erros: " << stats.errors << ", palavras: " << stats.words << ", bytes lidos: " << stats.bytesRead << ", bytes escritos: " << stats.bytesWritten << "\n";
+    
+}
+
+
+
+/*
+statsJson: escreve as estatisticas de uma execucao em JSON (um objeto com as etapas e os contadores)
+entrada: estatisticas e stream de saida
+saida: nenhuma
+*/
+void statsJson (RunStats &stats, std::ostream &out) {
+    
+    out << "{\"total_seconds\": " << stats.total << ", \"stages\": {";
+    for (int stage = 0; stage < STATS_NUM_STAGES; ++stage) {
+        out << (stage ? ", " : "") << "\"" << STATS_STAGE_NAMES[stage] << "\": {\"seconds\": " << stats.seconds[stage]
+            << ", \"in\": " << stats.linesIn[stage] << ", \"out\": " << stats.linesOut[stage] << "}";
+    }
+    out << "}, \"equs\": " << stats.equs << ", \"macros\": " << stats.macros << ", \"expansions\": " << stats.expansions << ", \"labels\": " << stats.labels
+        << ", \"fixups\": " << stats.fixups << ", \"errors\": " << stats.errors << ", \"words\": " << stats.words
+        << ", \"bytes_read\": " << stats.bytesRead << ", \"bytes_written\": " << stats.bytesWritten << "}\n";
+    
+}
+
+
+
 /*
 operator<: overload do operator < para poder usar std::sort
 entrada: duas structs do tipo Error
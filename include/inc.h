@@ -0,0 +1,2160 @@
+/*      INC.H: montagem incremental. o estado de uma montagem fica guardado num arquivo e, na proxima, so as linhas editadas sao processadas de novo        */
+/*      (uma edicao que nao muda o tamanho do codigo corrige no lugar so as palavras e os erros que ela muda; as outras passam pelo estado inteiro)        */
+
+
+
+/*      DEFINIÇÕES DO FORMATO       */
+
+// arquivo de estado (inteiros de 32 bits em little endian):
+//     magico "SBI1", versao do formato e cabecalho com INC_NUM_FIELDS campos de 64 bits (ver IncField)
+//     partes de tamanho fixo, que o incPatch corrige no lugar: hash, tipo e contadores de cada linha do '.asm', posicao e tamanho do texto
+//     de cada linha da saida das macros, diretorio dos blocos, rotulos da tabela juntada e rotulo de cada identificador
+//     partes de tamanho variavel: textos das linhas, registro de cada bloco (compactado, ver incPutPacked), nomes, EQUs e macros, dicionario de linhas, erros das passagens
+//     anteriores, erros da juntada e erros das pendencias. o incPatch escreve as que mudam no final do arquivo e troca so a posicao delas
+//     (o espaco das antigas volta na proxima gravacao completa)
+// os tokens nao sao guardados: sao refeitos do texto normalizado de cada linha (incLineTokens)
+const char INC_MAGIC[4] = {'S', 'B', 'I', '1'};
+const int INC_VERSION = 3;
+static_assert(sizeof(LineRange) == 12, "LineRange deve ter 3 inteiros de 32 bits, que sao gravados direto no arquivo de estado");
+
+// campos do cabecalho
+enum IncField {
+    INC_FINGERPRINT, // impressao digital das tabelas
+    INC_DIRTY, // 1 enquanto o arquivo esta sendo escrito ou corrigido (um arquivo que ficou assim nao eh usado)
+    INC_BINARY, // formato do '.o' escrito (0: texto, 1: binario)
+    INC_OBJ_SIZE, INC_OBJ_SEC, INC_OBJ_NSEC, // tamanho e data de modificacao do '.o' escrito (se o '.o' mudou por fora, nao da para corrigir ele no lugar)
+    INC_COMPACT, // tamanho do arquivo na ultima gravacao completa
+    INC_NUM_SOURCE, INC_NUM_LINES, INC_NUM_NAMES, INC_NUM_INDEX, INC_NUM_LABELS, INC_NUM_CHUNKS, // linhas do '.asm' e da saida das macros, nomes, identificadores no indice, rotulos e blocos
+    INC_SECTION_TEXT, // -1: não encontrou seção texto, 0: encontrou
+    INC_HASHES, INC_KINDS, INC_CLEAN, INC_OUT_BEFORE, INC_DICT_BEFORE, INC_ERR_BEFORE, // posicao de cada parte
+    INC_LINE_TABLE, INC_CHUNK_TABLE, INC_LABEL_TABLE, INC_INDEX,
+    INC_NAMES, INC_EQUS, INC_DICT, INC_SRC_ERRORS, INC_LINK_ERRORS, INC_RESOLVE_ERRORS,
+    INC_NUM_FIELDS
+};
+const int INC_HEADER_SIZE = 8 + 8*INC_NUM_FIELDS;
+
+// inteiros de 32 bits de cada entrada das partes de tamanho fixo
+const int INC_LINE_WORDS = 3; // linha da saida das macros: posicao do texto (2 inteiros) e tamanho
+const int INC_CHUNK_WORDS = 9; // bloco: ver IncChunkEntry
+const int INC_LABEL_WORDS = 8; // rotulo: ver IncLabelEntry
+
+// numero de linhas de um bloco na montagem incremental (uma edicao monta de novo so os blocos que ela toca)
+const int INC_CHUNK_LINES = 8192;
+
+// tipos de linha do '.asm' no estado
+const char INC_BLANK = 0; // nao gerou nenhuma linha
+const char INC_PLAIN = 1; // gerou exatamente uma linha, que nao depende das vizinhas
+const char INC_SPECIAL = 2; // todo o resto (EQU, IF, macros, rotulo sozinho, erros das passagens anteriores)
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// IncState: tudo o que a montagem incremental guarda de uma montagem para a proxima
+struct IncState {
+    // membros
+    std::uint64_t fingerprint; // impressao digital das tabelas usadas (se mudarem, o estado nao vale mais)
+    Interner symbols; // nomes dos simbolos (os identificadores guardados no estado sao os daqui)
+    std::vector<std::uint64_t> lineHashes; // linha do '.asm' -> hash do texto dela
+    std::vector<char> kinds; // linha do '.asm' -> INC_BLANK, INC_PLAIN ou INC_SPECIAL
+    std::vector<char> clean; // linha do '.asm' -> se as passagens anteriores terminaram tudo o que comecaram ate ela (uma edicao pode comecar logo depois)
+    std::vector<int> outBefore; // linha do '.asm' -> quantas linhas da saida das macros vieram antes dela (com uma posicao a mais no final)
+    std::vector<int> dictBefore; // linha do '.asm' -> quantas entradas do dicionario de linhas vieram antes dela (idem)
+    std::vector<int> errBefore; // linha do '.asm' -> quantos erros das passagens anteriores vieram antes dela (idem)
+    std::vector<std::uint32_t> equIds, equValues; // EQUs (rotulo e valor), na ordem das definicoes
+    std::vector<int> equLines; // linha onde cada EQU foi definido
+    std::vector<std::uint32_t> macroIds; // nomes das macros definidas, em ordem crescente
+    std::string text; // texto das linhas da saida das macros, uma depois da outra
+    std::vector<int> lineStart; // linha da saida das macros -> onde ela comeca em 'text' (com uma posicao a mais no final)
+    std::vector<Token> tokens; // tokens de todas as linhas da saida das macros
+    std::vector<int> firstToken; // linha da saida das macros -> primeiro token dela em 'tokens' (com uma posicao a mais no final)
+    LineMap lineDict; // dicionario de linhas composto, em intervalos (linha da saida das macros -> linha do '.asm')
+    std::vector<Error> srcErrors; // erros das passagens de preprocessamento e de macros
+    std::vector<int> srcMarks; // quantos erros das passagens anteriores vieram ate cada linha da saida das macros
+    std::vector<AsmChunk> chunks; // blocos ja montados
+    // metodos
+    IncState (): fingerprint(0), lineStart(1, 0), firstToken(1, 0) {};
+    int numLines () const { return lineStart.size()-1; };
+    std::string_view line (int l) const { return std::string_view(text).substr(lineStart[l], lineStart[l+1] - lineStart[l]); };
+    TokenLine tokenLine (int l) const { return TokenLine (line(l), tokens.data() + firstToken[l], firstToken[l+1] - firstToken[l]); };
+    // se o nome eh de uma macro definida em algum lugar do arquivo
+    int isMacro (std::uint32_t id) const { return std::binary_search(macroIds.begin(), macroIds.end(), id); };
+};
+
+
+
+// IncChunkEntry: entrada do diretorio dos blocos no arquivo de estado
+struct IncChunkEntry {
+    // membros
+    std::int64_t record; // posicao do registro do bloco no arquivo de estado
+    int begin, end; // linhas do bloco
+    int section; // secao no comeco do bloco
+    int base; // endereco do comeco do bloco no codigo juntado
+    std::int64_t objPos; // posicao da primeira palavra do bloco no '.o'
+    int merged; // se o bloco foi juntado como estava (senao foi montado de novo em serie)
+    // metodos
+    IncChunkEntry (): record(0), begin(0), end(0), section(-1), base(0), objPos(0), merged(0) {};
+    // de e para os INC_CHUNK_WORDS inteiros do arquivo
+    void get (const int *words) {
+        record = (std::int64_t) ((std::uint64_t) (std::uint32_t) words[1] << 32 | (std::uint32_t) words[0]);
+        begin = words[2];
+        end = words[3];
+        section = words[4];
+        base = words[5];
+        objPos = (std::int64_t) ((std::uint64_t) (std::uint32_t) words[7] << 32 | (std::uint32_t) words[6]);
+        merged = words[8];
+    };
+    void put (int *words) const {
+        int fields[INC_CHUNK_WORDS] = {(int) record, (int) (record >> 32), begin, end, section, base, (int) objPos, (int) (objPos >> 32), merged};
+        memcpy(words, fields, sizeof(fields));
+    };
+};
+
+
+
+// IncLabelEntry: rotulo da tabela juntada no arquivo de estado (com as caracteristicas finais, que as pendencias usam)
+struct IncLabelEntry {
+    // membros
+    Label label; // identificador, valor, isDefined, isConst e vectSize
+    int firstChunk; // primeiro bloco que tem o rotulo
+    int defChunk; // primeiro bloco que define o rotulo (-1: nenhum)
+    int redefined; // se um bloco depois dele tambem define o rotulo
+    // metodos
+    IncLabelEntry (): firstChunk(-1), defChunk(-1), redefined(0) {};
+    // de e para os INC_LABEL_WORDS inteiros do arquivo
+    void get (const int *words) {
+        label.id = words[0];
+        label.value = words[1];
+        label.isDefined = words[2];
+        label.isConst = words[3];
+        label.vectSize = words[4];
+        firstChunk = words[5];
+        defChunk = words[6];
+        redefined = words[7];
+    };
+    void put (int *words) const {
+        int fields[INC_LABEL_WORDS] = {(int) label.id, label.value, label.isDefined, label.isConst, label.vectSize, firstChunk, defChunk, redefined};
+        memcpy(words, fields, sizeof(fields));
+    };
+};
+
+
+
+// IncReader: leitura do arquivo de estado mapeado em memoria. ler alem do final marca o arquivo como invalido
+struct IncReader {
+    // membros
+    SourceFile file; // arquivo de estado mapeado
+    std::size_t pos; // posicao da proxima leitura
+    int ok; // se todas as leituras ate agora deram certo
+    // metodos
+    IncReader (): pos(0), ok(0) {};
+    int open (const std::string &fileName) {
+        ok = file.open(fileName);
+        pos = 0;
+        return ok;
+    };
+    // muda a posicao da proxima leitura
+    void seek (std::int64_t at) {
+        if (at < 0 || (std::uint64_t) at > file.size) {
+            ok = 0;
+            at = file.size;
+        }
+        pos = at;
+    };
+    // le um inteiro de 32 bits
+    int word () {
+        if (!ok || file.size - pos < 4) {
+            ok = 0;
+            return 0;
+        }
+        const unsigned char *bytes = (const unsigned char*) file.data + pos;
+        pos += 4;
+        return (std::int32_t) (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((std::uint32_t) bytes[3] << 24));
+    };
+    // le um inteiro de 64 bits (parte baixa primeiro)
+    std::int64_t longWord () {
+        std::uint32_t low = word();
+        return (std::int64_t) ((std::uint64_t) (std::uint32_t) word() << 32 | low);
+    };
+    // confere se cabem no arquivo 'n' elementos de 'unit' bytes a partir da posicao atual
+    std::size_t fits (std::int64_t n, std::size_t unit) {
+        if (!ok || n < 0 || (file.size - pos) / unit < (std::uint64_t) n) {
+            ok = 0;
+            return 0;
+        }
+        return n;
+    };
+    // le o tamanho de um vetor e confere se cabem no arquivo os elementos (de 'unit' bytes cada)
+    std::size_t count (std::size_t unit) { return fits(word(), unit); };
+    // le 'n' bytes (view do mapeamento)
+    std::string_view bytes (std::int64_t n) {
+        n = fits(n, 1);
+        std::string_view result (file.data + pos, n);
+        pos += n;
+        return ok ? result : std::string_view();
+    };
+    // le um texto (tamanho e bytes)
+    std::string_view text () { return bytes(word()); };
+    // le 'n' inteiros de 32 bits seguidos (ja conferidos por fits). em maquinas little endian eh uma copia so
+    void words (void *values, std::size_t n) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if (ok && n > 0) {
+            memcpy(values, file.data + pos, n*4);
+            pos += n*4;
+        }
+#else
+        for (std::size_t i = 0; i < n; ++i) {
+            std::uint32_t value = word();
+            memcpy((char*) values + i*4, &value, 4);
+        }
+#endif
+    };
+    // le um vetor de inteiros: com o tamanho antes dos elementos, ou com 'n' elementos
+    void ints (std::vector<int> &values) {
+        values.resize(count(4));
+        words(values.data(), values.size());
+    };
+    void ints (std::vector<int> &values, std::int64_t n) {
+        values.resize(fits(n, 4));
+        words(values.data(), values.size());
+    };
+    void ids (std::vector<std::uint32_t> &values) {
+        values.resize(count(4));
+        words(values.data(), values.size());
+    };
+    // le um inteiro sem sinal de tamanho variavel (7 bits por byte, o bit mais alto indica que vem mais um byte)
+    std::uint32_t varint () {
+        std::uint32_t value = 0;
+        for (int shift = 0; ok && shift < 35; shift += 7) {
+            if (pos >= file.size)
+                break;
+            unsigned char byte = file.data[pos++];
+            value |= (std::uint32_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        ok = 0;
+        return 0;
+    };
+    // le um vetor compactado por incPutPacked
+    void packed (std::vector<int> &values, int delta) {
+        values.resize(count(1));
+        std::uint32_t last = 0;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            std::uint32_t bits = varint();
+            bits = (bits >> 1) ^ -(bits & 1);
+            values[i] = delta ? (last += bits) : bits;
+        }
+    };
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+std::uint64_t hashLine (std::string_view);
+std::uint64_t incFingerprint (Tables&);
+void incSourceLines (SourceFile&, std::vector<std::uint64_t>&, std::vector<std::size_t>&);
+void incLineTokens (std::string_view, Interner&, std::vector<Token>&);
+int incSameTokens (const TokenLine&);
+void incSplit (IncState&, int, int, std::vector<AsmChunk>&);
+void incRunChunks (std::vector<AsmChunk>&, std::vector<int>&, int, std::pmr::vector<TokenLine>&, const LineDict&, Tables&, int);
+void incTokenLines (IncState&, std::pmr::vector<std::string_view>&, std::pmr::vector<TokenLine>&);
+void incBuild (IncState&, PreState&, Tables&, int);
+int incSpecialLine (IncState&, std::string_view, std::vector<Token>&);
+int incUpdate (IncState&, SourceFile&, std::vector<std::uint64_t>&, std::vector<std::size_t>&, Tables&, int);
+void incUpdateChunks (IncState&, int, int, int, Tables&, int);
+void incPutText (OutputBuffer&, std::string_view);
+void incPutWords (OutputBuffer&, const void*, std::size_t);
+void incPutInts (OutputBuffer&, const std::vector<int>&);
+void incPutIds (OutputBuffer&, const std::vector<std::uint32_t>&);
+void incPutVarint (OutputBuffer&, std::uint32_t);
+void incPutPacked (OutputBuffer&, const std::vector<int>&, int);
+void incPutError (OutputBuffer&, const Error&);
+void incPutErrors (OutputBuffer&, const std::vector<Error>&);
+void incGetError (IncReader&, Error&);
+void incGetErrors (IncReader&, std::vector<Error>&);
+void incPutChunk (OutputBuffer&, AsmChunk&);
+int incGetChunk (IncReader&, AsmChunk&);
+void incPutNames (OutputBuffer&, Interner&, int, std::int64_t);
+int incGetNames (IncReader&, const std::int64_t*, Interner&);
+void incPutTagged (OutputBuffer&, const std::vector<int>&, int, std::vector<Error>::const_iterator);
+int incGetTagged (IncReader&, std::int64_t, int, std::vector<int>&, std::vector<Error>&);
+void incHeaderBytes (const std::int64_t*, char*);
+int incHeader (IncReader&, std::int64_t*, std::uint64_t);
+int incWriteAt (int, std::int64_t, const void*, std::size_t);
+int incWordAt (int, std::int64_t, std::int64_t, int);
+void incSave (IncState&, LinkTrace&, std::vector<Error>&, std::size_t, std::string, std::string, int);
+int incLoad (IncState&, std::string, std::uint64_t);
+int incValidChunk (AsmChunk&);
+int incValid (IncState&);
+LineMap incChunkDict (IncReader&, const std::int64_t*, int, int);
+int incRedoChunk (IncReader&, const std::int64_t*, int, IncChunkEntry&, Interner&, std::vector<int>&, std::vector<std::string>&, Tables&, AsmChunk&, std::vector<int>&, std::vector<int>&, std::vector<Error>&);
+int incPatch (SourceFile&, std::vector<std::uint64_t>&, std::vector<std::size_t>&, std::string, std::uint64_t, std::string, Tables&, std::vector<Error>&, int);
+void assembleIncremental (PreState&, std::string, Tables&, std::vector<Error>&, int, int);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+hashLine: hash FNV-1a de 64 bits do texto de uma linha
+entrada: linha
+saida: hash
+*/
+std::uint64_t hashLine (std::string_view line) {
+    
+    std::uint64_t x = 14695981039346656037ull;
+    for (std::size_t i = 0; i < line.size(); ++i)
+        x = (x ^ (unsigned char) line[i]) * 1099511628211ull;
+    
+    return x;
+}
+
+
+
+/*
+incFingerprint: impressao digital das tabelas de instrucoes e diretivas (e da versao do formato), para saber se o estado guardado foi feito com as mesmas
+entrada: tabelas
+saida: hash
+*/
+std::uint64_t incFingerprint (Tables &tables) {
+    
+    std::string all = std::to_string(INC_VERSION);
+    for (unsigned int i = 0; i < tables.instrList.size(); ++i)
+        all += " " + tables.instrList[i].name + " " + std::to_string(tables.instrList[i].opcode) + " " + std::to_string(tables.instrList[i].numArg);
+    all += " |";
+    for (unsigned int i = 0; i < tables.dirList.size(); ++i)
+        all += " " + tables.dirList[i].name;
+    
+    return hashLine(all);
+}
+
+
+
+/*
+incSourceLines: separa as linhas do '.asm' do mesmo jeito que o preprocessamento le (uma por getLine, ate o eof) e calcula o hash de cada uma
+entrada: arquivo de entrada mapeado
+saida: nenhuma (hash e inicio de cada linha dados por referencia. o arquivo volta para o comeco)
+*/
+void incSourceLines (SourceFile &asmFile, std::vector<std::uint64_t> &hashes, std::vector<std::size_t> &starts) {
+    
+    asmFile.next = 0;
+    asmFile.eofFlag = 0;
+    
+    std::string_view rawLine;
+    while (!asmFile.eof()) {
+        starts.push_back(asmFile.next);
+        asmFile.getLine(rawLine);
+        hashes.push_back(hashLine(rawLine));
+    }
+    
+    asmFile.next = 0;
+    asmFile.eofFlag = 0;
+
+}
+
+
+
+/*
+incLineTokens: refaz os tokens de uma linha da saida das macros a partir do texto normalizado (os tokens sao os pedacos entre os espacos)
+entrada: linha, nomes dos simbolos e lista de tokens
+saida: nenhuma (tokens anexados na lista)
+*/
+void incLineTokens (std::string_view line, Interner &symbols, std::vector<Token> &tokens) {
+    
+    std::size_t column = 0;
+    while (column < line.size()) {
+        std::size_t space = line.find(' ', column);
+        if (space == std::string_view::npos)
+            space = line.size();
+        tokens.push_back(makeToken(line.substr(column, space - column), column, symbols));
+        column = space+1;
+    }
+
+}
+
+
+
+/*
+incSameTokens: ve se os tokens de uma linha sao os que o incLineTokens refaria do texto dela (um token por pedaco entre os espacos)
+entrada: linha com os tokens
+saida: 1 se sao, 0 se nao (a linha nao pode ser guardada so com o texto)
+*/
+int incSameTokens (const TokenLine &line) {
+    
+    int t = 0;
+    std::size_t column = 0;
+    while (column < line.text.size()) {
+        std::size_t space = line.text.find(' ', column);
+        if (space == std::string_view::npos)
+            space = line.text.size();
+        if (t >= line.numTokens || line.tokens[t].column != (int) column || line.tokens[t].size != (int) (space - column))
+            return 0;
+        t++;
+        column = space+1;
+    }
+    
+    return t == line.numTokens;
+}
+
+
+
+/*
+incSplit: divide as linhas [from, to) da saida das macros em blocos de ate INC_CHUNK_LINES linhas, ainda nao montados (pelo menos um bloco, mesmo vazio)
+entrada: estado, intervalo de linhas e lista de blocos
+saida: nenhuma (blocos anexados na lista)
+*/
+void incSplit (IncState &state, int from, int to, std::vector<AsmChunk> &chunks) {
+    
+    int numChunks = (to - from + INC_CHUNK_LINES - 1) / INC_CHUNK_LINES;
+    if (numChunks < 1)
+        numChunks = 1;
+    for (int k = 0; k < numChunks; ++k) {
+        AsmChunk chunk;
+        chunk.labelList.symbols = &state.symbols;
+        chunk.begin = from + (long long) (to - from) * k / numChunks;
+        chunk.end = from + (long long) (to - from) * (k+1) / numChunks;
+        chunks.push_back(std::move(chunk));
+    }
+
+}
+
+
+
+/*
+incRunChunks: executa uma etapa da montagem em blocos (ver chunkWorker) so nos blocos pedidos
+entrada: blocos, indices dos blocos pedidos, etapa, linhas, dicionario de linhas, tabelas e numero de threads
+saida: nenhuma (blocos pedidos preenchidos)
+*/
+void incRunChunks (std::vector<AsmChunk> &chunks, std::vector<int> &which, int phase, std::pmr::vector<TokenLine> &lines, const LineDict &lineDict, Tables &tables, int numThreads) {
+    
+    if (which.empty())
+        return;
+    
+    std::vector<AsmChunk> work;
+    for (unsigned int i = 0; i < which.size(); ++i)
+        work.push_back(std::move(chunks[which[i]]));
+    
+    runChunks (work, std::min(numThreads, (int) work.size()), phase, lines, lineDict, tables);
+    
+    for (unsigned int i = 0; i < which.size(); ++i)
+        chunks[which[i]] = std::move(work[i]);
+
+}
+
+
+
+/*
+incTokenLines: monta as views das linhas da saida das macros guardadas no estado (so com o texto, e com os tokens)
+entrada: estado
+saida: nenhuma (linhas dadas por referencia, validas enquanto o estado nao mudar)
+*/
+void incTokenLines (IncState &state, std::pmr::vector<std::string_view> &lines, std::pmr::vector<TokenLine> &tokenLines) {
+    
+    lines.clear();
+    tokenLines.clear();
+    lines.reserve(state.numLines());
+    tokenLines.reserve(state.numLines());
+    for (int l = 0; l < state.numLines(); ++l) {
+        tokenLines.push_back(state.tokenLine(l));
+        lines.push_back(tokenLines.back().text);
+    }
+
+}
+
+
+
+/*
+incBuild: montagem completa que preenche o estado: as passagens de preprocessamento e de macros rodam registrando o que fizeram com cada linha, e as linhas sao montadas em blocos
+entrada: estado (com os hashes das linhas do '.asm'), estado do preprocessamento (com o arquivo aberto), tabelas e numero de threads
+saida: nenhuma (estado preenchido)
+*/
+void incBuild (IncState &state, PreState &pre, Tables &tables, int numThreads) {
+    
+    // le o arquivo desde o comeco (a tentativa de atualizar o estado pode ter lido algumas linhas)
+    pre.asmFile.next = 0;
+    pre.asmFile.eofFlag = 0;
+    
+    McrState mcr;
+    LineTrace trace;
+    pre.trace = &trace;
+    mcr.trace = &trace;
+    
+    // le todas as linhas da passagem de macros (os erros dessas passagens ficam separados, como na montagem em blocos)
+    std::vector<Error> errorList;
+    TokenLine line;
+    while (mcrNextLine(mcr, pre, line, tables, errorList)) {
+        state.text.append(line.text);
+        state.lineStart.push_back(state.text.size());
+        state.tokens.insert(state.tokens.end(), line.tokens, line.tokens + line.numTokens);
+        state.firstToken.push_back(state.tokens.size());
+        state.srcMarks.push_back(errorList.size());
+    }
+    state.srcErrors.swap(errorList);
+    state.lineDict = LineDict (mcr.lineMap, pre.lineDict).compose();
+    pre.trace = nullptr;
+    
+    // copia os nomes na mesma ordem, entao os identificadores continuam os mesmos
+    for (int id = 0; id < pre.symbols.size(); ++id)
+        state.symbols.intern(pre.symbols.name(id));
+    
+    // o registro pode ter uma linha a mais que o arquivo (um IF na ultima linha tenta pular a seguinte)
+    int numSource = state.lineHashes.size();
+    trace.flags.resize(numSource, TRACE_SPECIAL);
+    trace.errors.resize(numSource, state.srcErrors.size());
+    trace.outputs.resize(numSource, 0);
+    trace.entries.resize(numSource, 0);
+    
+    // tipo de cada linha e se a passagem de macros ainda dependia dela (uma linha que nao gerou saida herda o estado da ultima que gerou)
+    int mcrOpen = 0;
+    state.outBefore.assign(1, 0);
+    state.dictBefore.assign(1, 0);
+    for (int i = 0; i < numSource; ++i) {
+        char flags = trace.flags[i];
+        if (flags & TRACE_OUTPUT)
+            mcrOpen = (flags & TRACE_MCR_OPEN) != 0;
+        state.clean.push_back(!(flags & TRACE_PRE_OPEN) && !mcrOpen);
+        if (flags & TRACE_SPECIAL)
+            state.kinds.push_back(INC_SPECIAL);
+        else
+            state.kinds.push_back((flags & TRACE_OUTPUT) ? INC_PLAIN : INC_BLANK);
+        state.errBefore.push_back(trace.errors[i]);
+        state.outBefore.push_back(state.outBefore.back() + trace.outputs[i]);
+        state.dictBefore.push_back(state.dictBefore.back() + trace.entries[i]);
+    }
+    state.errBefore.push_back(state.srcErrors.size());
+    
+    // EQUs e macros definidos
+    for (unsigned int e = 0; e < trace.equIds.size(); ++e) {
+        state.equIds.push_back(trace.equIds[e]);
+        state.equValues.push_back(pre.equTable.values[trace.equIds[e]]);
+        state.equLines.push_back(trace.equLines[e]);
+    }
+    for (unsigned int id = 0; id < mcr.macroIndex.size(); ++id) {
+        if (mcr.macroIndex[id] >= 0)
+            state.macroIds.push_back(id);
+    }
+    
+    // monta os blocos
+    RunArena arena;
+    std::pmr::vector<std::string_view> lines (arena.get());
+    std::pmr::vector<TokenLine> tokenLines (arena.get());
+    incTokenLines (state, lines, tokenLines);
+    incSplit (state, 0, state.numLines(), state.chunks);
+    std::vector<int> all;
+    for (unsigned int k = 0; k < state.chunks.size(); ++k)
+        all.push_back(k);
+    incRunChunks (state.chunks, all, 0, tokenLines, state.lineDict, tables, numThreads);
+    int section = -1;
+    for (unsigned int k = 0; k < state.chunks.size(); ++k) {
+        state.chunks[k].section = section;
+        if (state.chunks[k].endSection != -2)
+            section = state.chunks[k].endSection;
+    }
+    incRunChunks (state.chunks, all, 1, tokenLines, state.lineDict, tables, numThreads);
+
+}
+
+
+
+/*
+incSpecialLine: ve se uma linha nova (ja lida pelo preprocessamento) poderia fazer alguma coisa alem de gerar a propria linha: definir EQU ou macro, pular ou juntar linhas, chamar ou redefinir macro
+entrada: estado, linha e tokens dela
+saida: 1 se a linha precisa da montagem completa, 0 se nao
+*/
+int incSpecialLine (IncState &state, std::string_view line, std::vector<Token> &tokens) {
+    
+    std::string_view first = line.substr(tokens[0].column, tokens[0].size);
+    
+    if (tokens[0].kind == TOKEN_LABEL) {
+        // rotulo sozinho (junta com a proxima linha), EQU ou definicao de macro
+        if (tokens.size() == 1)
+            return 1;
+        std::string_view second = line.substr(tokens[1].column, tokens[1].size);
+        if (second == "EQU" || second == "MACRO")
+            return 1;
+    } else if (first == "IF")
+        return 1;
+    
+    // chamada (ou redefinicao) de macro, mesmo que ela so seja definida depois
+    return state.isMacro(tokens[0].id) || state.isMacro(state.symbols.find(first));
+}
+
+
+
+/*
+incUpdate: atualiza o estado para o arquivo editado, processando de novo so as linhas que mudaram:
+    - as linhas iguais no comeco e no final do arquivo sao reaproveitadas
+    - as linhas trocadas (antes e depois da edicao) so podem ser linhas comuns, que geram uma linha so sem depender das vizinhas,
+      e a edicao tem que comecar num ponto em que as passagens anteriores nao tinham nada pendente
+    - as linhas novas sao lidas com os EQUs definidos antes delas e os blocos que elas tocam sao montados de novo
+entrada: estado da montagem anterior, arquivo de entrada mapeado, hash e inicio de cada linha dele, tabelas e numero de threads
+saida: 1 se o estado foi atualizado, 0 se a edicao precisa da montagem completa (nesse caso o estado nao foi alterado)
+*/
+int incUpdate (IncState &state, SourceFile &asmFile, std::vector<std::uint64_t> &hashes, std::vector<std::size_t> &starts, Tables &tables, int numThreads) {
+    
+    int oldSize = state.lineHashes.size(), newSize = hashes.size();
+    
+    // linhas iguais no comeco e no final
+    int prefix = 0, suffix = 0;
+    while (prefix < oldSize && prefix < newSize && state.lineHashes[prefix] == hashes[prefix])
+        prefix++;
+    while (suffix < oldSize-prefix && suffix < newSize-prefix && state.lineHashes[oldSize-1-suffix] == hashes[newSize-1-suffix])
+        suffix++;
+    int oldCount = oldSize - prefix - suffix, newCount = newSize - prefix - suffix; // linhas trocadas do '.asm'
+    int oldEnd = prefix + oldCount; // linhas [prefix, oldEnd) sairam
+    
+    // a edicao tem que comecar num ponto limpo e so tirar linhas comuns
+    if (prefix > 0 && !state.clean[prefix-1])
+        return 0;
+    for (int i = prefix; i < oldEnd; ++i) {
+        if (state.kinds[i] == INC_SPECIAL)
+            return 0;
+    }
+    
+    // linhas da saida das macros que sairam: [first, last). o dicionario precisa ter uma entrada para cada linha
+    // (uma linha com rotulo depois de uma chamada de macro pode colocar menos de uma entrada nele, e as linhas seguintes leriam alem do final)
+    int first = state.outBefore[prefix], last = state.outBefore[oldEnd];
+    if (state.dictBefore[oldSize] < state.outBefore[oldSize])
+        return 0;
+    
+    // le as linhas novas com os EQUs definidos antes delas (as linhas trocadas nao definem EQU)
+    EquTable equTable;
+    equTable.symbols = &state.symbols;
+    for (unsigned int e = 0; e < state.equIds.size(); ++e) {
+        if (state.equLines[e] <= prefix)
+            equTable.define(state.equIds[e], state.equValues[e]);
+    }
+    std::string text;
+    std::vector<int> lineEnd, lineSource; // fim de cada linha nova em 'text' e linha do '.asm' de onde ela veio
+    std::vector<Token> tokens;
+    std::vector<int> tokenEnd; // fim dos tokens de cada linha nova em 'tokens'
+    std::vector<char> kinds;
+    std::string line;
+    std::vector<Token> lineTokens;
+    for (int j = 0; j < newCount; ++j) {
+        asmFile.next = starts[prefix+j];
+        asmFile.eofFlag = 0;
+        preReadLine (line, lineTokens, asmFile, equTable);
+        if (line.empty()) {
+            kinds.push_back(INC_BLANK);
+            continue;
+        }
+        if (incSpecialLine(state, line, lineTokens))
+            return 0;
+        kinds.push_back(INC_PLAIN);
+        text.append(line);
+        lineEnd.push_back(text.size());
+        tokens.insert(tokens.end(), lineTokens.begin(), lineTokens.end());
+        tokenEnd.push_back(tokens.size());
+        lineSource.push_back(prefix+j+1);
+    }
+    
+    int numOutputs = lineSource.size();
+    int delta = numOutputs - (last - first); // quantas linhas a saida das macros ganhou
+    int sourceDelta = newCount - oldCount; // quantas linhas o '.asm' ganhou
+    
+    // linhas do '.asm': as do final andam 'sourceDelta' posicoes
+    state.lineHashes = hashes;
+    state.kinds.erase(state.kinds.begin()+prefix, state.kinds.begin()+oldEnd);
+    state.kinds.insert(state.kinds.begin()+prefix, kinds.begin(), kinds.end());
+    state.clean.erase(state.clean.begin()+prefix, state.clean.begin()+oldEnd);
+    state.clean.insert(state.clean.begin()+prefix, newCount, (char) 1);
+    std::vector<int> outBefore (newSize+1), dictBefore (newSize+1), errBefore (newSize+1);
+    for (int i = 0; i <= newSize; ++i) {
+        if (i <= prefix) {
+            outBefore[i] = state.outBefore[i];
+            dictBefore[i] = state.dictBefore[i];
+            errBefore[i] = state.errBefore[i];
+        } else if (i < prefix+newCount) {
+            outBefore[i] = outBefore[i-1] + (kinds[i-1-prefix] == INC_PLAIN);
+            dictBefore[i] = dictBefore[i-1] + (kinds[i-1-prefix] == INC_PLAIN);
+            errBefore[i] = state.errBefore[prefix];
+        } else {
+            outBefore[i] = state.outBefore[i-sourceDelta] + delta;
+            dictBefore[i] = state.dictBefore[i-sourceDelta] + delta;
+            errBefore[i] = state.errBefore[i-sourceDelta];
+        }
+    }
+    state.outBefore.swap(outBefore);
+    state.dictBefore.swap(dictBefore);
+    state.errBefore.swap(errBefore);
+    
+    // numero de uma linha do '.asm' guardado no estado, depois da edicao
+    auto moved = [oldEnd, sourceDelta] (int lineNum) { return (lineNum > oldEnd) ? lineNum + sourceDelta : lineNum; };
+    for (unsigned int e = 0; e < state.equLines.size(); ++e)
+        state.equLines[e] = moved(state.equLines[e]);
+    for (unsigned int e = 0; e < state.srcErrors.size(); ++e)
+        state.srcErrors[e].lineNum = moved(state.srcErrors[e].lineNum);
+    
+    // linhas da saida das macros: troca [first, last) pelas novas
+    int textFirst = state.lineStart[first], textLast = state.lineStart[last];
+    int textDelta = text.size() - (textLast - textFirst);
+    state.text.replace(textFirst, textLast - textFirst, text);
+    for (unsigned int l = 0; l < lineEnd.size(); ++l)
+        lineEnd[l] += textFirst;
+    for (unsigned int l = last+1; l < state.lineStart.size(); ++l)
+        state.lineStart[l] += textDelta;
+    state.lineStart.erase(state.lineStart.begin()+first+1, state.lineStart.begin()+last+1);
+    state.lineStart.insert(state.lineStart.begin()+first+1, lineEnd.begin(), lineEnd.end());
+    
+    int tokenFirst = state.firstToken[first], tokenLast = state.firstToken[last];
+    int tokenDelta = tokens.size() - (tokenLast - tokenFirst);
+    state.tokens.erase(state.tokens.begin()+tokenFirst, state.tokens.begin()+tokenLast);
+    state.tokens.insert(state.tokens.begin()+tokenFirst, tokens.begin(), tokens.end());
+    for (unsigned int l = 0; l < tokenEnd.size(); ++l)
+        tokenEnd[l] += tokenFirst;
+    for (unsigned int l = last+1; l < state.firstToken.size(); ++l)
+        state.firstToken[l] += tokenDelta;
+    state.firstToken.erase(state.firstToken.begin()+first+1, state.firstToken.begin()+last+1);
+    state.firstToken.insert(state.firstToken.begin()+first+1, tokenEnd.begin(), tokenEnd.end());
+    
+    int dictFirst = state.dictBefore[prefix], dictLast = dictFirst + (last - first); // entradas do dicionario das linhas que sairam
+    state.lineDict.splice(dictFirst, dictLast, lineSource, oldEnd, sourceDelta); // as entradas seguintes passam pelo 'moved'
+    
+    state.srcMarks.erase(state.srcMarks.begin()+first, state.srcMarks.begin()+last);
+    state.srcMarks.insert(state.srcMarks.begin()+first, numOutputs, state.errBefore[prefix]);
+    
+    // monta de novo os blocos que a edicao tocou
+    incUpdateChunks (state, first, last, delta, tables, numThreads);
+    
+    return 1;
+}
+
+
+
+/*
+incUpdateChunks: troca os blocos que tinham as linhas [first, last) da saida das macros por blocos novos, montados de novo, e ajusta os outros.
+os blocos seguintes andam 'delta' linhas e os numeros de linha dos erros de todos sao lidos de novo do dicionario. um bloco cuja secao no comeco mudou tambem eh montado de novo
+entrada: estado (com as linhas e o dicionario ja trocados), linhas trocadas, quantas linhas a saida ganhou, tabelas e numero de threads
+saida: nenhuma (blocos do estado atualizados)
+*/
+void incUpdateChunks (IncState &state, int first, int last, int delta, Tables &tables, int numThreads) {
+    
+    std::vector<AsmChunk> &chunks = state.chunks;
+    
+    // primeiro e ultimo bloco tocados (o ultimo bloco que comeca ate a linha)
+    auto chunkOf = [&chunks] (int line) { return (int) (std::upper_bound(chunks.begin(), chunks.end(), line, [] (int l, const AsmChunk &c) { return l < c.begin; }) - chunks.begin()) - 1; };
+    int firstChunk = chunkOf(first);
+    int lastChunk = (last > first) ? chunkOf(last-1) : firstChunk;
+    int from = chunks[firstChunk].begin, to = chunks[lastChunk].end + delta;
+    
+    std::vector<AsmChunk> updated;
+    std::vector<char> redo;
+    for (int k = 0; k < (int) chunks.size(); ++k) {
+        
+        // blocos tocados: trocados pelos novos (um intervalo vazio so vira bloco se nao sobrar nenhum outro)
+        if (k == firstChunk && (from < to || lastChunk - firstChunk + 1 == (int) chunks.size())) {
+            incSplit (state, from, to, updated);
+            redo.resize(updated.size(), 1);
+        }
+        if (k >= firstChunk && k <= lastChunk)
+            continue;
+        
+        // bloco reaproveitado: os depois da edicao andam 'delta' linhas
+        AsmChunk &chunk = chunks[k];
+        if (k > lastChunk && delta != 0) {
+            chunk.begin += delta;
+            chunk.end += delta;
+            if (chunk.textLine >= 0)
+                chunk.textLine += delta;
+            if (chunk.dataLine >= 0)
+                chunk.dataLine += delta;
+            for (int i = 0; i < chunk.labelList.fixups.size(); ++i)
+                chunk.labelList.fixups.line[i] += delta;
+        }
+        
+        // os erros da montagem de uma linha levam a entrada do dicionario na posicao dela, que pode ter mudado
+        int e = 0;
+        for (int l = chunk.begin; l < chunk.end; ++l) {
+            for (; e < chunk.errorMarks[l-chunk.begin]; ++e) {
+                if (l < state.lineDict.size())
+                    chunk.errorList[e].lineNum = state.lineDict[l];
+            }
+        }
+        updated.push_back(std::move(chunk));
+        redo.push_back(0);
+    }
+    chunks.swap(updated);
+    
+    RunArena arena;
+    std::pmr::vector<std::string_view> lines (arena.get());
+    std::pmr::vector<TokenLine> tokenLines (arena.get());
+    incTokenLines (state, lines, tokenLines);
+    
+    // secao no final dos blocos novos, e blocos cuja secao no comeco mudou
+    std::vector<int> which;
+    for (unsigned int k = 0; k < chunks.size(); ++k) {
+        if (redo[k])
+            which.push_back(k);
+    }
+    incRunChunks (chunks, which, 0, tokenLines, state.lineDict, tables, numThreads);
+    int section = -1;
+    for (unsigned int k = 0; k < chunks.size(); ++k) {
+        if (!redo[k] && chunks[k].section != section) {
+            AsmChunk &chunk = chunks[k];
+            chunk.labelList = SymbolTable (state.symbols);
+            chunk.machineCode.clear();
+            chunk.errorList.clear();
+            chunk.errorMarks.clear();
+            chunk.sectionText = -1;
+            redo[k] = 1;
+        }
+        chunks[k].section = section;
+        if (chunks[k].endSection != -2)
+            section = chunks[k].endSection;
+    }
+    
+    which.clear();
+    for (unsigned int k = 0; k < chunks.size(); ++k) {
+        if (redo[k])
+            which.push_back(k);
+    }
+    incRunChunks (chunks, which, 1, tokenLines, state.lineDict, tables, numThreads);
+
+}
+
+
+
+/*
+incPutText: escreve um texto no arquivo de estado (tamanho e bytes)
+entrada: saida e texto
+saida: nenhuma
+*/
+void incPutText (OutputBuffer &outFile, std::string_view text) {
+    
+    putWord (outFile, text.size());
+    outFile.putBytes(text.data(), text.size());
+
+}
+
+
+
+/*
+incPutWords: escreve inteiros de 32 bits seguidos no arquivo de estado (em maquinas little endian, copiando a memoria direto)
+entrada: saida, ponteiro para os inteiros e quantos sao
+saida: nenhuma
+*/
+void incPutWords (OutputBuffer &outFile, const void *values, std::size_t n) {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (n > 0)
+        outFile.putBytes((const char*) values, n*4);
+#else
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint32_t value;
+        memcpy(&value, (const char*) values + i*4, 4);
+        putWord (outFile, value);
+    }
+#endif
+
+}
+
+
+
+/*
+incPutInts: escreve um vetor de inteiros no arquivo de estado (tamanho e elementos)
+entrada: saida e vetor
+saida: nenhuma
+*/
+void incPutInts (OutputBuffer &outFile, const std::vector<int> &values) {
+    
+    putWord (outFile, values.size());
+    incPutWords (outFile, values.data(), values.size());
+
+}
+
+
+
+/*
+incPutIds: escreve um vetor de identificadores no arquivo de estado (tamanho e elementos)
+entrada: saida e vetor
+saida: nenhuma
+*/
+void incPutIds (OutputBuffer &outFile, const std::vector<std::uint32_t> &values) {
+    
+    putWord (outFile, values.size());
+    incPutWords (outFile, values.data(), values.size());
+
+}
+
+
+
+/*
+incPutVarint: escreve um inteiro sem sinal com tamanho variavel (7 bits por byte, o bit mais alto indica que vem mais um byte)
+entrada: saida e valor
+saida: nenhuma
+*/
+void incPutVarint (OutputBuffer &outFile, std::uint32_t value) {
+    
+    char bytes[5];
+    int n = 0;
+    for (; value >= 0x80; value >>= 7)
+        bytes[n++] = (char) ((value & 0x7F) | 0x80);
+    bytes[n++] = (char) value;
+    outFile.putBytes(bytes, n);
+
+}
+
+
+
+/*
+incPutPacked: escreve um vetor de inteiros compactado (quantidade, e cada valor, ou a diferenca para o anterior, com o sinal no bit mais baixo e
+tamanho variavel). enderecos, linhas e indices de um bloco crescem devagar ou sao pequenos, e ocupam 1 ou 2 bytes em vez de 4
+entrada: saida, valores e se guarda as diferencas
+saida: nenhuma
+*/
+void incPutPacked (OutputBuffer &outFile, const std::vector<int> &values, int delta) {
+    
+    putWord (outFile, values.size());
+    std::uint32_t last = 0;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        std::uint32_t bits = delta ? (std::uint32_t) values[i] - last : (std::uint32_t) values[i];
+        last = values[i];
+        incPutVarint (outFile, (bits << 1) ^ -(bits >> 31));
+    }
+
+}
+
+
+
+/*
+incPutError: escreve um erro no arquivo de estado
+entrada: saida e erro
+saida: nenhuma
+*/
+void incPutError (OutputBuffer &outFile, const Error &error) {
+    
+    incPutText (outFile, error.message);
+    incPutText (outFile, error.type);
+    putWord (outFile, error.lineNum);
+    incPutText (outFile, error.line);
+    putWord (outFile, error.pos);
+
+}
+
+
+
+/*
+incPutErrors: escreve uma lista de erros no arquivo de estado
+entrada: saida e lista de erros
+saida: nenhuma
+*/
+void incPutErrors (OutputBuffer &outFile, const std::vector<Error> &errorList) {
+    
+    putWord (outFile, errorList.size());
+    for (unsigned int i = 0; i < errorList.size(); ++i)
+        incPutError (outFile, errorList[i]);
+
+}
+
+
+
+/*
+incGetError: le um erro do arquivo de estado
+entrada: leitura do arquivo e erro
+saida: nenhuma (erro preenchido)
+*/
+void incGetError (IncReader &inFile, Error &error) {
+    
+    error.message = inFile.text();
+    error.type = inFile.text();
+    error.lineNum = inFile.word();
+    error.line = inFile.text();
+    error.pos = inFile.word();
+
+}
+
+
+
+/*
+incGetErrors: le uma lista de erros do arquivo de estado
+entrada: leitura do arquivo e lista de erros
+saida: nenhuma (lista preenchida)
+*/
+void incGetErrors (IncReader &inFile, std::vector<Error> &errorList) {
+    
+    errorList.resize(inFile.count(20));
+    for (unsigned int i = 0; i < errorList.size(); ++i)
+        incGetError (inFile, errorList[i]);
+
+}
+
+
+
+/*
+incPutChunk: escreve o registro de um bloco no arquivo de estado (o comeco, o fim e a secao no comeco ficam no diretorio dos blocos)
+entrada: saida e bloco
+saida: nenhuma
+*/
+void incPutChunk (OutputBuffer &outFile, AsmChunk &chunk) {
+    
+    putWord (outFile, chunk.endSection);
+    putWord (outFile, chunk.textLine);
+    putWord (outFile, chunk.dataLine);
+    putWord (outFile, chunk.sectionText);
+    // rotulos: identificador, valor e vectSize, e isDefined (0 ou 1) e isConst (0 a 2) num byte so
+    std::vector<int> fields[3];
+    for (int i = 0; i < chunk.labelList.size(); ++i) {
+        Label &label = chunk.labelList[i];
+        fields[0].push_back(label.id);
+        fields[1].push_back(label.value);
+        fields[2].push_back(label.vectSize);
+    }
+    incPutPacked (outFile, fields[0], 0);
+    incPutPacked (outFile, fields[1], 0);
+    incPutPacked (outFile, fields[2], 0);
+    for (int i = 0; i < chunk.labelList.size(); ++i)
+        outFile.putChar(chunk.labelList[i].isDefined + 2*chunk.labelList[i].isConst);
+    incPutPacked (outFile, chunk.labelList.fixups.label, 0);
+    incPutPacked (outFile, chunk.labelList.fixups.address, 1);
+    incPutPacked (outFile, chunk.labelList.fixups.kind, 0);
+    incPutPacked (outFile, chunk.labelList.fixups.column, 0);
+    incPutPacked (outFile, chunk.labelList.fixups.line, 1);
+    incPutPacked (outFile, chunk.labelList.resolvedList, 1);
+    incPutPacked (outFile, chunk.machineCode, 0);
+    putWord (outFile, chunk.textAddr);
+    putWord (outFile, chunk.dataAddr);
+    incPutErrors (outFile, chunk.errorList);
+    incPutPacked (outFile, chunk.errorMarks, 1);
+
+}
+
+
+
+/*
+incGetChunk: le o registro de um bloco do arquivo de estado
+entrada: leitura do arquivo (na posicao do registro) e bloco vazio (com os nomes dos simbolos)
+saida: 1 se o registro foi lido, 0 se esta corrompido
+*/
+int incGetChunk (IncReader &inFile, AsmChunk &chunk) {
+    
+    chunk.endSection = inFile.word();
+    chunk.textLine = inFile.word();
+    chunk.dataLine = inFile.word();
+    chunk.sectionText = inFile.word();
+    std::vector<int> fields[3];
+    for (int f = 0; f < 3; ++f)
+        inFile.packed(fields[f], 0);
+    int numLabels = fields[0].size();
+    std::string_view flags = inFile.bytes(numLabels);
+    if (!inFile.ok || fields[1].size() != fields[0].size() || fields[2].size() != fields[0].size())
+        return 0;
+    for (int i = 0; i < numLabels; ++i) {
+        std::uint32_t id = fields[0][i];
+        if (id >= (std::uint32_t) chunk.labelList.symbols->size() || chunk.labelList.find(id) >= 0)
+            return 0;
+        Label &label = chunk.labelList[chunk.labelList.insert(id)];
+        label.value = fields[1][i];
+        label.isDefined = flags[i] & 1;
+        label.isConst = (flags[i] >> 1) & 3;
+        label.vectSize = fields[2][i];
+    }
+    inFile.packed(chunk.labelList.fixups.label, 0);
+    inFile.packed(chunk.labelList.fixups.address, 1);
+    inFile.packed(chunk.labelList.fixups.kind, 0);
+    inFile.packed(chunk.labelList.fixups.column, 0);
+    inFile.packed(chunk.labelList.fixups.line, 1);
+    inFile.packed(chunk.labelList.resolvedList, 1);
+    inFile.packed(chunk.machineCode, 0);
+    chunk.textAddr = inFile.word();
+    chunk.dataAddr = inFile.word();
+    incGetErrors (inFile, chunk.errorList);
+    inFile.packed(chunk.errorMarks, 1);
+    
+    return inFile.ok;
+}
+
+
+
+/*
+incPutNames: escreve um bloco de nomes no arquivo de estado: posicao do bloco anterior (0: nenhum), primeiro identificador, quantidade e os nomes
+entrada: saida, nomes, primeiro identificador do bloco e posicao do bloco anterior
+saida: nenhuma
+*/
+void incPutNames (OutputBuffer &outFile, Interner &symbols, int first, std::int64_t previous) {
+    
+    putWord (outFile, previous);
+    putWord (outFile, previous >> 32);
+    putWord (outFile, first);
+    putWord (outFile, symbols.size() - first);
+    for (int id = first; id < symbols.size(); ++id)
+        incPutText (outFile, symbols.name(id));
+
+}
+
+
+
+/*
+incGetNames: le os nomes do arquivo de estado (blocos encadeados do ultimo para o primeiro, ver incPutNames) e interna na ordem dos identificadores
+entrada: leitura do arquivo, cabecalho e nomes (vazio)
+saida: 1 se os nomes foram lidos, 0 se o arquivo esta corrompido
+*/
+int incGetNames (IncReader &inFile, const std::int64_t *header, Interner &symbols) {
+    
+    // blocos, do ultimo para o primeiro (cada um foi escrito depois do anterior, entao as posicoes diminuem)
+    std::vector<std::int64_t> blocks;
+    for (std::int64_t at = header[INC_NAMES]; at != 0 && inFile.ok; ) {
+        if (!blocks.empty() && at >= blocks.back())
+            return 0;
+        blocks.push_back(at);
+        inFile.seek(at);
+        at = inFile.longWord();
+    }
+    
+    for (int b = blocks.size()-1; b >= 0 && inFile.ok; --b) {
+        inFile.seek(blocks[b] + 8);
+        if (inFile.word() != symbols.size())
+            return 0;
+        int numNames = inFile.count(4);
+        for (int i = 0; i < numNames && inFile.ok; ++i) {
+            if (symbols.intern(inFile.text()) != (std::uint32_t) symbols.size()-1)
+                return 0;
+        }
+    }
+    
+    return inFile.ok && symbols.size() == header[INC_NUM_NAMES];
+}
+
+
+
+/*
+incPutTagged: escreve uma lista de erros com inteiros de marcacao antes de cada um (quantidade, e para cada erro as marcas e o erro)
+entrada: saida, marcas de todos os erros, marcas por erro e primeiro erro
+saida: nenhuma
+*/
+void incPutTagged (OutputBuffer &outFile, const std::vector<int> &tags, int numTags, std::vector<Error>::const_iterator error) {
+    
+    int numErrors = tags.size() / numTags;
+    putWord (outFile, numErrors);
+    for (int e = 0; e < numErrors; ++e, ++error) {
+        incPutWords (outFile, tags.data() + e*numTags, numTags);
+        incPutError (outFile, *error);
+    }
+
+}
+
+
+
+/*
+incGetTagged: le uma lista de erros com marcas (ver incPutTagged)
+entrada: leitura do arquivo, posicao da lista, marcas por erro, marcas e erros (vazios)
+saida: 1 se a lista foi lida, 0 se o arquivo esta corrompido
+*/
+int incGetTagged (IncReader &inFile, std::int64_t at, int numTags, std::vector<int> &tags, std::vector<Error> &errorList) {
+    
+    inFile.seek(at);
+    int numErrors = inFile.count(4*numTags + 20);
+    tags.resize(numErrors * numTags);
+    errorList.resize(numErrors);
+    for (int e = 0; e < numErrors && inFile.ok; ++e) {
+        inFile.words(tags.data() + e*numTags, numTags);
+        incGetError (inFile, errorList[e]);
+    }
+    
+    return inFile.ok;
+}
+
+
+
+/*
+incHeaderBytes: monta os bytes do comeco do arquivo de estado (magico, versao e campos do cabecalho)
+entrada: campos e bytes (INC_HEADER_SIZE)
+saida: nenhuma
+*/
+void incHeaderBytes (const std::int64_t *header, char *bytes) {
+    
+    memcpy(bytes, INC_MAGIC, 4);
+    for (int b = 0; b < 4; ++b)
+        bytes[4+b] = (INC_VERSION >> (8*b)) & 0xFF;
+    for (int f = 0; f < INC_NUM_FIELDS; ++f) {
+        for (int b = 0; b < 8; ++b)
+            bytes[8 + 8*f + b] = ((std::uint64_t) header[f] >> (8*b)) & 0xFF;
+    }
+
+}
+
+
+
+/*
+incHeader: le e confere o cabecalho do arquivo de estado
+entrada: leitura do arquivo (aberto), campos e impressao digital das tabelas atuais
+saida: 1 se o arquivo eh desta versao, foi feito com as mesmas tabelas e foi escrito ate o final, 0 se nao
+*/
+int incHeader (IncReader &inFile, std::int64_t *header, std::uint64_t fingerprint) {
+    
+    if (inFile.file.size < INC_HEADER_SIZE || memcmp(inFile.file.data, INC_MAGIC, 4) != 0)
+        return 0;
+    inFile.seek(4);
+    if (inFile.word() != INC_VERSION)
+        return 0;
+    for (int f = 0; f < INC_NUM_FIELDS; ++f)
+        header[f] = inFile.longWord();
+    if ((std::uint64_t) header[INC_FINGERPRINT] != fingerprint || header[INC_DIRTY] != 0)
+        return 0;
+    
+    // contadores que cabem num int e partes dentro do arquivo
+    for (int f = INC_NUM_SOURCE; f <= INC_NUM_CHUNKS; ++f) {
+        if (header[f] < 0 || header[f] > 0x7FFFFFFF)
+            return 0;
+    }
+    for (int f = INC_HASHES; f < INC_NUM_FIELDS; ++f) {
+        if (header[f] < INC_HEADER_SIZE || (std::uint64_t) header[f] > inFile.file.size)
+            return 0;
+    }
+    
+    return inFile.ok;
+}
+
+
+
+/*
+incWriteAt: escreve bytes numa posicao de um arquivo aberto
+entrada: arquivo, posicao, bytes e quantidade
+saida: 1 se escreveu tudo, 0 se nao
+*/
+int incWriteAt (int fd, std::int64_t at, const void *bytes, std::size_t n) {
+    
+    std::size_t done = 0;
+    while (done < n) {
+        ssize_t written = pwrite(fd, (const char*) bytes + done, n - done, at + done);
+        if (written <= 0)
+            return 0;
+        done += written;
+    }
+    
+    return 1;
+}
+
+
+
+/*
+incWordAt: escreve um inteiro em little endian numa posicao de um arquivo aberto
+entrada: arquivo, posicao, valor e tamanho em bytes (1, 4 ou 8)
+saida: 1 se escreveu, 0 se nao
+*/
+int incWordAt (int fd, std::int64_t at, std::int64_t value, int size) {
+    
+    char bytes[8];
+    for (int b = 0; b < size; ++b)
+        bytes[b] = ((std::uint64_t) value >> (8*b)) & 0xFF;
+    
+    return incWriteAt(fd, at, bytes, size);
+}
+
+
+
+/*
+incSave: escreve o estado inteiro no arquivo (formato no comeco deste arquivo), com o que a juntada fez, para o incPatch corrigir depois so o que uma edicao muda
+entrada: estado, registro da juntada, lista de erros e onde comecam os da juntada, nome do arquivo de estado, nome do arquivo '.o' (ja escrito) e formato dele
+saida: nenhuma (se o '.o' nao foi escrito ou os tokens de alguma linha nao puderem ser refeitos do texto, o arquivo de estado eh apagado e a proxima montagem eh completa)
+*/
+void incSave (IncState &state, LinkTrace &trace, std::vector<Error> &errorList, std::size_t firstError, std::string fileName, std::string outFileName, int binary) {
+    
+    struct stat info;
+    int valid = stat(outFileName.c_str(), &info) == 0;
+    for (int l = 0; l < state.numLines() && valid; ++l)
+        valid = incSameTokens(state.tokenLine(l));
+    if (!valid) {
+        unlink(fileName.c_str());
+        return;
+    }
+    
+    OutputBuffer outFile;
+    if (!outFile.open(fileName))
+        return;
+    
+    // o cabecalho vai primeiro marcado como incompleto, e so eh escrito de verdade no final
+    std::int64_t header[INC_NUM_FIELDS] = {};
+    char headerBytes[INC_HEADER_SIZE];
+    header[INC_DIRTY] = 1;
+    incHeaderBytes (header, headerBytes);
+    outFile.putBytes(headerBytes, INC_HEADER_SIZE);
+    
+    int numSource = state.lineHashes.size(), numLines = state.numLines(), numChunks = state.chunks.size();
+    header[INC_FINGERPRINT] = state.fingerprint;
+    header[INC_BINARY] = binary;
+    header[INC_OBJ_SIZE] = info.st_size;
+    header[INC_OBJ_SEC] = info.st_mtim.tv_sec;
+    header[INC_OBJ_NSEC] = info.st_mtim.tv_nsec;
+    header[INC_NUM_SOURCE] = numSource;
+    header[INC_NUM_LINES] = numLines;
+    header[INC_NUM_NAMES] = state.symbols.size();
+    header[INC_NUM_INDEX] = state.symbols.size();
+    header[INC_NUM_LABELS] = trace.labelList.size();
+    header[INC_NUM_CHUNKS] = numChunks;
+    header[INC_SECTION_TEXT] = trace.sectionText;
+    
+    // linhas do '.asm'
+    header[INC_HASHES] = outFile.size();
+    for (int i = 0; i < numSource; ++i) {
+        putWord (outFile, state.lineHashes[i] & 0xFFFFFFFF);
+        putWord (outFile, state.lineHashes[i] >> 32);
+    }
+    header[INC_KINDS] = outFile.size();
+    outFile.putBytes(state.kinds.data(), numSource);
+    header[INC_CLEAN] = outFile.size();
+    outFile.putBytes(state.clean.data(), numSource);
+    header[INC_OUT_BEFORE] = outFile.size();
+    incPutWords (outFile, state.outBefore.data(), numSource+1);
+    header[INC_DICT_BEFORE] = outFile.size();
+    incPutWords (outFile, state.dictBefore.data(), numSource+1);
+    header[INC_ERR_BEFORE] = outFile.size();
+    incPutWords (outFile, state.errBefore.data(), numSource+1);
+    
+    // linhas da saida das macros: os textos, e a posicao e o tamanho de cada um
+    std::int64_t textPos = outFile.size();
+    outFile.putBytes(state.text.data(), state.text.size());
+    header[INC_LINE_TABLE] = outFile.size();
+    for (int l = 0; l < numLines; ++l) {
+        std::int64_t at = textPos + state.lineStart[l];
+        putWord (outFile, at);
+        putWord (outFile, at >> 32);
+        putWord (outFile, state.lineStart[l+1] - state.lineStart[l]);
+    }
+    
+    // blocos: registros e diretorio, com o endereco de cada um no codigo juntado e a posicao da primeira palavra dele no '.o'
+    std::vector<std::int64_t> records;
+    for (int k = 0; k < numChunks; ++k) {
+        records.push_back(outFile.size());
+        incPutChunk (outFile, state.chunks[k]);
+    }
+    header[INC_CHUNK_TABLE] = outFile.size();
+    std::int64_t objPos = 0;
+    int address = 0;
+    for (int k = 0; k < numChunks; ++k) {
+        // no texto, cada palavra ocupa os digitos dela e um espaco
+        for (; !binary && address < trace.base[k]; ++address) {
+            char digits[12];
+            objPos += std::to_chars(digits, digits + sizeof(digits), trace.machineCode[address]).ptr - digits + 1;
+        }
+        IncChunkEntry entry;
+        entry.record = records[k];
+        entry.begin = state.chunks[k].begin;
+        entry.end = state.chunks[k].end;
+        entry.section = state.chunks[k].section;
+        entry.base = trace.base[k];
+        entry.objPos = binary ? OBJ_HEADER_SIZE + (std::int64_t) trace.base[k] * OBJ_WORD_SIZE : objPos;
+        entry.merged = trace.merged[k];
+        int words[INC_CHUNK_WORDS];
+        entry.put(words);
+        incPutWords (outFile, words, INC_CHUNK_WORDS);
+    }
+    
+    // rotulos juntados e rotulo de cada identificador
+    header[INC_LABEL_TABLE] = outFile.size();
+    for (int g = 0; g < trace.labelList.size(); ++g) {
+        IncLabelEntry entry;
+        entry.label = trace.labelList[g];
+        entry.firstChunk = trace.firstChunk[g];
+        entry.defChunk = trace.defChunk[g];
+        entry.redefined = trace.redefined[g];
+        int words[INC_LABEL_WORDS];
+        entry.put(words);
+        incPutWords (outFile, words, INC_LABEL_WORDS);
+    }
+    header[INC_INDEX] = outFile.size();
+    for (int id = 0; id < state.symbols.size(); ++id)
+        putWord (outFile, trace.labelList.find((std::uint32_t) id));
+    
+    // nomes, EQUs, macros, dicionario de linhas e erros das passagens anteriores
+    header[INC_NAMES] = outFile.size();
+    incPutNames (outFile, state.symbols, 0, 0);
+    header[INC_EQUS] = outFile.size();
+    incPutIds (outFile, state.equIds);
+    incPutIds (outFile, state.equValues);
+    incPutInts (outFile, state.equLines);
+    incPutIds (outFile, state.macroIds);
+    header[INC_DICT] = outFile.size();
+    putWord (outFile, state.lineDict.ranges.size());
+    incPutWords (outFile, state.lineDict.ranges.data(), state.lineDict.ranges.size()*3);
+    header[INC_SRC_ERRORS] = outFile.size();
+    incPutErrors (outFile, state.srcErrors);
+    incPutInts (outFile, state.srcMarks);
+    
+    // erros da juntada (com o bloco, a linha e se vieram das passagens anteriores) e das pendencias (com o rotulo e o endereco da referencia)
+    int numLink = trace.errorChunk.size(), numResolve = trace.fixupAddress.size();
+    std::vector<int> tags;
+    for (int e = 0; e < numLink; ++e)
+        tags.insert(tags.end(), {trace.errorChunk[e], trace.errorLine[e], (int) trace.errorSource[e]});
+    header[INC_LINK_ERRORS] = outFile.size();
+    incPutTagged (outFile, tags, 3, errorList.begin() + firstError);
+    tags.clear();
+    for (int e = 0; e < numResolve; ++e)
+        tags.insert(tags.end(), {trace.fixupLabel[e], trace.fixupAddress[e]});
+    header[INC_RESOLVE_ERRORS] = outFile.size();
+    incPutTagged (outFile, tags, 2, errorList.end() - numResolve);
+    
+    outFile.flush();
+    header[INC_COMPACT] = outFile.size();
+    header[INC_DIRTY] = 0;
+    incHeaderBytes (header, headerBytes);
+    incWriteAt (outFile.fd, 0, headerBytes, INC_HEADER_SIZE);
+    outFile.close();
+
+}
+
+
+
+/*
+incLoad: le o estado inteiro guardado por uma montagem anterior (os tokens sao refeitos do texto das linhas)
+entrada: estado (vazio), nome do arquivo de estado e impressao digital das tabelas atuais
+saida: 1 se o estado foi lido e vale para as tabelas atuais, 0 se nao (arquivo inexistente, de outra versao, incompleto ou corrompido)
+*/
+int incLoad (IncState &state, std::string fileName, std::uint64_t fingerprint) {
+    
+    IncReader inFile;
+    std::int64_t header[INC_NUM_FIELDS];
+    if (!inFile.open(fileName) || !incHeader(inFile, header, fingerprint) || !incGetNames(inFile, header, state.symbols))
+        return 0;
+    state.fingerprint = fingerprint;
+    
+    // linhas do '.asm'
+    int numSource = header[INC_NUM_SOURCE], numLines = header[INC_NUM_LINES], numChunks = header[INC_NUM_CHUNKS];
+    inFile.seek(header[INC_HASHES]);
+    state.lineHashes.resize(inFile.fits(numSource, 8));
+    for (int i = 0; i < numSource && inFile.ok; ++i)
+        state.lineHashes[i] = inFile.longWord();
+    inFile.seek(header[INC_KINDS]);
+    std::string_view bytes = inFile.bytes(numSource);
+    state.kinds.assign(bytes.begin(), bytes.end());
+    inFile.seek(header[INC_CLEAN]);
+    bytes = inFile.bytes(numSource);
+    state.clean.assign(bytes.begin(), bytes.end());
+    inFile.seek(header[INC_OUT_BEFORE]);
+    inFile.ints(state.outBefore, numSource+1);
+    inFile.seek(header[INC_DICT_BEFORE]);
+    inFile.ints(state.dictBefore, numSource+1);
+    inFile.seek(header[INC_ERR_BEFORE]);
+    inFile.ints(state.errBefore, numSource+1);
+    inFile.seek(header[INC_EQUS]);
+    inFile.ids(state.equIds);
+    inFile.ids(state.equValues);
+    inFile.ints(state.equLines);
+    inFile.ids(state.macroIds);
+    
+    // linhas da saida das macros
+    std::vector<int> table;
+    inFile.seek(header[INC_LINE_TABLE]);
+    inFile.ints(table, (std::int64_t) numLines * INC_LINE_WORDS);
+    for (int l = 0; l < numLines && inFile.ok; ++l) {
+        inFile.seek((std::int64_t) ((std::uint64_t) (std::uint32_t) table[3*l+1] << 32 | (std::uint32_t) table[3*l]));
+        state.text.append(inFile.bytes(table[3*l+2]));
+        state.lineStart.push_back(state.text.size());
+    }
+    for (int l = 0; l < numLines && inFile.ok; ++l) {
+        incLineTokens (state.line(l), state.symbols, state.tokens);
+        state.firstToken.push_back(state.tokens.size());
+    }
+    inFile.seek(header[INC_DICT]);
+    state.lineDict.ranges.resize(inFile.count(12));
+    inFile.words(state.lineDict.ranges.data(), state.lineDict.ranges.size()*3);
+    state.lineDict.count = state.lineDict.ranges.empty() ? 0 : state.lineDict.ranges.back().first-1 + state.lineDict.ranges.back().count;
+    inFile.seek(header[INC_SRC_ERRORS]);
+    incGetErrors (inFile, state.srcErrors);
+    inFile.ints(state.srcMarks);
+    
+    // blocos
+    inFile.seek(header[INC_CHUNK_TABLE]);
+    inFile.ints(table, (std::int64_t) numChunks * INC_CHUNK_WORDS);
+    state.chunks.resize(table.size() / INC_CHUNK_WORDS);
+    for (int k = 0; k < (int) state.chunks.size() && inFile.ok; ++k) {
+        AsmChunk &chunk = state.chunks[k];
+        IncChunkEntry entry;
+        entry.get(table.data() + k*INC_CHUNK_WORDS);
+        chunk.labelList.symbols = &state.symbols;
+        chunk.begin = entry.begin;
+        chunk.end = entry.end;
+        chunk.section = entry.section;
+        inFile.seek(entry.record);
+        if (!incGetChunk(inFile, chunk))
+            return 0;
+    }
+    
+    return inFile.ok && incValid(state);
+}
+
+
+
+/*
+incValidChunk: confere se os tamanhos e indices de um bloco lido do estado fazem sentido
+entrada: bloco
+saida: 1 se o bloco eh consistente, 0 se nao
+*/
+int incValidChunk (AsmChunk &chunk) {
+    
+    FixupTable &fixups = chunk.labelList.fixups;
+    if (chunk.end < chunk.begin || (int) chunk.errorMarks.size() != chunk.end - chunk.begin
+        || chunk.textAddr < -1 || chunk.textAddr > (int) chunk.machineCode.size() || chunk.dataAddr < -1 || chunk.dataAddr > (int) chunk.machineCode.size()
+        || (int) fixups.address.size() != fixups.size() || (int) fixups.kind.size() != fixups.size() || (int) fixups.column.size() != fixups.size() || (int) fixups.line.size() != fixups.size())
+        return 0;
+    for (int i = 0; i < fixups.size(); ++i) {
+        if (fixups.label[i] < 0 || fixups.label[i] >= chunk.labelList.size() || fixups.address[i] < 0 || fixups.address[i] >= (int) chunk.machineCode.size()
+            || fixups.line[i] <= chunk.begin || fixups.line[i] > chunk.end)
+            return 0;
+    }
+    for (unsigned int i = 0; i < chunk.labelList.resolvedList.size(); ++i) {
+        if (chunk.labelList.resolvedList[i] < 0 || chunk.labelList.resolvedList[i] >= (int) chunk.machineCode.size())
+            return 0;
+    }
+    for (unsigned int i = 0; i < chunk.errorMarks.size(); ++i) {
+        if (chunk.errorMarks[i] < 0 || chunk.errorMarks[i] > (int) chunk.errorList.size() || (i > 0 && chunk.errorMarks[i] < chunk.errorMarks[i-1]))
+            return 0;
+    }
+    
+    return 1;
+}
+
+
+
+/*
+incValid: confere se os tamanhos e indices do estado lido fazem sentido (para nao usar um arquivo de estado corrompido)
+entrada: estado
+saida: 1 se o estado eh consistente, 0 se nao
+*/
+int incValid (IncState &state) {
+    
+    std::size_t numSource = state.lineHashes.size();
+    if (numSource == 0 || state.kinds.size() != numSource || state.clean.size() != numSource || state.outBefore.size() != numSource+1
+        || state.dictBefore.size() != numSource+1 || state.errBefore.size() != numSource+1)
+        return 0;
+    if (state.equValues.size() != state.equIds.size() || state.equLines.size() != state.equIds.size())
+        return 0;
+    
+    std::uint32_t numNames = state.symbols.size();
+    for (unsigned int e = 0; e < state.equIds.size(); ++e) {
+        if (state.equIds[e] >= numNames || state.equValues[e] >= numNames || (e > 0 && state.equLines[e] < state.equLines[e-1]))
+            return 0;
+    }
+    for (unsigned int i = 0; i < state.macroIds.size(); ++i) {
+        if (state.macroIds[i] >= numNames || (i > 0 && state.macroIds[i] <= state.macroIds[i-1]))
+            return 0;
+    }
+    
+    // linhas da saida das macros
+    int numLines = state.numLines();
+    if ((int) state.srcMarks.size() != numLines || state.outBefore[numSource] != numLines)
+        return 0;
+    for (int l = 0; l < numLines; ++l) {
+        if (state.srcMarks[l] < 0 || state.srcMarks[l] > (int) state.srcErrors.size())
+            return 0;
+    }
+    
+    // dicionario de linhas: intervalos seguidos, a partir da linha 1, com uma entrada para cada uma que as linhas do '.asm' colocaram
+    int numEntries = 0;
+    for (unsigned int r = 0; r < state.lineDict.ranges.size(); ++r) {
+        const LineRange &range = state.lineDict.ranges[r];
+        if (range.first != numEntries+1 || range.count <= 0 || range.count > state.dictBefore[numSource] - numEntries || range.source <= 0)
+            return 0;
+        numEntries += range.count;
+    }
+    if (numEntries != state.dictBefore[numSource])
+        return 0;
+    
+    // blocos: seguidos, cobrindo todas as linhas, com pendencias dentro do proprio codigo
+    int next = 0;
+    for (unsigned int k = 0; k < state.chunks.size(); ++k) {
+        if (state.chunks[k].begin != next || !incValidChunk(state.chunks[k]))
+            return 0;
+        next = state.chunks[k].end;
+    }
+    
+    return !state.chunks.empty() && next == numLines;
+}
+
+
+
+/*
+incChunkDict: dicionario de linhas so das linhas [begin, end) da saida das macros, numeradas a partir de 0 (para montar um bloco sem ler o dicionario inteiro)
+entrada: leitura do arquivo de estado, cabecalho e linhas
+saida: dicionario
+*/
+LineMap incChunkDict (IncReader &inFile, const std::int64_t *header, int begin, int end) {
+    
+    inFile.seek(header[INC_DICT]);
+    int numRanges = inFile.count(12);
+    std::size_t ranges = inFile.pos;
+    auto range = [&] (int r) {
+        LineRange result;
+        inFile.seek(ranges + 12*r);
+        inFile.words(&result, 3);
+        return result;
+    };
+    
+    // ultimo intervalo que comeca ate a primeira linha do bloco, e os seguintes ate a ultima
+    int low = 0, high = numRanges;
+    while (high - low > 1) {
+        int middle = (low + high) / 2;
+        if (range(middle).first <= begin+1)
+            low = middle;
+        else
+            high = middle;
+    }
+    LineMap result;
+    for (int r = low; r < numRanges && inFile.ok; ++r) {
+        LineRange piece = range(r);
+        if (piece.first > end)
+            break;
+        int from = std::max(piece.first, begin+1), to = std::min((long long) piece.first + piece.count, (long long) end+1);
+        if (from != begin+1 + result.size())
+            break;
+        result.append(piece.source + (from - piece.first), to - from);
+    }
+    
+    return result;
+}
+
+
+
+/*
+incRedoChunk: monta de novo um bloco com as linhas editadas e ve se, trocando so ele, a juntada continua igual (ver incPatch). se continua,
+calcula as palavras finais do bloco e os erros das pendencias dele que ficam para o final, como a juntada e o resolveCode fariam
+entrada: leitura do arquivo de estado, cabecalho, indice do bloco e entrada dele no diretorio, nomes, linhas editadas (da saida das macros) e textos novos delas,
+tabelas, bloco novo (vazio), palavras, e marcas (rotulo e endereco) e erros das pendencias
+saida: 1 se o bloco pode ser trocado no lugar (saidas preenchidas), 0 se nao
+*/
+int incRedoChunk (IncReader &inFile, const std::int64_t *header, int k, IncChunkEntry &entry, Interner &symbols, std::vector<int> &editedLines, std::vector<std::string> &editedTexts,
+                  Tables &tables, AsmChunk &chunk, std::vector<int> &code, std::vector<int> &resolveTags, std::vector<Error> &resolveErrors) {
+    
+    int begin = entry.begin, end = entry.end, n = end - begin;
+    if (!entry.merged)
+        return 0;
+    
+    // bloco guardado
+    AsmChunk old;
+    old.labelList.symbols = &symbols;
+    old.begin = begin;
+    old.end = end;
+    inFile.seek(entry.record);
+    if (!incGetChunk(inFile, old) || !incValidChunk(old))
+        return 0;
+    
+    // linhas do bloco, com os textos novos nas editadas, e os tokens refeitos do texto
+    std::vector<int> table;
+    inFile.seek(header[INC_LINE_TABLE] + (std::int64_t) begin * INC_LINE_WORDS*4);
+    inFile.ints(table, (std::int64_t) n * INC_LINE_WORDS);
+    std::vector<std::string_view> texts (n);
+    for (int t = 0; t < n && inFile.ok; ++t) {
+        inFile.seek((std::int64_t) ((std::uint64_t) (std::uint32_t) table[3*t+1] << 32 | (std::uint32_t) table[3*t]));
+        texts[t] = inFile.bytes(table[3*t+2]);
+    }
+    for (unsigned int e = 0; e < editedLines.size(); ++e) {
+        if (editedLines[e] >= begin && editedLines[e] < end)
+            texts[editedLines[e] - begin] = editedTexts[e];
+    }
+    std::vector<Token> tokens;
+    std::vector<int> firstToken (1, 0);
+    for (int t = 0; t < n; ++t) {
+        incLineTokens (texts[t], symbols, tokens);
+        firstToken.push_back(tokens.size());
+    }
+    std::pmr::vector<TokenLine> lines;
+    for (int t = 0; t < n; ++t)
+        lines.push_back(TokenLine (texts[t], tokens.data() + firstToken[t], firstToken[t+1] - firstToken[t]));
+    
+    // monta o bloco com as linhas (e o dicionario) numeradas a partir de 0, como se fosse o unico
+    LineMap lineMap = incChunkDict(inFile, header, begin, end);
+    LineDict lineDict (lineMap);
+    if (!inFile.ok || lineMap.size() != n)
+        return 0;
+    std::vector<AsmChunk> work (1);
+    work[0].labelList.symbols = &symbols;
+    work[0].end = n;
+    work[0].section = entry.section;
+    for (int phase = 0; phase < 2; ++phase) {
+        std::atomic<int> next (0);
+        chunkWorker (work, next, phase, lines, lineDict, tables);
+    }
+    AsmChunk &fresh = work[0];
+    if (fresh.textLine >= 0)
+        fresh.textLine += begin;
+    if (fresh.dataLine >= 0)
+        fresh.dataLine += begin;
+    
+    // mesmo tamanho e mesmas secoes (entao os enderecos dos blocos e o cabecalho do '.o' continuam os mesmos)
+    if (fresh.machineCode.size() != old.machineCode.size() || fresh.endSection != old.endSection || fresh.textLine != old.textLine || fresh.dataLine != old.dataLine
+        || fresh.sectionText != old.sectionText || fresh.textAddr != old.textAddr || fresh.dataAddr != old.dataAddr)
+        return 0;
+    
+    // rotulo da tabela juntada de cada identificador (-1: nenhum)
+    int numIndex = header[INC_NUM_INDEX], numLabels = header[INC_NUM_LABELS];
+    auto global = [&] (std::uint32_t id, IncLabelEntry &label) {
+        if (id >= (std::uint32_t) numIndex)
+            return -1;
+        inFile.seek(header[INC_INDEX] + 4*(std::int64_t) id);
+        int g = inFile.word();
+        if (g < 0 || g >= numLabels)
+            return -1;
+        int words[INC_LABEL_WORDS];
+        inFile.seek(header[INC_LABEL_TABLE] + (std::int64_t) g * INC_LABEL_WORDS*4);
+        inFile.fits(INC_LABEL_WORDS, 4);
+        inFile.words(words, INC_LABEL_WORDS);
+        label.get(words);
+        return (label.label.id == id) ? g : -1;
+    };
+    
+    // os mesmos rotulos definidos, com os mesmos valores, e os mesmos rotulos novos na tabela juntada (os que aparecem primeiro neste bloco), na mesma ordem
+    std::vector<int> globals (fresh.labelList.size());
+    std::vector<IncLabelEntry> labels (fresh.labelList.size());
+    auto shape = [&] (AsmChunk &c, int keep) {
+        std::vector<int> result;
+        for (int i = 0; i < c.labelList.size(); ++i) {
+            IncLabelEntry label;
+            int g = global(c.labelList[i].id, label);
+            int first = g < 0 || label.firstChunk >= k;
+            if (keep) {
+                globals[i] = g;
+                labels[i] = label;
+            }
+            Label &mine = c.labelList[i];
+            if (mine.isDefined || first)
+                result.insert(result.end(), {(int) mine.id, mine.isDefined, mine.isDefined ? mine.value : 0, mine.isConst, mine.vectSize, first});
+        }
+        return result;
+    };
+    if (shape(fresh, 1) != shape(old, 0) || !inFile.ok)
+        return 0;
+    
+    // e o bloco ainda pode ser juntado como estava: os rotulos definidos antes dele (com as caracteristicas de quando ele foi juntado, que so
+    // sao conhecidas se o rotulo nao foi redefinido) nao sao redefinidos e nao dao erro nas referencias dele
+    SymbolTable before (symbols);
+    for (int i = 0; i < fresh.labelList.size(); ++i) {
+        if (globals[i] < 0 || labels[i].defChunk < 0 || labels[i].defChunk >= k)
+            continue;
+        if (labels[i].redefined)
+            return 0;
+        before[before.insert(fresh.labelList[i].id)] = labels[i].label;
+    }
+    if (!mergeCheck(fresh, before, tables))
+        return 0;
+    
+    // palavras finais: enderecos do proprio bloco realocados, rotulos definidos antes dele somados na hora, e as outras pendencias
+    // resolvidas com as caracteristicas finais dos rotulos, na ordem da tabela juntada (como o resolveCode da juntada faria)
+    int base = entry.base;
+    code = fresh.machineCode;
+    for (unsigned int i = 0; i < fresh.labelList.resolvedList.size(); ++i)
+        code[fresh.labelList.resolvedList[i]] += base;
+    FixupTable &fixups = fresh.labelList.fixups;
+    std::vector<std::pair<int, int>> order; // rotulos juntados das pendencias que ficam para o final (e o rotulo do bloco)
+    for (int f = 0; f < fixups.size(); ++f) {
+        int i = fixups.label[f];
+        if (globals[i] < 0)
+            return 0;
+        if (labels[i].defChunk >= 0 && labels[i].defChunk < k)
+            code[fixups.address[f]] += labels[i].label.value;
+        else
+            order.push_back(std::make_pair(globals[i], i));
+    }
+    std::sort(order.begin(), order.end());
+    order.erase(std::unique(order.begin(), order.end()), order.end());
+    SymbolTable late (symbols);
+    for (unsigned int j = 0; j < order.size(); ++j)
+        late[late.insert(fresh.labelList[order[j].second].id)] = labels[order[j].second].label;
+    std::vector<int> lateLabel (code.size(), -1); // endereco -> rotulo juntado da pendencia
+    for (int f = 0; f < fixups.size(); ++f) {
+        int i = fixups.label[f];
+        if (labels[i].defChunk >= 0 && labels[i].defChunk < k)
+            continue;
+        late.fixups.push(late.find(fresh.labelList[i].id), fixups.address[f], fixups.kind[f], fixups.column[f], fixups.line[f]);
+        lateLabel[fixups.address[f]] = globals[i];
+    }
+    std::pmr::vector<std::string_view> noLines; // o texto das linhas entra depois
+    std::vector<int> errorLines, errorAddresses;
+    std::size_t firstError = resolveErrors.size();
+    resolveCode (late, code, lineDict, noLines, resolveErrors, &errorLines, &errorAddresses);
+    for (unsigned int e = 0; e < errorLines.size(); ++e) {
+        resolveErrors[firstError + e].line = texts[errorLines[e]-1];
+        resolveTags.insert(resolveTags.end(), {lateLabel[errorAddresses[e]], base + errorAddresses[e]});
+    }
+    
+    // bloco novo com os numeros de linha de verdade (os textos das linhas dos erros ja sao os do bloco)
+    fresh.begin = begin;
+    fresh.end = end;
+    for (int f = 0; f < fixups.size(); ++f)
+        fixups.line[f] += begin;
+    chunk = std::move(fresh);
+    
+    return 1;
+}
+
+
+
+/*
+incPatch: corrige no lugar o '.o' e o arquivo de estado de uma montagem anterior quando a edicao nao muda o tamanho do codigo:
+    - o '.asm' tem o mesmo numero de linhas e so linhas comuns mudaram (nem EQU, IF, macros ou rotulo sozinho)
+    - cada bloco tocado eh montado de novo sozinho (incRedoChunk) e tem que ter o mesmo tamanho, as mesmas secoes e os mesmos rotulos
+      definidos e novos, e ainda poder ser juntado como estava
+    - entao so as palavras desse bloco mudam no '.o', e so os erros dele mudam nas listas guardadas
+le so as partes do estado que a edicao toca (hash das linhas, diretorio dos blocos e os blocos tocados) e escreve so o que muda. o que muda de tamanho
+vai para o final do arquivo de estado, que volta a ser compacto na proxima gravacao completa
+entrada: arquivo '.asm' aberto, hash e comeco de cada linha dele, nome do arquivo de estado, impressao digital das tabelas, nome do '.o', tabelas, lista de erros
+e formato da saida (0: texto, 1: binario)
+saida: 1 se o '.o' e o estado foram corrigidos (erros na lista), 0 se a montagem tem que passar pelo estado inteiro (nada foi mudado, ou o estado ficou
+marcado como incompleto)
+*/
+int incPatch (SourceFile &asmFile, std::vector<std::uint64_t> &hashes, std::vector<std::size_t> &starts, std::string stateFileName, std::uint64_t fingerprint, std::string outFileName,
+              Tables &tables, std::vector<Error> &errorList, int binary) {
+    
+    IncReader inFile;
+    std::int64_t header[INC_NUM_FIELDS];
+    if (!inFile.open(stateFileName) || !incHeader(inFile, header, fingerprint))
+        return 0;
+    
+    // o '.o' tem que ser o que a montagem anterior escreveu (no mesmo formato), e o arquivo de estado nao pode ter crescido demais com as correcoes
+    struct stat info;
+    if (header[INC_BINARY] != binary || stat(outFileName.c_str(), &info) < 0 || info.st_size != header[INC_OBJ_SIZE] || info.st_mtim.tv_sec != header[INC_OBJ_SEC]
+        || info.st_mtim.tv_nsec != header[INC_OBJ_NSEC] || inFile.file.size > 2 * (std::uint64_t) header[INC_COMPACT])
+        return 0;
+    int numSource = header[INC_NUM_SOURCE], numLines = header[INC_NUM_LINES], numChunks = header[INC_NUM_CHUNKS];
+    if (numSource != (int) hashes.size())
+        return 0;
+    
+    // erros guardados: da juntada (bloco, linha e se veio das passagens anteriores) e das pendencias (rotulo e endereco)
+    std::vector<int> linkTags, resolveTags;
+    std::vector<Error> linkErrors, resolveErrors;
+    if (!incGetTagged(inFile, header[INC_LINK_ERRORS], 3, linkTags, linkErrors) || !incGetTagged(inFile, header[INC_RESOLVE_ERRORS], 2, resolveTags, resolveErrors))
+        return 0;
+    auto report = [&] () {
+        errorList.insert(errorList.end(), linkErrors.begin(), linkErrors.end());
+        if (header[INC_SECTION_TEXT] == -1)
+            errorList.push_back(Error ("seção texto é obrigatória", "semântico", -1, "", 0));
+        errorList.insert(errorList.end(), resolveErrors.begin(), resolveErrors.end());
+        return 1;
+    };
+    
+    // linhas trocadas do '.asm'
+    std::vector<int> changed;
+    inFile.seek(header[INC_HASHES]);
+    inFile.fits(numSource, 8);
+    for (int i = 0; i < numSource && inFile.ok; ++i) {
+        if ((std::uint64_t) inFile.longWord() != hashes[i])
+            changed.push_back(i);
+    }
+    if (!inFile.ok)
+        return 0;
+    if (changed.empty())
+        return report();
+    
+    // nomes, EQUs e macros (para ler as linhas trocadas como o preprocessamento leria)
+    IncState state;
+    if (!incGetNames(inFile, header, state.symbols))
+        return 0;
+    inFile.seek(header[INC_EQUS]);
+    inFile.ids(state.equIds);
+    inFile.ids(state.equValues);
+    inFile.ints(state.equLines);
+    inFile.ids(state.macroIds);
+    std::uint32_t numNames = state.symbols.size();
+    if (!inFile.ok || state.equValues.size() != state.equIds.size() || state.equLines.size() != state.equIds.size())
+        return 0;
+    for (unsigned int e = 0; e < state.equIds.size(); ++e) {
+        if (state.equIds[e] >= numNames || state.equValues[e] >= numNames || (e > 0 && state.equLines[e] < state.equLines[e-1]))
+            return 0;
+    }
+    for (unsigned int i = 1; i < state.macroIds.size(); ++i) {
+        if (state.macroIds[i] <= state.macroIds[i-1])
+            return 0;
+    }
+    
+    // linhas trocadas: cada uma tem que continuar vazia ou continuar uma linha comum, com uma edicao comecando num ponto limpo.
+    // as linhas comuns cujo texto normalizado mudou sao as linhas editadas da saida das macros
+    auto byteAt = [&] (std::int64_t at) {
+        inFile.seek(at);
+        std::string_view bytes = inFile.bytes(1);
+        return bytes.empty() ? -1 : (int) bytes[0];
+    };
+    EquTable equTable;
+    equTable.symbols = &state.symbols;
+    unsigned int nextEqu = 0;
+    std::vector<int> editedLines;
+    std::vector<std::string> editedTexts;
+    std::string line;
+    std::vector<Token> lineTokens;
+    for (unsigned int c = 0; c < changed.size(); ++c) {
+        int i = changed[c];
+        int kind = byteAt(header[INC_KINDS] + i);
+        if ((i > 0 && byteAt(header[INC_CLEAN] + i-1) != 1) || (kind != INC_BLANK && kind != INC_PLAIN))
+            return 0;
+        for (; nextEqu < state.equIds.size() && state.equLines[nextEqu] <= i; ++nextEqu)
+            equTable.define(state.equIds[nextEqu], state.equValues[nextEqu]);
+        asmFile.next = starts[i];
+        asmFile.eofFlag = 0;
+        preReadLine (line, lineTokens, asmFile, equTable);
+        if (kind == INC_BLANK) {
+            if (!line.empty())
+                return 0;
+            continue;
+        }
+        if (line.empty() || incSpecialLine(state, line, lineTokens) || !incSameTokens(TokenLine (line, lineTokens.data(), lineTokens.size())))
+            return 0;
+        inFile.seek(header[INC_OUT_BEFORE] + 4*(std::int64_t) i);
+        int l = inFile.word();
+        if (l < 0 || l >= numLines)
+            return 0;
+        inFile.seek(header[INC_LINE_TABLE] + (std::int64_t) l * INC_LINE_WORDS*4);
+        std::int64_t at = inFile.longWord();
+        int size = inFile.word();
+        inFile.seek(at);
+        if (inFile.bytes(size) == line)
+            continue;
+        editedLines.push_back(l);
+        editedTexts.push_back(line);
+    }
+    if (!inFile.ok)
+        return 0;
+    
+    // diretorio dos blocos (seguidos, cobrindo todas as linhas) e blocos tocados pelas linhas editadas
+    std::vector<int> table;
+    std::vector<IncChunkEntry> dir (numChunks);
+    inFile.seek(header[INC_CHUNK_TABLE]);
+    inFile.ints(table, (std::int64_t) numChunks * INC_CHUNK_WORDS);
+    for (int k = 0; k < numChunks && inFile.ok; ++k) {
+        dir[k].get(table.data() + k*INC_CHUNK_WORDS);
+        if (dir[k].begin != (k > 0 ? dir[k-1].end : 0) || dir[k].end < dir[k].begin || dir[k].base < (k > 0 ? dir[k-1].base : 0)
+            || dir[k].objPos < (k > 0 ? dir[k-1].objPos : 0) || dir[k].objPos > header[INC_OBJ_SIZE])
+            return 0;
+    }
+    if (!inFile.ok || numChunks == 0 || dir.back().end != numLines)
+        return 0;
+    std::vector<int> touched;
+    for (unsigned int e = 0; e < editedLines.size(); ++e) {
+        int k = std::upper_bound(dir.begin(), dir.end(), editedLines[e], [] (int l, const IncChunkEntry &entry) { return l < entry.begin; }) - dir.begin() - 1;
+        if (touched.empty() || touched.back() != k)
+            touched.push_back(k);
+    }
+    
+    // monta de novo cada bloco tocado
+    int numTouched = touched.size();
+    std::vector<AsmChunk> chunks (numTouched);
+    std::vector<std::vector<int>> codes (numTouched);
+    std::vector<int> newTags;
+    std::vector<Error> newErrors;
+    for (int t = 0; t < numTouched; ++t) {
+        int k = touched[t];
+        if (!incRedoChunk(inFile, header, k, dir[k], state.symbols, editedLines, editedTexts, tables, chunks[t], codes[t], newTags, newErrors))
+            return 0;
+    }
+    
+    // erros da juntada: os que vieram da montagem de cada bloco tocado sao trocados pelos novos, linha a linha, e os das passagens anteriores ficam
+    std::vector<int> mergedTags;
+    std::vector<Error> mergedErrors;
+    int numLink = linkErrors.size(), s = 0;
+    auto keep = [&] (int e) {
+        mergedTags.insert(mergedTags.end(), linkTags.begin() + 3*e, linkTags.begin() + 3*e + 3);
+        mergedErrors.push_back(std::move(linkErrors[e]));
+    };
+    for (int t = 0; t < numTouched; ++t) {
+        int k = touched[t];
+        for (; s < numLink && linkTags[3*s] < k; ++s)
+            keep(s);
+        AsmChunk &chunk = chunks[t];
+        int next = 0;
+        for (int l = chunk.begin; l < chunk.end; ++l) {
+            for (; s < numLink && linkTags[3*s] == k && linkTags[3*s+1] == l; ++s) {
+                if (linkTags[3*s+2])
+                    keep(s);
+            }
+            for (; next < chunk.errorMarks[l - chunk.begin]; ++next) {
+                mergedTags.insert(mergedTags.end(), {k, l, 0});
+                mergedErrors.push_back(chunk.errorList[next]);
+            }
+        }
+        if (s < numLink && linkTags[3*s] == k)
+            return 0;
+    }
+    for (; s < numLink; ++s)
+        keep(s);
+    
+    // erros das pendencias: saem os dos enderecos dos blocos tocados e entram os novos, na ordem de rotulo e endereco
+    std::vector<int> order (newErrors.size());
+    for (unsigned int e = 0; e < order.size(); ++e)
+        order[e] = e;
+    std::stable_sort(order.begin(), order.end(), [&] (int a, int b) {
+        return std::make_pair(newTags[2*a], newTags[2*a+1]) < std::make_pair(newTags[2*b], newTags[2*b+1]);
+    });
+    auto inTouched = [&] (int address) {
+        for (int t = 0; t < numTouched; ++t) {
+            if (address >= dir[touched[t]].base && address < dir[touched[t]].base + (int) codes[t].size())
+                return 1;
+        }
+        return 0;
+    };
+    std::vector<int> lateTags;
+    std::vector<Error> lateErrors;
+    unsigned int n = 0;
+    for (unsigned int e = 0; e <= resolveErrors.size(); ++e) {
+        int done = e == resolveErrors.size();
+        for (; n < order.size() && (done || std::make_pair(newTags[2*order[n]], newTags[2*order[n]+1]) < std::make_pair(resolveTags[2*e], resolveTags[2*e+1])); ++n) {
+            lateTags.insert(lateTags.end(), {newTags[2*order[n]], newTags[2*order[n]+1]});
+            lateErrors.push_back(newErrors[order[n]]);
+        }
+        if (done || inTouched(resolveTags[2*e+1]))
+            continue;
+        lateTags.insert(lateTags.end(), {resolveTags[2*e], resolveTags[2*e+1]});
+        lateErrors.push_back(std::move(resolveErrors[e]));
+    }
+    
+    // daqui em diante o estado fica marcado como incompleto ate tudo ser escrito
+    int objFd = ::open(outFileName.c_str(), O_RDWR), fd = ::open(stateFileName.c_str(), O_RDWR);
+    int ok = objFd >= 0 && fd >= 0 && incWordAt(fd, 8 + 8*INC_DIRTY, 1, 8);
+    
+    // palavras dos blocos tocados no '.o'. no texto, se o numero de caracteres mudou, o resto do arquivo anda
+    std::int64_t objSize = header[INC_OBJ_SIZE];
+    std::vector<char> moved (numChunks, 0); // blocos com a entrada do diretorio mudada
+    for (int t = 0; t < numTouched && ok; ++t) {
+        int k = touched[t];
+        std::vector<int> &code = codes[t];
+        std::string bytes;
+        if (binary) {
+            bytes.resize(code.size() * OBJ_WORD_SIZE);
+            for (unsigned int w = 0; w < code.size(); ++w) {
+                for (int b = 0; b < 4; ++b)
+                    bytes[4*w+b] = ((std::uint32_t) code[w] >> (8*b)) & 0xFF;
+            }
+            ok = incWriteAt(objFd, dir[k].objPos, bytes.data(), bytes.size());
+            continue;
+        }
+        char digits[12];
+        for (unsigned int w = 0; w < code.size(); ++w) {
+            bytes.append(digits, std::to_chars(digits, digits + sizeof(digits), code[w]).ptr - digits);
+            bytes.push_back(' ');
+        }
+        std::int64_t oldEnd = (k+1 < numChunks) ? dir[k+1].objPos : objSize, shift = dir[k].objPos + (std::int64_t) bytes.size() - oldEnd;
+        if (shift != 0) {
+            std::string tail (objSize - oldEnd, '\0');
+            for (std::size_t done = 0; done < tail.size() && ok; ) {
+                ssize_t got = pread(objFd, tail.data() + done, tail.size() - done, oldEnd + done);
+                ok = got > 0;
+                done += ok ? got : 0;
+            }
+            bytes += tail;
+            objSize += shift;
+            for (int j = k+1; j < numChunks; ++j) {
+                dir[j].objPos += shift;
+                moved[j] = 1;
+            }
+        }
+        ok = ok && incWriteAt(objFd, dir[k].objPos, bytes.data(), bytes.size()) && (shift >= 0 || ftruncate(objFd, objSize) == 0);
+    }
+    
+    // partes que mudam de tamanho, no final do arquivo de estado: textos das linhas editadas, blocos tocados, nomes novos e listas de erros
+    OutputBuffer heap;
+    off_t end = (fd >= 0) ? lseek(fd, 0, SEEK_END) : -1;
+    ok = ok && end >= 0;
+    heap.fd = ok ? fd : -1;
+    heap.written = ok ? end : 0;
+    std::vector<std::int64_t> textPos;
+    for (unsigned int e = 0; e < editedLines.size() && ok; ++e) {
+        textPos.push_back(heap.size());
+        heap.putBytes(editedTexts[e].data(), editedTexts[e].size());
+    }
+    for (int t = 0; t < numTouched && ok; ++t) {
+        dir[touched[t]].record = heap.size();
+        moved[touched[t]] = 1;
+        incPutChunk (heap, chunks[t]);
+    }
+    if (ok && state.symbols.size() > header[INC_NUM_NAMES]) {
+        std::int64_t names = heap.size();
+        incPutNames (heap, state.symbols, header[INC_NUM_NAMES], header[INC_NAMES]);
+        header[INC_NAMES] = names;
+        header[INC_NUM_NAMES] = state.symbols.size();
+    }
+    if (ok && numTouched > 0) {
+        header[INC_LINK_ERRORS] = heap.size();
+        incPutTagged (heap, mergedTags, 3, mergedErrors.begin());
+        header[INC_RESOLVE_ERRORS] = heap.size();
+        incPutTagged (heap, lateTags, 2, lateErrors.begin());
+    }
+    std::size_t expected = heap.size();
+    heap.flush();
+    ok = ok && heap.written == expected;
+    heap.fd = -1;
+    
+    // partes de tamanho fixo
+    for (unsigned int c = 0; c < changed.size() && ok; ++c)
+        ok = incWordAt(fd, header[INC_HASHES] + 8*(std::int64_t) changed[c], hashes[changed[c]], 8) && incWordAt(fd, header[INC_CLEAN] + changed[c], 1, 1);
+    for (unsigned int e = 0; e < editedLines.size() && ok; ++e) {
+        std::int64_t at = header[INC_LINE_TABLE] + (std::int64_t) editedLines[e] * INC_LINE_WORDS*4;
+        ok = incWordAt(fd, at, textPos[e], 8) && incWordAt(fd, at + 8, editedTexts[e].size(), 4);
+    }
+    for (int k = 0; k < numChunks && ok; ++k) {
+        if (!moved[k])
+            continue;
+        int words[INC_CHUNK_WORDS];
+        dir[k].put(words);
+        for (int w = 0; w < INC_CHUNK_WORDS && ok; ++w)
+            ok = incWordAt(fd, header[INC_CHUNK_TABLE] + (std::int64_t) k * INC_CHUNK_WORDS*4 + 4*w, words[w], 4);
+    }
+    
+    // cabecalho com o '.o' novo, e o estado completo de novo
+    struct stat objInfo;
+    ok = ok && fstat(objFd, &objInfo) == 0;
+    if (ok) {
+        header[INC_OBJ_SIZE] = objInfo.st_size;
+        header[INC_OBJ_SEC] = objInfo.st_mtim.tv_sec;
+        header[INC_OBJ_NSEC] = objInfo.st_mtim.tv_nsec;
+        header[INC_DIRTY] = 0;
+        char headerBytes[INC_HEADER_SIZE];
+        incHeaderBytes (header, headerBytes);
+        ok = incWriteAt(fd, 0, headerBytes, INC_HEADER_SIZE);
+    }
+    if (objFd >= 0)
+        ::close(objFd);
+    if (fd >= 0)
+        ::close(fd);
+    if (!ok)
+        return 0;
+    
+    linkErrors = std::move(mergedErrors);
+    resolveErrors = std::move(lateErrors);
+    return report();
+}
+
+
+
+/*
+assembleIncremental: faz a passagem de montagem reaproveitando o estado da montagem anterior do mesmo '.o' (guardado no arquivo de estado):
+    - o '.asm' eh comparado linha a linha (por hash) com o da montagem anterior
+    - se a edicao nao muda o tamanho do codigo, o '.o' e o estado sao corrigidos no lugar (incPatch): o tempo depende so do tamanho da edicao
+      (e da leitura e do hash do '.asm')
+    - se nao, e a edicao so troca linhas comuns, o estado inteiro eh lido, so os blocos tocados sao montados de novo, e os blocos sao juntados,
+      as pendencias resolvidas e o '.o' e o estado escritos inteiros (com enderecos absolutos, uma edicao que muda o tamanho do codigo muda tudo
+      o que vem depois dela no '.o')
+    - se nao (EQU, IF, macros, arquivo de estado ausente ou feito com outras tabelas), faz a montagem completa, em blocos
+a saida eh a mesma da montagem normal
+entrada: estado do preprocessamento (com o arquivo '.asm' aberto), nome do arquivo de saida '.o', tabelas, lista de erros, formato da saida (0: texto, 1: binario) e numero de threads
+saida: nenhuma (arquivo '.o' e arquivo de estado escritos)
+*/
+void assembleIncremental (PreState &pre, std::string outFileName, Tables &tables, std::vector<Error> &errorList, int binary, int numThreads) {
+    
+    std::string stateFileName = o2state(outFileName);
+    std::uint64_t fingerprint = incFingerprint(tables);
+    
+    // linhas do arquivo editado
+    std::vector<std::uint64_t> hashes;
+    std::vector<std::size_t> starts;
+    incSourceLines (pre.asmFile, hashes, starts);
+    
+    if (incPatch(pre.asmFile, hashes, starts, stateFileName, fingerprint, outFileName, tables, errorList, binary))
+        return;
+    
+    // tenta atualizar o estado da montagem anterior, e senao monta tudo
+    std::unique_ptr<IncState> state (new IncState);
+    if (!incLoad(*state, stateFileName, fingerprint) || !incUpdate(*state, pre.asmFile, hashes, starts, tables, numThreads)) {
+        state.reset(new IncState);
+        state->fingerprint = fingerprint;
+        state->lineHashes = hashes;
+        incBuild (*state, pre, tables, numThreads);
+    }
+    
+    // junta os blocos, escreve o codigo e guarda o que a juntada fez
+    RunArena arena;
+    std::pmr::vector<std::string_view> lines (arena.get());
+    std::pmr::vector<TokenLine> tokenLines (arena.get());
+    incTokenLines (*state, lines, tokenLines);
+    std::size_t firstError = errorList.size();
+    LinkTrace trace;
+    linkChunks (state->chunks, tokenLines, lines, state->lineDict, state->srcErrors, state->srcMarks, state->symbols, outFileName, tables, errorList, binary, &trace);
+    incSave (*state, trace, errorList, firstError, stateFileName, outFileName, binary);
+
+}
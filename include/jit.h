@@ -0,0 +1,544 @@
+/*      JIT.H: tradução do código de máquina para x86-64 nativo, com volta para o interpretador (sim.h) no que ela não cobre        */
+
+
+
+/*      DEFINIÇÕES DA TRADUÇÃO       */
+
+// o codigo traduzido usa registradores que as chamadas de funcao preservam (System V):
+//     ebx: acumulador
+//     r12: JitContext da execucao
+//     r13: memoria do programa (endereco a vira [r13 + 4*a])
+//     r14: mapa das palavras ja traduzidas (uma escrita numa delas eh codigo que se modifica)
+//     r15: contadores de execucao dos blocos (o bloco que comeca no endereco a conta em [r15 + 8*a])
+// cada bloco basico (ate um desvio condicional, JMP, STOP ou um endereco que ja comeca outro bloco) soma 1 no seu contador ao comecar,
+// e as instrucoes executadas de cada tipo saem dos contadores no final
+const int JIT_BRANCH = 0; // saiu para um desvio ainda nao traduzido
+const int JIT_STOP = 1; // executou o STOP
+const int JIT_FALLBACK = 2; // instrucao que o interpretador tem que executar (erro, escrita em codigo traduzido)
+const int JIT_BAD_INPUT = 3; // INPUT sem um numero na entrada (ja consumiu o que leu, entao o interpretador nao pode repetir)
+
+const int JIT_MAX_INSTRS = 256; // instrucoes traduzidas de uma vez (depois o bloco continua numa proxima traducao)
+const std::size_t JIT_INSTR_BYTES = 96; // maior codigo de uma instrucao, com a saida dela
+const std::size_t JIT_MAX_CODE = 256 << 20; // maior buffer de codigo
+const int JIT_MAX_MEMORY = 1 << 28; // maior memoria de programa (os deslocamentos de 8*endereco cabem em 32 bits)
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// JitContext: o que o codigo traduzido le e escreve fora dos registradores (os deslocamentos dos campos vao direto nas instrucoes)
+struct JitContext {
+    // membros
+    int *memory; // memoria do programa
+    unsigned char *covered; // endereco -> se ja foi traduzido como parte de uma instrucao
+    std::uint64_t *blockCounts; // endereco -> quantas vezes o bloco que comeca nele foi executado
+    int acc; // acumulador na entrada e na saida do codigo traduzido
+    int reason; // JIT_* da ultima saida
+    int exitBlock; // bloco de onde o codigo saiu (nas saidas JIT_STOP e JIT_FALLBACK)
+    SimInput *in; // entrada dos INPUT
+    OutputBuffer *out; // saida dos OUTPUT
+    int (*input) (JitContext*, int); // le um inteiro para o endereco. retorna 0 se a entrada acabou ou nao tem um numero
+    void (*output) (JitContext*, int); // escreve um inteiro
+    // metodos
+    JitContext (): memory(nullptr), covered(nullptr), blockCounts(nullptr), acc(0), reason(JIT_BRANCH), exitBlock(0), in(nullptr), out(nullptr), input(nullptr), output(nullptr) {};
+};
+
+
+
+// JitBlock: bloco basico traduzido. as instrucoes dele ficam em [first, first+count) de Jit::instrAddress/instrKind
+struct JitBlock {
+    // membros
+    int start; // endereco da primeira instrucao
+    int first, count;
+    // metodos
+    JitBlock (int st, int fi): start(st), first(fi), count(0) {};
+};
+
+
+
+// JitFix: desvio para fora do codigo de uma traducao, ligado no final dela a uma saida
+struct JitFix {
+    // membros
+    std::size_t at; // onde esta o deslocamento de 32 bits do desvio
+    int reason; // JIT_BRANCH (desvio para 'address'), ou a saida (JIT_FALLBACK ou JIT_BAD_INPUT) da instrucao em 'address'
+    int address;
+    int block; // bloco da instrucao que sai
+    // metodos
+    JitFix (std::size_t a, int r, int ad, int bl): at(a), reason(r), address(ad), block(bl) {};
+};
+
+
+
+// Jit: buffer de codigo executavel e o que ja foi traduzido
+struct Jit {
+    // membros
+    unsigned char *code; // buffer mapeado com permissao de execucao (nullptr se nao deu para criar)
+    std::size_t capacity, used;
+    std::size_t enter, exitBranch, exitCommon; // rotinas fixas no comeco do buffer
+    std::vector<unsigned char*> blockCode; // endereco -> codigo do bloco que comeca nele (nullptr se nao foi traduzido)
+    std::vector<JitBlock> blocks;
+    std::vector<int> blockIndex; // endereco -> bloco que comeca nele (-1 se nenhum)
+    std::vector<int> instrAddress, instrKind; // instrucoes dos blocos, na ordem
+    std::vector<unsigned char> covered;
+    std::vector<std::uint64_t> blockCounts;
+    std::unordered_map<int, std::vector<std::size_t>> pending; // endereco -> saidas de desvio para ele, a serem ligadas quando ele for traduzido
+    int fallback; // endereco onde a execucao voltou para o interpretador (-1 se nao voltou)
+    // metodos
+    Jit (): code(nullptr), capacity(0), used(0), enter(0), exitBranch(0), exitCommon(0), fallback(-1) {};
+    Jit (const Jit&) = delete;
+    Jit& operator= (const Jit&) = delete;
+    ~Jit () {
+        if (code)
+            munmap(code, capacity);
+    };
+    // anexa bytes ao codigo
+    void put (std::initializer_list<int> bytes) {
+        for (int byte : bytes)
+            code[used++] = byte;
+    };
+    void put32 (int value) {
+        std::int32_t word = value;
+        memcpy(code + used, &word, 4);
+        used += 4;
+    };
+    // anexa um deslocamento de 32 bits ainda sem valor e retorna onde ele ficou
+    std::size_t hole () {
+        put32(0);
+        return used - 4;
+    };
+    // preenche o deslocamento de um desvio para que ele va para 'target' (posicao no buffer)
+    void link (std::size_t at, std::size_t target) {
+        std::int32_t rel = (std::int32_t) ((long long) target - (long long) (at + 4));
+        memcpy(code + at, &rel, 4);
+    };
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+int jitInput (JitContext*, int);
+void jitOutput (JitContext*, int);
+int jitInit (Jit&, SimMachine&);
+int jitOpenBlock (Jit&, int);
+void jitGuard (Jit&, std::vector<JitFix>&, int, int, int);
+void jitBranch (Jit&, std::vector<JitFix>&, std::initializer_list<int>, int);
+void jitExit (Jit&, int, int, int);
+unsigned char* jitTranslate (Jit&, SimMachine&, int);
+int jitRun (SimMachine&, SimInput&, OutputBuffer&, Jit&);
+void runSimulator (Options&, Tables&);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+jitInput: INPUT chamado pelo codigo traduzido (antes de esperar pela entrada, mostra o que ja foi escrito)
+entrada: contexto e endereco
+saida: 1 se leu, 0 se a entrada acabou ou nao tem um numero
+*/
+int jitInput (JitContext *context, int address) {
+    
+    if (!context->in->ready())
+        context->out->flush();
+    return context->in->getInt(context->memory[address]);
+}
+
+
+
+/*
+jitOutput: OUTPUT chamado pelo codigo traduzido
+entrada: contexto e valor
+saida: nenhuma
+*/
+void jitOutput (JitContext *context, int value) {
+    
+    context->out->putInt(value);
+    context->out->putChar('\n');
+
+}
+
+
+
+/*
+jitInit: cria o buffer de codigo e escreve nele as rotinas fixas:
+    enter (chamada como int enter(JitContext*, codigo)): guarda os registradores, carrega os da traducao e pula para o codigo
+    exitBranch: marca a saida como JIT_BRANCH e continua em exitCommon
+    exitCommon: guarda o acumulador no contexto, restaura os registradores e retorna o endereco em eax
+entrada: jit e maquina carregada
+saida: 1 se o buffer foi criado, 0 se nao (memoria grande demais ou o sistema nao deixa criar codigo executavel)
+*/
+int jitInit (Jit &jit, SimMachine &machine) {
+    
+    int size = machine.memory.size();
+    if (size >= JIT_MAX_MEMORY)
+        return 0;
+    jit.capacity = std::min(JIT_MAX_CODE, (std::size_t) size * JIT_INSTR_BYTES + ((std::size_t) JIT_MAX_INSTRS * JIT_INSTR_BYTES * 4));
+    void *map = mmap(nullptr, jit.capacity, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        jit.capacity = 0;
+        return 0;
+    }
+    jit.code = (unsigned char*) map;
+    jit.blockCode.assign(size+1, nullptr);
+    jit.blockIndex.assign(size+1, -1);
+    jit.covered.assign(size+1, 0);
+    jit.blockCounts.assign(size+1, 0);
+    
+    const int contextMemory = offsetof(JitContext, memory), contextCovered = offsetof(JitContext, covered), contextCounts = offsetof(JitContext, blockCounts),
+        contextAcc = offsetof(JitContext, acc), contextReason = offsetof(JitContext, reason);
+    
+    // enter
+    jit.enter = jit.used;
+    jit.put({0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57}); // push rbx, r12, r13, r14, r15
+    jit.put({0x49, 0x89, 0xFC}); // mov r12, rdi
+    jit.put({0x4D, 0x8B, 0x6C, 0x24, contextMemory}); // mov r13, [r12 + memory]
+    jit.put({0x4D, 0x8B, 0x74, 0x24, contextCovered}); // mov r14, [r12 + covered]
+    jit.put({0x4D, 0x8B, 0x7C, 0x24, contextCounts}); // mov r15, [r12 + blockCounts]
+    jit.put({0x41, 0x8B, 0x5C, 0x24, contextAcc}); // mov ebx, [r12 + acc]
+    jit.put({0xFF, 0xE6}); // jmp rsi
+    
+    // exitBranch
+    jit.exitBranch = jit.used;
+    jit.put({0x41, 0xC7, 0x44, 0x24, contextReason}); // mov dword [r12 + reason], JIT_BRANCH
+    jit.put32(JIT_BRANCH);
+    
+    // exitCommon
+    jit.exitCommon = jit.used;
+    jit.put({0x41, 0x89, 0x5C, 0x24, contextAcc}); // mov [r12 + acc], ebx
+    jit.put({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3}); // pop r15, r14, r13, r12, rbx; ret
+    
+    return 1;
+}
+
+
+
+/*
+jitOpenBlock: comeca um bloco basico na posicao atual do buffer (e liga as saidas de desvio que esperavam por ele)
+entrada: jit e endereco da primeira instrucao do bloco
+saida: indice do bloco
+*/
+int jitOpenBlock (Jit &jit, int address) {
+    
+    jit.blockCode[address] = jit.code + jit.used;
+    jit.blockIndex[address] = jit.blocks.size();
+    jit.blocks.push_back(JitBlock(address, jit.instrAddress.size()));
+    
+    // as saidas 'mov eax, endereco; jmp exitBranch' viram 'jmp bloco'
+    std::unordered_map<int, std::vector<std::size_t>>::iterator waiting = jit.pending.find(address);
+    if (waiting != jit.pending.end()) {
+        for (std::size_t stub : waiting->second) {
+            jit.code[stub] = 0xE9;
+            jit.link(stub+1, jit.used);
+        }
+        jit.pending.erase(waiting);
+    }
+    
+    jit.put({0x49, 0xFF, 0x87}); // inc qword [r15 + 8*endereco]
+    jit.put32(8*address);
+    
+    return jit.blocks.size()-1;
+}
+
+
+
+/*
+jitGuard: protege uma escrita no endereco: se ele ja foi traduzido como codigo, sai para o interpretador antes de escrever
+entrada: jit, desvios da traducao atual, endereco escrito, endereco da instrucao e bloco dela
+saida: nenhuma
+*/
+void jitGuard (Jit &jit, std::vector<JitFix> &fixes, int written, int address, int block) {
+    
+    jit.put({0x41, 0x80, 0xBE}); // cmp byte [r14 + endereco], 0
+    jit.put32(written);
+    jit.put({0x00});
+    jit.put({0x0F, 0x85}); // jne saida
+    fixes.push_back(JitFix(jit.hole(), JIT_FALLBACK, address, block));
+
+}
+
+
+
+/*
+jitBranch: emite um desvio (jmp ou jcc com deslocamento de 32 bits) para o codigo do endereco, direto se ele ja foi traduzido
+entrada: jit, desvios da traducao atual, opcode do desvio e endereco de destino
+saida: nenhuma
+*/
+void jitBranch (Jit &jit, std::vector<JitFix> &fixes, std::initializer_list<int> opcode, int target) {
+    
+    jit.put(opcode);
+    std::size_t at = jit.hole();
+    if (jit.blockCode[target])
+        jit.link(at, jit.blockCode[target] - jit.code);
+    else
+        fixes.push_back(JitFix(at, JIT_BRANCH, target, -1));
+
+}
+
+
+
+/*
+jitExit: emite uma saida do codigo traduzido
+entrada: jit, motivo (JIT_STOP, JIT_FALLBACK ou JIT_BAD_INPUT), endereco da instrucao e bloco dela
+saida: nenhuma
+*/
+void jitExit (Jit &jit, int reason, int address, int block) {
+    
+    jit.put({0x41, 0xC7, 0x44, 0x24, (int) offsetof(JitContext, reason)}); // mov dword [r12 + reason], motivo
+    jit.put32(reason);
+    jit.put({0x41, 0xC7, 0x44, 0x24, (int) offsetof(JitContext, exitBlock)}); // mov dword [r12 + exitBlock], bloco
+    jit.put32(block);
+    jit.put({0xB8}); // mov eax, endereco
+    jit.put32(address);
+    jit.put({0xE9}); // jmp exitCommon
+    jit.link(jit.hole(), jit.exitCommon);
+
+}
+
+
+
+/*
+jitTranslate: traduz as instrucoes a partir do endereco, em sequencia, ate um JMP, um STOP, uma instrucao que nao pode ser executada,
+um endereco que ja comeca um bloco traduzido ou o limite de instrucoes. cada desvio condicional fecha um bloco basico e o seguinte comeca logo depois
+entrada: jit, maquina e endereco (dentro da memoria, ainda nao traduzido)
+saida: codigo do endereco, ou nullptr se o buffer acabou
+*/
+unsigned char* jitTranslate (Jit &jit, SimMachine &machine, int start) {
+    
+    if (jit.capacity - jit.used < (std::size_t) JIT_MAX_INSTRS * JIT_INSTR_BYTES * 2)
+        return nullptr;
+    
+    const int contextInput = offsetof(JitContext, input), contextOutput = offsetof(JitContext, output);
+    int size = machine.memory.size(), address = start, block = jitOpenBlock(jit, start);
+    std::vector<JitFix> fixes;
+    
+    for (int numInstrs = 1; ; ++numInstrs) {
+        
+        SimOp op = machine.decoded(address);
+        if (op.kind == SIM_FAULT) {
+            jitExit (jit, JIT_FALLBACK, address, block);
+            break;
+        }
+        
+        // a instrucao entra no bloco e as palavras dela passam a ser codigo traduzido
+        jit.instrAddress.push_back(address);
+        jit.instrKind.push_back(op.kind);
+        jit.blocks[block].count++;
+        for (int word = address; word < op.next; ++word)
+            jit.covered[word] = 1;
+        
+        switch (op.kind) {
+            case SIM_ADD:
+                jit.put({0x41, 0x03, 0x9D}); // add ebx, [r13 + 4*a]
+                jit.put32(4*op.a);
+                break;
+            case SIM_SUB:
+                jit.put({0x41, 0x2B, 0x9D}); // sub ebx, [r13 + 4*a]
+                jit.put32(4*op.a);
+                break;
+            case SIM_MULT:
+                jit.put({0x41, 0x0F, 0xAF, 0x9D}); // imul ebx, [r13 + 4*a]
+                jit.put32(4*op.a);
+                break;
+            case SIM_DIV:
+                // divisao por zero vai para o interpretador, que mostra o erro. por -1 so troca o sinal (idiv estoura com o menor inteiro)
+                jit.put({0x41, 0x8B, 0x8D}); // mov ecx, [r13 + 4*a]
+                jit.put32(4*op.a);
+                jit.put({0x85, 0xC9, 0x0F, 0x84}); // test ecx, ecx; jz saida
+                fixes.push_back(JitFix(jit.hole(), JIT_FALLBACK, address, block));
+                jit.put({0x83, 0xF9, 0xFF, 0x75, 0x04}); // cmp ecx, -1; jne divide
+                jit.put({0xF7, 0xDB, 0xEB, 0x07}); // neg ebx; jmp fim
+                jit.put({0x89, 0xD8, 0x99, 0xF7, 0xF9, 0x89, 0xC3}); // divide: mov eax, ebx; cdq; idiv ecx; mov ebx, eax
+                break;
+            case SIM_LOAD:
+                jit.put({0x41, 0x8B, 0x9D}); // mov ebx, [r13 + 4*a]
+                jit.put32(4*op.a);
+                break;
+            case SIM_STORE:
+                jitGuard (jit, fixes, op.a, address, block);
+                jit.put({0x41, 0x89, 0x9D}); // mov [r13 + 4*a], ebx
+                jit.put32(4*op.a);
+                break;
+            case SIM_COPY:
+                jitGuard (jit, fixes, op.b, address, block);
+                jit.put({0x41, 0x8B, 0x85}); // mov eax, [r13 + 4*a]
+                jit.put32(4*op.a);
+                jit.put({0x41, 0x89, 0x85}); // mov [r13 + 4*b], eax
+                jit.put32(4*op.b);
+                break;
+            case SIM_INPUT:
+                jitGuard (jit, fixes, op.a, address, block);
+                jit.put({0x4C, 0x89, 0xE7, 0xBE}); // mov rdi, r12; mov esi, a
+                jit.put32(op.a);
+                jit.put({0x41, 0xFF, 0x54, 0x24, contextInput}); // call [r12 + input]
+                jit.put({0x85, 0xC0, 0x0F, 0x84}); // test eax, eax; jz saida
+                fixes.push_back(JitFix(jit.hole(), JIT_BAD_INPUT, address, block));
+                break;
+            case SIM_OUTPUT:
+                jit.put({0x4C, 0x89, 0xE7, 0x41, 0x8B, 0xB5}); // mov rdi, r12; mov esi, [r13 + 4*a]
+                jit.put32(4*op.a);
+                jit.put({0x41, 0xFF, 0x54, 0x24, contextOutput}); // call [r12 + output]
+                break;
+            case SIM_JMP:
+                jitBranch (jit, fixes, {0xE9}, op.a); // jmp destino
+                break;
+            case SIM_JMPN:
+                jit.put({0x85, 0xDB}); // test ebx, ebx
+                jitBranch (jit, fixes, {0x0F, 0x88}, op.a); // js destino
+                break;
+            case SIM_JMPP:
+                jit.put({0x85, 0xDB});
+                jitBranch (jit, fixes, {0x0F, 0x8F}, op.a); // jg destino
+                break;
+            case SIM_JMPZ:
+                jit.put({0x85, 0xDB});
+                jitBranch (jit, fixes, {0x0F, 0x84}, op.a); // jz destino
+                break;
+            case SIM_STOP:
+                jitExit (jit, JIT_STOP, address, block);
+                break;
+        }
+        if (op.kind == SIM_JMP || op.kind == SIM_STOP)
+            break;
+        
+        // a proxima instrucao: final da memoria (o interpretador mostra o erro), bloco ja traduzido, limite ou mais uma instrucao
+        address = op.next;
+        if (address >= size) {
+            jitExit (jit, JIT_FALLBACK, address, block);
+            break;
+        }
+        if (jit.blockCode[address] || numInstrs >= JIT_MAX_INSTRS) {
+            jitBranch (jit, fixes, {0xE9}, address);
+            break;
+        }
+        if (op.kind == SIM_JMPN || op.kind == SIM_JMPP || op.kind == SIM_JMPZ)
+            block = jitOpenBlock(jit, address);
+    }
+    
+    // saidas dos desvios, depois do codigo da traducao
+    for (unsigned int i = 0; i < fixes.size(); ++i) {
+        JitFix &fix = fixes[i];
+        if (fix.reason == JIT_BRANCH && jit.blockCode[fix.address]) {
+            jit.link(fix.at, jit.blockCode[fix.address] - jit.code);
+            continue;
+        }
+        jit.link(fix.at, jit.used);
+        if (fix.reason == JIT_BRANCH) {
+            jit.pending[fix.address].push_back(jit.used);
+            jit.put({0xB8}); // mov eax, destino
+            jit.put32(fix.address);
+            jit.put({0xE9}); // jmp exitBranch
+            jit.link(jit.hole(), jit.exitBranch);
+        } else
+            jitExit (jit, fix.reason, fix.address, fix.block);
+    }
+    
+    return jit.blockCode[start];
+}
+
+
+
+/*
+jitRun: executa o programa traduzindo os blocos na primeira vez que sao alcancados. no STOP termina; numa instrucao que a traducao
+nao cobre (erros, final da entrada, escrita em codigo ja traduzido, buffer cheio) o resto da execucao fica com o interpretador
+entrada: maquina carregada, entrada, saida e jit
+saida: SIM_OK se parou no STOP, senao o erro de execucao (como em simRun)
+*/
+int jitRun (SimMachine &machine, SimInput &in, OutputBuffer &out, Jit &jit) {
+
+#if defined(__x86_64__)
+    if (!jitInit(jit, machine))
+        return simRun(machine, in, out);
+    
+    JitContext context;
+    context.memory = machine.memory.data();
+    context.covered = jit.covered.data();
+    context.blockCounts = jit.blockCounts.data();
+    context.acc = machine.acc;
+    context.in = &in;
+    context.out = &out;
+    context.input = jitInput;
+    context.output = jitOutput;
+    typedef int (*JitEnter) (JitContext*, unsigned char*);
+    JitEnter enter = (JitEnter) (jit.code + jit.enter);
+    
+    int size = machine.memory.size(), pc = machine.pc, error = -1;
+    std::uint64_t notExecuted[SIM_NUM_KINDS] = {0};
+    while (pc >= 0 && pc < size) {
+        unsigned char *code = jit.blockCode[pc];
+        if (!code && !(code = jitTranslate(jit, machine, pc)))
+            break;
+        pc = enter(&context, code);
+        if (context.reason == JIT_BRANCH)
+            continue;
+        
+        // o bloco contou todas as instrucoes dele, mas as depois da saida nao foram executadas (nem a da saida, se o interpretador vai executar)
+        JitBlock &block = jit.blocks[context.exitBlock];
+        int i = block.first;
+        while (i < block.first + block.count && jit.instrAddress[i] != pc)
+            i++;
+        for (int last = (context.reason == JIT_FALLBACK) ? i : i+1; last < block.first + block.count; ++last)
+            notExecuted[jit.instrKind[last]]++;
+        if (context.reason == JIT_STOP)
+            error = SIM_OK;
+        else if (context.reason == JIT_BAD_INPUT)
+            error = SIM_BAD_INPUT;
+        break;
+    }
+    
+    for (unsigned int b = 0; b < jit.blocks.size(); ++b) {
+        JitBlock &block = jit.blocks[b];
+        for (int i = block.first; i < block.first + block.count; ++i)
+            machine.counts[jit.instrKind[i]] += jit.blockCounts[block.start];
+    }
+    for (int kind = 0; kind < SIM_NUM_KINDS; ++kind)
+        machine.counts[kind] -= notExecuted[kind];
+    machine.pc = pc;
+    machine.acc = context.acc;
+    if (error >= 0) {
+        machine.error = error;
+        return error;
+    }
+    jit.fallback = pc;
+#endif
+    
+    return simRun(machine, in, out);
+}
+
+
+
+/*
+runSimulator: carrega e executa um arquivo objeto (traduzido para codigo nativo com --jit, senao interpretado). os OUTPUT vao para a
+saida padrao e o relatorio das instrucoes executadas (e um erro de execucao, se houver) para a saida de erro
+entrada: opcoes (com o nome do '.o') e tabelas
+saida: nenhuma
+*/
+void runSimulator (Options &options, Tables &tables) {
+    
+    SimMachine machine;
+    if (!simLoad(machine, options.runFileName, tables)) {
+        std::cout << "Erro ao abrir o arquivo objeto: " << options.runFileName << "\n";
+        return;
+    }
+    
+    SimInput in (0);
+    OutputBuffer out;
+    out.fd = 1;
+    
+    Jit jit;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int error = options.jit ? jitRun(machine, in, out, jit) : simRun(machine, in, out);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    out.flush();
+    out.fd = -1;
+    
+    if (error != SIM_OK)
+        std::cerr << "Erro de execução no endereço " << machine.pc << ": " << SIM_ERRORS[error] << "\n";
+    simReport (machine, seconds, std::cerr);
+    if (options.jit) {
+        std::cerr << "jit: " << jit.blocks.size() << " blocos traduzidos (" << jit.used << " bytes)";
+        if (jit.fallback >= 0)
+            std::cerr << ", interpretado a partir do endereço " << jit.fallback;
+        std::cerr << "\n";
+    }
+
+}
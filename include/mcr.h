@@ -2,25 +2,78 @@
 
 
 
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// McrState: estado da passagem de macros, que le as linhas do preprocessamento e entrega as linhas expandidas uma a uma
+struct McrState {
+    // membros
+    std::vector<Macro> macroList; // lista de macros
+    std::deque<std::string> bodies; // texto das definicoes das macros (o deque nao move as strings, entao as views das macros continuam validas)
+    std::vector<int> macroIndex; // identificador do nome -> primeira macro com esse nome na lista (-1 se nenhuma)
+    LineMap lineMap; // dicionario de linhas em intervalos (linha de saida -> linha da saida do preprocessamento; composto com o do preprocessamento so nos erros)
+    std::string block; // ultima saida do parser, reaproveitada entre as linhas
+    int numPending, nextPending; // quantas linhas a saida do parser tem ('block' ou as linhas da macro expandida, sem copiar) e qual a proxima a ser entregue
+    int lineCounter; // linha atual da saida do preprocessamento
+    int macroCall; // indice da macro chamada na ultima linha (-1 se nenhuma)
+    int expansion; // indice da macro expandida na linha atual (-1 se a linha nao chamou macro)
+    int eof; // se a saida do preprocessamento ja acabou (mesmo significado de eof() num arquivo)
+    std::ofstream *mcrFile; // arquivo '.mcr' onde as linhas sao copiadas (nullptr se nao for pedido)
+    LineTrace *trace; // registro do que aconteceu com cada linha do '.asm' (nullptr se nao for pedido)
+    RunStats *stats; // tempo e contadores da execucao (nullptr se nao forem pedidos)
+    // metodos
+    McrState (): numPending(0), nextPending(0), lineCounter(1), macroCall(-1), expansion(-1), eof(0), mcrFile(nullptr), trace(nullptr), stats(nullptr) {};
+    // procura uma macro pelo nome. retorna a posicao da primeira macro com esse nome ou -1
+    int findMacro (const Interner &symbols, std::string_view name) const { return findMacro(symbols.find(name)); };
+    int findMacro (std::uint32_t id) const {
+        return (id == NO_SYMBOL || id >= macroIndex.size()) ? -1 : macroIndex[id];
+    };
+};
+
+
+
 /*      DECLARAÇÕES DAS FUNÇÕES      */
-int createMacro (std::string&, std::ifstream&, std::string&, std::vector<Macro>&, int&);
-void mcrSearchAndReplace (std::string&, std::string&, std::vector<Macro>&, int&);
-void mcrParser (std::string&, std::ifstream&, std::vector<Macro>&, int&, int&, std::vector<int>&, std::vector<Instr>&, std::vector<Dir>&, std::vector<Error>&);
-int expandMacros (std::string, std::string, std::vector<int>&, std::vector<int>&, std::vector<Instr>&, std::vector<Dir>&, std::vector<Error>&);
+void mcrGetLine (std::string&, McrState&, PreState&, Tables&, std::vector<Error>&);
+int createMacro (std::string&, McrState&, PreState&, std::string_view, Tables&, std::vector<Error>&);
+void mcrSearchAndReplace (std::string_view, std::uint32_t, McrState&, Interner&);
+void mcrParser (std::string&, McrState&, PreState&, Tables&, std::vector<Error>&);
+int mcrNextLine (McrState&, PreState&, TokenLine&, Tables&, std::vector<Error>&);
+int expandMacros (McrState&, PreState&, Tables&, std::vector<Error>&);
 
 
 
 /*      DEFINIÇÕES DAS FUNÇÕES      */
 
+/*
+mcrGetLine: le a proxima linha da saida do preprocessamento, como um getline no arquivo '.pre'
+entrada: estado da passagem de macros e do preprocessamento, tabelas e lista de erros
+saida: nenhuma (linha dada por referencia e tokens dela em pre.tokens, vazia e com eof marcado se o preprocessamento acabou)
+*/
+void mcrGetLine (std::string &line, McrState &mcr, PreState &pre, Tables &tables, std::vector<Error> &errorList) {
+    
+    if (mcr.eof || !preNextLine(pre, line, tables, errorList)) {
+        line.clear();
+        pre.tokens.clear();
+        mcr.eof = 1;
+    }
+    
+}
+
+
+
 /*
 createMacro: le a definicao de uma macro e guarda na lista de macros
-entrada: linha atual, stream do arquivo .pre, nome da macro, lista de macros e contador de linha
+entrada: linha atual, estado da passagem de macros e do preprocessamento, nome da macro, tabelas e lista de erros
 saida: inteiro indicando erro (lista de macros e contador de linhas alterados por referencia)
 */
-int createMacro (std::string &line, std::ifstream &preFile, std::string &token, std::vector<Macro> &macroList, int &lineCounter) {
+int createMacro (std::string &line, McrState &mcr, PreState &pre, std::string_view token, Tables &tables, std::vector<Error> &errorList) {
+    
+    std::vector<Macro> &macroList = mcr.macroList;
+    int &lineCounter = mcr.lineCounter;
     
-    // cria uma string p guardar a definicao da macro
+    // cria uma string p guardar a definicao da macro (e os tokens de cada linha dela, que ja vem separados)
     std::string definition;
+    std::vector<Token> tokens;
+    std::vector<int> firstToken (1, 0);
     
     // indica se achou end indicando o final da macro
     int reachedEnd = 0;
@@ -34,13 +87,15 @@ int createMacro (std::string &line, std::ifstream &preFile, std::string &token,
         
         // a proxima linha eh lida
         std::string auxLine;
-        getline (preFile, auxLine);
+        mcrGetLine (auxLine, mcr, pre, tables, errorList);
         lineCounter++;
         
         if (auxLine != "END") {
             // se nao for o final, anexa na definicao
             definition = definition + auxLine + '\n';
             numLines++;
+            tokens.insert(tokens.end(), pre.tokens.begin(), pre.tokens.end());
+            firstToken.push_back(tokens.size());
         } else {
             // se for o final, ajusta a flag e tira o '\n' do final da definicao
             reachedEnd = 1;
@@ -48,13 +103,20 @@ int createMacro (std::string &line, std::ifstream &preFile, std::string &token,
                 definition.pop_back();
         }
         
-        if (!reachedEnd && preFile.eof())
+        if (!reachedEnd && mcr.eof)
             return -1;
     }
     
-    // armazena a macro na lista de macros
-    Macro macro (token, definition, initLine, numLines);
-    macroList.push_back(macro);
+    // armazena a macro na lista de macros (o indice guarda a primeira com cada nome, que eh a que vale nas chamadas)
+    std::uint32_t id = pre.symbols.intern(token);
+    if (id >= mcr.macroIndex.size())
+        mcr.macroIndex.resize(id+1, -1);
+    if (mcr.macroIndex[id] < 0)
+        mcr.macroIndex[id] = macroList.size();
+    mcr.bodies.push_back(std::move(definition));
+    macroList.push_back(Macro (id, mcr.bodies.back(), initLine, numLines));
+    macroList.back().tokens = std::move(tokens);
+    macroList.back().firstToken = std::move(firstToken);
     
     // nao escreve a linha que define o rotulo da macro
     line.clear();
@@ -65,55 +127,49 @@ int createMacro (std::string &line, std::ifstream &preFile, std::string &token,
 
 
 /*
-mcrSearchAndReplace: procura o token na lista de macros e substitui a macro no codigo
-entrada: linha atual, nome da macro sendo chamada, lista de macros, contador de linhas e flag indicando se uma macro foi chamada
-saida: nenhuma (linha atual e flag de macro alterada por referencia)
+mcrSearchAndReplace: procura o token na tabela de macros e marca a macro para ser expandida no lugar da linha atual
+entrada: nome da macro sendo chamada (e o identificador dele, ou NO_SYMBOL se o token nao for so o nome), estado da passagem de macros (lista de macros e flags indicando se uma macro foi chamada) e nomes dos simbolos
+saida: nenhuma (flags de macro alteradas por referencia)
 */
-void mcrSearchAndReplace (std::string &line, std::string &token, std::vector<Macro> &macroList, int &macroCall) {
-    
-    int found = 0;
-    macroCall = -1;
-    for (unsigned int i = 0; ((i < macroList.size()) && (!found)); ++i) {
-        if (token == macroList[i].name) {
-            // se encontrar, escreve a definicao no lugar da linha atual
-            line = macroList[i].definition;
-            found = 1;
-            macroCall = i;
-        }
-    }
+void mcrSearchAndReplace (std::string_view token, std::uint32_t id, McrState &mcr, Interner &symbols) {
+    
+    mcr.macroCall = (id != NO_SYMBOL) ? mcr.findMacro(id) : mcr.findMacro(symbols, token);
+    
+    // se encontrar, as linhas da definicao (ja separadas) sao entregues no lugar da linha atual, sem copiar a definicao
+    mcr.expansion = mcr.macroCall;
 }
 
 
 
 /*
 mcrParser: parser do processamento de macros. procura definicoes e chamadas de macros nas linhas
-entrada: linha atual, stream do arquivo .pre, lista de macros, contador de linhas, flag indicando se uma macro foi chamada e dicionário de linhas do preprocessamento
+entrada: linha atual, estado da passagem de macros (lista de macros, contador de linhas, flag indicando se uma macro foi chamada) e do preprocessamento (dicionário de linhas)
 saida: nenhuma (linha atual, contador de linhas e flag de macro alterados por referencia)
 */
-void mcrParser (std::string &line, std::ifstream &preFile, std::vector<Macro> &macroList, int &lineCounter, int &macroCall, std::vector<int> &lineDictPre, std::vector<Instr> &instrList, std::vector<Dir> &dirList, std::vector<Error> &errorList) {
+void mcrParser (std::string &line, McrState &mcr, PreState &pre, Tables &tables, std::vector<Error> &errorList) {
+    
+    LineMap &lineDictPre = pre.lineDict;
+    int &lineCounter = mcr.lineCounter;
     
-    // le uma linha do arquivo
-    getline(preFile, line);
+    // le uma linha da saida do preprocessamento
+    mcrGetLine (line, mcr, pre, tables, errorList);
     
-    // cria o stream para a linha e le um token
-    std::stringstream lineStream (line);
-    std::string token;
+    // le um token (os tokens da linha ja vem separados do preprocessamento)
+    TokenStream lineStream (TokenLine (line, pre.tokens.data(), pre.tokens.size()));
+    std::string_view token;
     lineStream >> token;
+    std::uint32_t tokenId = lineStream.id();
     
     // se o ultimo char for ':', esta definindo um rotulo
-    if (token.back() == ':') {
+    if (lineStream.kind() == TOKEN_LABEL) {
         
         // le o token seguinte
-        std::string token2;
+        std::string_view token2;
         lineStream >> token2;
         
         // verifica se esse rótulo já foi definido como uma macro
-        token.pop_back();
-        int redefinition = 0;
-        for (unsigned int i = 0; i < macroList.size(); ++i) {
-            if (macroList[i].name == token)
-                redefinition = 1;
-        }
+        token.remove_suffix(1);
+        int redefinition = (mcr.findMacro(tokenId) >= 0);
         if (redefinition) {
             int pos = 0;
             errorList.push_back(Error("redefinição de macro", "semântico", lineDictPre[lineCounter-1], line, pos));
@@ -124,7 +180,7 @@ void mcrParser (std::string &line, std::ifstream &preFile, std::vector<Macro> &m
             
             // verifica se o rótulo é válido
             int pos = 0;
-            int valid = labelCheck(token, instrList, dirList, pos);
+            int valid = labelCheck(token, tables, pos);
             if (valid == -1)
                 errorList.push_back(Error("tamanho do rótulo deve ser menor ou igual a 100 caracteres", "léxico", lineDictPre[lineCounter-1], line, pos));
             else if (valid == -2)
@@ -136,11 +192,14 @@ void mcrParser (std::string &line, std::ifstream &preFile, std::vector<Macro> &m
             else if (valid == -5)
                 errorList.push_back(Error("declaração de rótulo vazia", "sintático", lineDictPre[lineCounter-1], line, pos));
             
-            // cria uma macro na lista
-            int status = createMacro (line, preFile, token, macroList, lineCounter);
+            // cria uma macro na lista (se a definicao nao terminar, a linha continua na saida, entao guarda os tokens dela)
+            std::vector<Token> lineTokens (pre.tokens);
+            int macroLine = lineDictPre[lineCounter-1];
+            int status = createMacro (line, mcr, pre, token, tables, errorList);
             if (status == -1) {
+                pre.tokens.swap(lineTokens);
                 pos = 0;
-                errorList.push_back(Error("a definição de uma macro deve terminar com END", "semântico", lineDictPre[lineCounter-1], line, pos));
+                errorList.push_back(Error("a definição de uma macro deve terminar com END", "semântico", macroLine, line, pos));
             }
                 
             
@@ -148,55 +207,98 @@ void mcrParser (std::string &line, std::ifstream &preFile, std::vector<Macro> &m
     
     // se nao for definicao de rotulo, eh uma linha que pode ou nao estar chamando uma macro
     } else
-        mcrSearchAndReplace (line, token, macroList, macroCall);
+        mcrSearchAndReplace (token, (lineStream.kind() == TOKEN_WORD) ? tokenId : NO_SYMBOL, mcr, pre.symbols);
     
 }
 
 
 
 /*
-expandMacros: faz a passagem para expandir macros no arquivo, que inclui:
-    - substitui as macros
-    - (detectar erros)
-entrada: nome do arquivo de entrada '.pre', nome do arquivo de saida '.mcr' e dicionario de linhas
-saida: inteiro representando a ocorrencia de erro
+mcrNextLine: processa a saida do preprocessamento ate produzir a proxima linha com as macros expandidas, que eh entregue para a passagem seguinte (e copiada no '.mcr', se pedido)
+entrada: estado da passagem de macros e do preprocessamento, tabelas e lista de erros
+saida: 1 se uma linha foi produzida, 0 se acabaram as linhas (linha e tokens dela dados por referencia, validos ate a proxima chamada)
 */
-int expandMacros (std::string preFileName, std::string mcrFileName, std::vector<int> &lineDictMcr, std::vector<int> &lineDictPre, std::vector<Instr> &instrList, std::vector<Dir> &dirList, std::vector<Error> &errorList) {
-    
-    std::ifstream preFile (preFileName);
-    std::ofstream mcrFile (mcrFileName);
-
-    std::vector<Macro> macroList;
+int mcrNextLine (McrState &mcr, PreState &pre, TokenLine &line, Tables &tables, std::vector<Error> &errorList) {
     
-    int lineCounter = 1;
-    int macroCall = -1;
+    // o tempo ate a linha sair eh da passagem de macros (menos o do preprocessamento, que ela puxa)
+    int caller = mcr.stats ? mcr.stats->enter(STATS_MCR) : -1;
     
-    while (!preFile.eof()) {
+    // enquanto nao entregar todas as linhas de uma expansao, nao le outra linha
+    while (mcr.nextPending == mcr.numPending && !mcr.eof) {
         
-        // chama o parser da passagem de macros
-        std::string line;
-        mcrParser(line, preFile, macroList, lineCounter, macroCall, lineDictPre, instrList, dirList, errorList);
+        // chama o parser da passagem de macros (as linhas do bloco anterior ja foram todas entregues)
+        std::string &block = mcr.block;
+        mcr.expansion = -1;
+        mcr.numPending = 0;
+        mcr.nextPending = 0;
+        int firstLine = mcr.lineCounter;
+        mcrParser(block, mcr, pre, tables, errorList);
         
-        // se a linha nao estiver vazia, copia no arquivo '.mcr'        
-        if (!line.empty()) {
+        // as linhas de saida sao a propria linha ou as linhas da macro chamada
+        if (mcr.expansion > -1)
+            mcr.numPending = mcr.macroList[mcr.expansion].body.size();
+        else if (!block.empty())
+            mcr.numPending = 1;
+        
+        // se a linha nao estiver vazia, ela (ou a expansao da macro, que pode ter varias linhas) vai para a saida
+        int numEntries = 0;
+        if (mcr.numPending > 0) {
             
-            mcrFile << line << "\n";
+            if (mcr.mcrFile)
+                *mcr.mcrFile << ((mcr.expansion > -1) ? mcr.macroList[mcr.expansion].definition : std::string_view(block)) << "\n";
             
-            // se for chamada de macro, coloca no dicionario as linhas originais da macro
-            if (macroCall > -1) {
-                Macro macro = macroList[macroCall];
-                for (int i = macro.initLine; i < macro.initLine+macro.numLines; ++i)
-                    lineDictMcr.push_back(i);
-            } else
-                lineDictMcr.push_back(lineCounter);
+            // se for chamada de macro, coloca no dicionario o intervalo das linhas originais da macro
+            int source = mcr.lineCounter, count = 1;
+            if (mcr.macroCall > -1) {
+                source = mcr.macroList[mcr.macroCall].initLine;
+                count = mcr.macroList[mcr.macroCall].numLines;
+            }
+            mcr.lineMap.append(source, count);
+            if (mcr.stats && mcr.expansion > -1)
+                mcr.stats->expansions++;
+            numEntries = count;
         }
         
-        lineCounter++;
+        // registra as linhas lidas. a linha so eh comum se foi sozinha para a saida, sem chamar nem redefinir macro
+        if (mcr.trace) {
+            int plain = (mcr.lineCounter == firstLine && mcr.expansion == -1 && mcr.macroCall == -1 && (pre.tokens.empty() || mcr.findMacro(pre.tokens[0].id) < 0));
+            mcr.trace->mcrGroup(pre.lineDict, firstLine, mcr.lineCounter, mcr.numPending, numEntries, plain, mcr.macroCall != -1);
+        }
+        
+        mcr.lineCounter++;
         
     }
     
-    preFile.close();
-    mcrFile.close();
+    if (mcr.stats) {
+        mcr.stats->enter(caller);
+        mcr.stats->linesOut[STATS_MCR] += (mcr.nextPending < mcr.numPending);
+    }
+    
+    if (mcr.nextPending == mcr.numPending)
+        return 0;
+    
+    if (mcr.expansion > -1)
+        line = mcr.macroList[mcr.expansion].line(mcr.nextPending);
+    else
+        line = TokenLine (mcr.block, pre.tokens.data(), pre.tokens.size());
+    mcr.nextPending++;
+    return 1;
+}
+
+
+
+/*
+expandMacros: faz a passagem para expandir macros no arquivo inteiro (operacao -m), que inclui:
+    - substitui as macros
+    - (detectar erros)
+entrada: estado da passagem de macros (com o '.mcr' de saida) e do preprocessamento, tabelas e lista de erros
+saida: inteiro representando a ocorrencia de erro
+*/
+int expandMacros (McrState &mcr, PreState &pre, Tables &tables, std::vector<Error> &errorList) {
+    
+    // consome todas as linhas (que vao sendo copiadas no arquivo '.mcr')
+    TokenLine line;
+    while (mcrNextLine(mcr, pre, line, tables, errorList));
     
     // futuramente, indicara erros no valor de retorno
     return 0;
@@ -0,0 +1,235 @@
+/*      OBJ.H: escrita do arquivo objeto (texto ou binário) e leitura do formato binário mapeado em memória        */
+
+
+
+/*      DEFINIÇÕES DO FORMATO       */
+
+// cabecalho do '.o' binario (todos os campos em little endian):
+//     bytes 0-3: magico "SBO1"
+//     bytes 4-5: versao do formato
+//     bytes 6-7: tamanho de uma palavra em bytes
+//     bytes 8-11: ponto de entrada (endereco do comeco da secao de texto)
+//     bytes 12-15: numero de palavras da secao de texto (que ocupa os enderecos [entrada, entrada + tamanho))
+//     bytes 16-19: numero de palavras fora da secao de texto (secao de dados)
+// depois do cabecalho vem as palavras do codigo de maquina, tambem em little endian
+const char OBJ_MAGIC[4] = {'S', 'B', 'O', '1'};
+const int OBJ_VERSION = 1;
+const int OBJ_WORD_SIZE = 4;
+const int OBJ_HEADER_SIZE = 20;
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// OutputBuffer: escrita de um arquivo de saida por um buffer grande, esvaziado com poucas chamadas de write
+// (os inteiros sao formatados com to_chars, sem passar pelo locale como o '<<' de uma stream)
+struct OutputBuffer {
+    // membros
+    int fd; // arquivo de saida (-1 se nao estiver aberto)
+    std::vector<char> buffer; // buffer reutilizado entre as escritas
+    std::size_t used; // quantos bytes do buffer estao ocupados
+    std::size_t written; // quantos bytes ja foram escritos no arquivo
+    // metodos
+    OutputBuffer (): fd(-1), buffer(1 << 16), used(0), written(0) {};
+    OutputBuffer (const OutputBuffer&) = delete;
+    OutputBuffer& operator= (const OutputBuffer&) = delete;
+    ~OutputBuffer () { close(); };
+    // cria (ou trunca) o arquivo, so para escrita ou, com O_RDWR, tambem para leitura (para o que foi escrito ser mapeado e corrigido depois). retorna 1 se conseguiu, 0 se nao
+    int open (const std::string &fileName, int mode = O_WRONLY) {
+        close();
+        fd = ::open(fileName.c_str(), mode | O_CREAT | O_TRUNC, 0666);
+        written = 0;
+        return fd >= 0;
+    };
+    // escreve o que estiver no buffer
+    void flush () {
+        std::size_t done = 0;
+        while (fd >= 0 && done < used) {
+            ssize_t n = ::write(fd, buffer.data() + done, used - done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        written += done;
+        used = 0;
+    };
+    // esvazia o buffer e fecha o arquivo
+    void close () {
+        if (fd < 0)
+            return;
+        flush();
+        ::close(fd);
+        fd = -1;
+    };
+    // quantos bytes o arquivo tera depois do proximo flush (o que ja foi escrito mais o que esta no buffer)
+    std::size_t size () const { return written + used; };
+    // garante que cabem mais 'n' bytes no buffer
+    void reserve (std::size_t n) {
+        if (used + n > buffer.size())
+            flush();
+    };
+    // anexa um inteiro em decimal (o mesmo texto que o '<<' escreveria)
+    void putInt (int value) {
+        reserve(12);
+        used = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value).ptr - buffer.data();
+    };
+    void putChar (char c) {
+        reserve(1);
+        buffer[used++] = c;
+    };
+    void putBytes (const char *bytes, std::size_t n) {
+        reserve(n);
+        // blocos maiores que o buffer sao copiados aos pedacos
+        while (n > buffer.size() - used) {
+            std::size_t part = buffer.size() - used;
+            memcpy(buffer.data() + used, bytes, part);
+            used += part;
+            flush();
+            bytes += part;
+            n -= part;
+        }
+        memcpy(buffer.data() + used, bytes, n);
+        used += n;
+    };
+};
+
+
+// ObjFile: arquivo objeto binario mapeado em memoria (mmap). as palavras sao lidas direto do mapeamento
+struct ObjFile {
+    // membros
+    const unsigned char *data; // inicio do arquivo mapeado
+    std::size_t size; // tamanho do arquivo
+    int version; // versao do formato
+    int entry; // ponto de entrada
+    int textSize; // numero de palavras da secao de texto, a partir do ponto de entrada
+    int dataSize; // numero de palavras fora da secao de texto
+    // metodos
+    ObjFile (): data(nullptr), size(0), version(0), entry(0), textSize(0), dataSize(0) {};
+    ObjFile (const ObjFile&) = delete;
+    ObjFile& operator= (const ObjFile&) = delete;
+    ~ObjFile () { close(); };
+    // mapeia o arquivo e confere o cabecalho. retorna 1 se conseguiu, 0 se o arquivo nao existe ou nao eh um '.o' binario valido
+    int open (const std::string &fileName) {
+        close();
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return 0;
+        struct stat info;
+        if (fstat(fd, &info) < 0 || info.st_size < OBJ_HEADER_SIZE) {
+            ::close(fd);
+            return 0;
+        }
+        void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+            return 0;
+        data = (const unsigned char*) map;
+        size = info.st_size;
+        version = readHalf(4);
+        entry = readWord(8);
+        textSize = readWord(12);
+        dataSize = readWord(16);
+        // confere o magico, a versao, o tamanho da palavra, se o arquivo tem todas as palavras e se a secao de texto cabe nelas
+        if (memcmp(data, OBJ_MAGIC, 4) != 0 || version != OBJ_VERSION || readHalf(6) != OBJ_WORD_SIZE || textSize < 0 || dataSize < 0
+            || size != OBJ_HEADER_SIZE + ((std::size_t) textSize + dataSize) * OBJ_WORD_SIZE || entry < 0 || (long long) entry + textSize > (long long) textSize + dataSize) {
+            close();
+            return 0;
+        }
+        return 1;
+    };
+    // desfaz o mapeamento
+    void close () {
+        if (data)
+            munmap((void*) data, size);
+        data = nullptr;
+        size = 0;
+    };
+    // numero de palavras do codigo de maquina
+    int numWords () const { return textSize + dataSize; };
+    // palavra no endereco dado
+    int word (int address) const { return readWord(OBJ_HEADER_SIZE + address*OBJ_WORD_SIZE); };
+    // ponteiro para as palavras, para usar o codigo direto do mapeamento (so em maquinas little endian, senao eh nullptr)
+    const std::int32_t* words () const {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return (const std::int32_t*) (data + OBJ_HEADER_SIZE);
+#else
+        return nullptr;
+#endif
+    };
+    // le inteiros em little endian de qualquer posicao do arquivo
+    int readWord (std::size_t at) const { return (std::int32_t) (data[at] | (data[at+1] << 8) | (data[at+2] << 16) | ((std::uint32_t) data[at+3] << 24)); };
+    int readHalf (std::size_t at) const { return data[at] | (data[at+1] << 8); };
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+void putWord (OutputBuffer&, int);
+void objHeader (char*, int, int, int);
+std::size_t writeObject (std::string, std::vector<int>&, int, int);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+putWord: anexa um inteiro de 32 bits em little endian
+entrada: saida e inteiro
+saida: nenhuma
+*/
+void putWord (OutputBuffer &outFile, int value) {
+    
+    std::uint32_t bits = value;
+    char bytes[4] = {(char) (bits & 0xFF), (char) ((bits >> 8) & 0xFF), (char) ((bits >> 16) & 0xFF), (char) ((bits >> 24) & 0xFF)};
+    outFile.putBytes(bytes, 4);
+
+}
+
+
+
+/*
+objHeader: preenche o cabecalho do formato binario
+entrada: cabecalho (OBJ_HEADER_SIZE bytes), ponto de entrada, tamanho da secao de texto e numero total de palavras
+saida: nenhuma
+*/
+void objHeader (char *header, int entry, int textSize, int numWords) {
+    
+    int fields[3] = {entry, textSize, numWords - textSize};
+    memcpy(header, OBJ_MAGIC, 4);
+    header[4] = OBJ_VERSION & 0xFF;
+    header[5] = OBJ_VERSION >> 8;
+    header[6] = OBJ_WORD_SIZE & 0xFF;
+    header[7] = OBJ_WORD_SIZE >> 8;
+    for (int f = 0; f < 3; ++f) {
+        std::uint32_t bits = fields[f];
+        for (int b = 0; b < 4; ++b)
+            header[8 + 4*f + b] = (bits >> (8*b)) & 0xFF;
+    }
+
+}
+
+
+
+/*
+writeObject: escreve o codigo de maquina no formato binario (cabecalho e palavras em little endian)
+entrada: nome do arquivo de saida, codigo de maquina, ponto de entrada e tamanho da secao de texto
+saida: numero de bytes escritos
+*/
+std::size_t writeObject (std::string outFileName, std::vector<int> &machineCode, int entry, int textSize) {
+    
+    OutputBuffer outFile;
+    outFile.open(outFileName);
+    
+    // cabecalho
+    char header[OBJ_HEADER_SIZE];
+    objHeader (header, entry, textSize, machineCode.size());
+    outFile.putBytes(header, OBJ_HEADER_SIZE);
+    
+    // palavras
+    for (unsigned int i = 0; i < machineCode.size(); ++i)
+        putWord (outFile, machineCode[i]);
+    
+    outFile.close();
+    return outFile.written;
+
+}
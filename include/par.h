@@ -0,0 +1,481 @@
+/*      PAR.H: montagem de um arquivo grande dividido em blocos montados em paralelo        */
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// numero minimo de linhas de um bloco (abaixo disso nao compensa criar mais blocos)
+const int PAR_CHUNK_LINES = 4096;
+
+// AsmChunk: um bloco de linhas da saida das macros, montado sozinho com tabela de simbolos e enderecos proprios
+struct AsmChunk {
+    // membros
+    int begin, end; // linhas do bloco (indices de 'lines', 'end' nao incluso)
+    int section; // secao no comeco do bloco (calculada antes da montagem)
+    int endSection; // ultima secao declarada no bloco (-2: o bloco nao declara secao)
+    int textLine, dataLine; // primeira linha do bloco que declara a secao de texto / de dados (-1: nenhuma)
+    int sectionText; // -1: o bloco nao tem SECTION TEXT, 0: tem
+    SymbolTable labelList; // tabela de simbolos do bloco (enderecos relativos ao comeco do bloco. os nomes sao os do preprocessamento, so lidos pelas threads)
+    std::vector<int> machineCode; // codigo de maquina do bloco
+    int textAddr, dataAddr; // endereco (relativo ao bloco) da primeira palavra depois de 'textLine' / 'dataLine' (-1: nenhuma)
+    std::vector<Error> errorList; // erros da montagem do bloco
+    std::vector<int> errorMarks; // quantidade de erros do bloco depois de cada linha
+    // metodos
+    AsmChunk (): begin(0), end(0), section(-1), endSection(-2), textLine(-1), dataLine(-1), sectionText(-1), textAddr(-1), dataAddr(-1) {};
+};
+
+
+
+// LinkTrace: o que a juntada dos blocos fez, para a montagem incremental corrigir depois so a parte do '.o' e dos erros que uma edicao muda (ver inc.h)
+struct LinkTrace {
+    // membros
+    std::vector<int> base; // bloco -> endereco do comeco dele no codigo juntado
+    std::vector<char> merged; // bloco -> se foi juntado como estava (1) ou montado de novo em serie (0)
+    std::vector<int> firstChunk, defChunk; // rotulo da tabela juntada -> primeiro bloco que tem o rotulo e primeiro bloco que o define (-1: nenhum)
+    std::vector<char> redefined; // rotulo -> se um bloco depois do que o definiu tambem o define (e pode ter mudado as caracteristicas dele)
+    std::vector<int> errorChunk, errorLine; // erro da juntada (antes das pendencias) -> bloco e linha da saida das macros em que ele entrou na lista
+    std::vector<char> errorSource; // erro da juntada -> se veio das passagens anteriores
+    std::vector<int> fixupLabel, fixupAddress; // erro das pendencias -> rotulo e endereco da referencia
+    int sectionText; // -1: não encontrou seção texto, 0: encontrou
+    SymbolTable labelList; // tabela de simbolos juntada
+    std::vector<int> machineCode; // codigo de maquina final
+    // metodos
+    LinkTrace (): sectionText(-1) {};
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+void sectionScan (const TokenLine&, Tables&, int&);
+void chunkWorker (std::vector<AsmChunk>&, std::atomic<int>&, int, std::pmr::vector<TokenLine>&, const LineDict&, Tables&);
+int refCheck (Label&, int, int, Tables&);
+int mergeCheck (AsmChunk&, SymbolTable&, Tables&);
+void mergeChunk (AsmChunk&, SymbolTable&, std::vector<int>&);
+void runChunks (std::vector<AsmChunk>&, int, int, std::pmr::vector<TokenLine>&, const LineDict&, Tables&);
+void linkChunks (std::vector<AsmChunk>&, std::pmr::vector<TokenLine>&, std::pmr::vector<std::string_view>&, const LineDict&, std::vector<Error>&, std::vector<int>&, Interner&, std::string, Tables&, std::vector<Error>&, int, LinkTrace* = nullptr);
+void assembleCodeParallel (McrState&, PreState&, std::string, Tables&, std::vector<Error>&, int, int);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+sectionScan: ve se a linha eh uma diretiva SECTION valida e atualiza a secao, do mesmo jeito que o asmParser (mas sem montar nada)
+entrada: linha da saida das macros (com os tokens), tabelas e secao atual
+saida: nenhuma (secao atualizada)
+*/
+void sectionScan (const TokenLine &line, Tables &tables, int &section) {
+    
+    if (line.text.empty())
+        return;
+    
+    TokenStream lineStream (line);
+    std::string_view token;
+    lineStream >> token;
+    
+    // pula o rotulo (se nao houver mais tokens, o token continua sendo o nome do rotulo, como no asmParser)
+    if (!token.empty() && token.back() == ':') {
+        token.remove_suffix(1);
+        lineStream >> token;
+    }
+    
+    if (tables.findInstr(token) >= 0)
+        return;
+    int isDirective = tables.findDir(token);
+    if (isDirective < 0 || tables.dirList[isDirective].name != "SECTION")
+        return;
+    
+    std::string_view token2;
+    lineStream >> token2;
+    if (token2 == "TEXT")
+        section = 0;
+    else if (token2 == "DATA")
+        section = 1;
+
+}
+
+
+
+/*
+chunkWorker: laco de uma thread da montagem em blocos. pega blocos ate acabarem
+entrada: blocos, contador do proximo bloco, etapa (0: so acha a ultima secao de cada bloco, 1: monta os blocos), linhas, dicionario de linhas e tabelas
+saida: nenhuma (blocos preenchidos)
+*/
+void chunkWorker (std::vector<AsmChunk> &chunks, std::atomic<int> &next, int phase, std::pmr::vector<TokenLine> &lines, const LineDict &lineDict, Tables &tables) {
+    
+    int k;
+    while ((k = next++) < (int) chunks.size()) {
+        
+        AsmChunk &chunk = chunks[k];
+        
+        // etapa 0: secao no final do bloco, para saber a secao no comeco de cada bloco antes de montar
+        if (phase == 0) {
+            for (int l = chunk.begin; l < chunk.end; ++l) {
+                int lastSection = chunk.endSection;
+                sectionScan (lines[l], tables, chunk.endSection);
+                if (chunk.endSection != lastSection && chunk.endSection == 0 && chunk.textLine < 0)
+                    chunk.textLine = l;
+                if (chunk.endSection != lastSection && chunk.endSection == 1 && chunk.dataLine < 0)
+                    chunk.dataLine = l;
+            }
+            continue;
+        }
+        
+        // etapa 1: monta o bloco com enderecos a partir de 0 e tabela de simbolos propria
+        int addrCounter = 0;
+        int section = chunk.section;
+        chunk.textAddr = -1;
+        chunk.dataAddr = -1;
+        for (int l = chunk.begin; l < chunk.end; ++l) {
+            int lineCounter = l+1;
+            asmParser(lines[l], chunk.labelList, lineCounter, addrCounter, lineDict, tables, section, chunk.sectionText, chunk.machineCode, chunk.errorList);
+            chunk.errorMarks.push_back(chunk.errorList.size());
+            if (l == chunk.textLine)
+                chunk.textAddr = addrCounter;
+            if (l == chunk.dataLine)
+                chunk.dataAddr = addrCounter;
+        }
+    }
+
+}
+
+
+
+/*
+refCheck: ve se uma referencia a um rotulo ja definido passaria pelas verificacoes que o assembleInstr faz na hora
+entrada: rotulo, informacao auxiliar da pendencia (como em resolveCode), deslocamento e tabelas
+saida: 1 se passaria sem erro, 0 se daria erro (ou se nao da pra ter certeza)
+*/
+int refCheck (Label &label, int auxInfo, int offset, Tables &tables) {
+    
+    if (auxInfo == 1 && label.isConst == 2)
+        return 0; // divisao por zero
+    if (auxInfo == 2 && label.vectSize != 0)
+        return 0; // pulo para a secao de dados
+    if (auxInfo == 3 && label.isConst != 0)
+        return 0; // modificando constante
+    if (label.vectSize == 0 && auxInfo != 2)
+        return 0; // acesso a secao de texto
+    
+    // o assembleInstr proibe deslocamento pelo opcode dos pulos (5 a 8). com uma tabela lida de arquivo, nao da pra saber pelo nome
+    if (offset != 0 && (auxInfo == 2 || !tables.builtinInstr))
+        return 0;
+    
+    if (offset >= label.vectSize && label.vectSize > 0)
+        return 0; // indice excede o vetor
+    
+    return 1;
+}
+
+
+
+/*
+mergeCheck: ve se o bloco, montado sem conhecer os blocos anteriores, ficou igual ao que a montagem em serie faria
+(so muda quando o bloco redefine um rotulo de um bloco anterior, ou quando uma referencia a um rotulo de um bloco anterior daria erro na hora)
+entrada: bloco, tabela de simbolos dos blocos anteriores e tabelas
+saida: 1 se o bloco pode ser juntado, 0 se precisa ser montado de novo em serie
+*/
+int mergeCheck (AsmChunk &chunk, SymbolTable &labelList, Tables &tables) {
+    
+    // rotulo do bloco -> rotulo dos blocos anteriores que ja foi definido (-1 se e novo ou ainda nao definido)
+    std::vector<int> defined (chunk.labelList.size(), -1);
+    
+    for (int i = 0; i < chunk.labelList.size(); ++i) {
+        
+        int found = labelList.find(chunk.labelList[i].id);
+        
+        // rotulos novos ou ainda nao definidos se comportam do mesmo jeito no bloco e na montagem em serie
+        if (found < 0 || !labelList[found].isDefined)
+            continue;
+        
+        // redefinicao de um rotulo de um bloco anterior
+        if (chunk.labelList[i].isDefined)
+            return 0;
+        
+        defined[i] = found;
+    }
+    
+    // as pendencias do bloco seriam referencias a um rotulo ja definido na montagem em serie
+    FixupTable &fixups = chunk.labelList.fixups;
+    for (int k = 0; k < fixups.size(); ++k) {
+        int found = defined[fixups.label[k]];
+        if (found >= 0 && !refCheck(labelList[found], fixups.kind[k], chunk.machineCode[fixups.address[k]], tables))
+            return 0;
+    }
+    
+    return 1;
+}
+
+
+
+/*
+mergeChunk: junta o bloco ao codigo ja montado, realocando os enderecos dele e juntando as tabelas de simbolos
+entrada: bloco, tabela de simbolos e codigo de maquina dos blocos anteriores
+saida: nenhuma (bloco anexado)
+*/
+void mergeChunk (AsmChunk &chunk, SymbolTable &labelList, std::vector<int> &machineCode) {
+    
+    int base = machineCode.size(); // endereco do comeco do bloco (soma dos tamanhos dos blocos anteriores)
+    
+    // o codigo do bloco eh copiado e realocado na copia (o bloco continua valendo, para a montagem incremental reaproveitar)
+    machineCode.insert(machineCode.end(), chunk.machineCode.begin(), chunk.machineCode.end());
+    
+    // enderecos de rotulos do proprio bloco que ja foram colocados no codigo
+    for (unsigned int i = 0; i < chunk.labelList.resolvedList.size(); ++i)
+        machineCode[base + chunk.labelList.resolvedList[i]] += base;
+    
+    // rotulo do bloco -> rotulo da tabela global, e se ele ja tinha sido definido num bloco anterior
+    std::vector<int> global (chunk.labelList.size());
+    std::vector<char> earlier (chunk.labelList.size(), 0);
+    
+    for (int i = 0; i < chunk.labelList.size(); ++i) {
+        
+        Label &label = chunk.labelList[i];
+        int found = labelList.find(label.id);
+        
+        // rotulo novo: entra na tabela na mesma ordem que entraria na montagem em serie
+        if (found < 0)
+            found = labelList.insert(label.id);
+        global[i] = found;
+        
+        if (labelList[found].isDefined) {
+            earlier[i] = 1;
+        } else if (label.isDefined) {
+            labelList[found].value = label.value + base;
+            labelList[found].isDefined = 1;
+            labelList[found].isConst = label.isConst;
+            labelList[found].vectSize = label.vectSize;
+        }
+    }
+    
+    FixupTable &fixups = chunk.labelList.fixups;
+    for (int k = 0; k < fixups.size(); ++k) {
+        int i = fixups.label[k];
+        if (earlier[i]) // rotulo definido num bloco anterior: a montagem em serie teria colocado o endereco direto (mergeCheck ja viu que nao da erro)
+            machineCode[base + fixups.address[k]] += labelList[global[i]].value;
+        else // senao a pendencia vai para a tabela global, na ordem em que a montagem em serie a faria
+            labelList.fixups.push(global[i], fixups.address[k] + base, fixups.kind[k], fixups.column[k], fixups.line[k]);
+    }
+
+}
+
+
+
+/*
+runChunks: executa uma etapa sobre todos os blocos, com varias threads
+entrada: blocos, numero de threads, etapa, linhas, dicionario de linhas e tabelas
+saida: nenhuma
+*/
+void runChunks (std::vector<AsmChunk> &chunks, int numThreads, int phase, std::pmr::vector<TokenLine> &lines, const LineDict &lineDict, Tables &tables) {
+    
+    std::atomic<int> next (0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+        threads.push_back(std::thread(chunkWorker, std::ref(chunks), std::ref(next), phase, std::ref(lines), std::ref(lineDict), std::ref(tables)));
+    for (unsigned int t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+}
+
+
+
+/*
+linkChunks: junta os blocos ja montados em ordem (montando de novo em serie os que dependem dos anteriores), intercala os erros das passagens anteriores, resolve as pendencias e escreve o '.o'
+entrada: blocos, linhas da saida das macros (com os tokens e so o texto), dicionario de linhas, erros das passagens anteriores e quantos deles vieram antes de cada linha, nomes dos simbolos, nome do arquivo de saida '.o', tabelas, lista de erros,
+formato da saida (0: texto, 1: binario) e, se pedido, registro do que a juntada fez
+saida: nenhuma (arquivo '.o' escrito, erros na lista e registro preenchido)
+*/
+void linkChunks (std::vector<AsmChunk> &chunks, std::pmr::vector<TokenLine> &tokenLines, std::pmr::vector<std::string_view> &lines, const LineDict &lineDict, std::vector<Error> &srcErrors, std::vector<int> &srcMarks, Interner &symbols, std::string outFileName, Tables &tables, std::vector<Error> &errorList, int binary, LinkTrace *trace) {
+    
+    SymbolTable labelList (symbols); // tabela de simbolos
+    std::vector<int> machineCode; // codigo de maquina
+    int sectionText = -1; // -1: não encontrou seção texto, 0: encontrou
+    int section; // secao atual (so usada quando um bloco eh montado de novo em serie)
+    unsigned int srcNext = 0; // proximo erro das passagens anteriores a ser colocado na lista
+    int textAddr = -1, dataAddr = -1; // endereço onde começa cada seção: o da primeira palavra depois da primeira linha que declara a seção
+    
+    // marca no registro o bloco e a linha dos erros que acabaram de entrar na lista
+    std::size_t firstError = errorList.size();
+    auto mark = [&] (int k, int l, char source) {
+        for (std::size_t e = firstError + trace->errorChunk.size(); e < errorList.size(); ++e) {
+            trace->errorChunk.push_back(k);
+            trace->errorLine.push_back(l);
+            trace->errorSource.push_back(source);
+        }
+    };
+    
+    // junta os blocos em ordem
+    for (unsigned int k = 0; k < chunks.size(); ++k) {
+        
+        AsmChunk &chunk = chunks[k];
+        int merged = mergeCheck(chunk, labelList, tables);
+        if (trace) {
+            trace->base.push_back(machineCode.size());
+            trace->merged.push_back(merged);
+        }
+        
+        if (merged) {
+            
+            if (textAddr < 0 && chunk.textAddr >= 0)
+                textAddr = machineCode.size() + chunk.textAddr;
+            if (dataAddr < 0 && chunk.dataAddr >= 0)
+                dataAddr = machineCode.size() + chunk.dataAddr;
+            mergeChunk (chunk, labelList, machineCode);
+            if (chunk.sectionText == 0)
+                sectionText = 0;
+            
+            // erros na mesma ordem da montagem em serie: os das passagens anteriores ate a linha, e depois os da linha
+            int chunkNext = 0;
+            for (int l = chunk.begin; l < chunk.end; ++l) {
+                for (; srcNext < (unsigned int) srcMarks[l]; ++srcNext)
+                    errorList.push_back(srcErrors[srcNext]);
+                if (trace)
+                    mark(k, l, 1);
+                for (; chunkNext < chunk.errorMarks[l-chunk.begin]; ++chunkNext)
+                    errorList.push_back(chunk.errorList[chunkNext]);
+                if (trace)
+                    mark(k, l, 0);
+            }
+        
+        } else {
+            
+            // monta o bloco de novo, em serie, sobre o estado dos blocos anteriores
+            int addrCounter = machineCode.size();
+            section = chunk.section;
+            for (int l = chunk.begin; l < chunk.end; ++l) {
+                for (; srcNext < (unsigned int) srcMarks[l]; ++srcNext)
+                    errorList.push_back(srcErrors[srcNext]);
+                if (trace)
+                    mark(k, l, 1);
+                int lineCounter = l+1;
+                asmParser(tokenLines[l], labelList, lineCounter, addrCounter, lineDict, tables, section, sectionText, machineCode, errorList);
+                if (trace)
+                    mark(k, l, 0);
+                if (textAddr < 0 && l == chunk.textLine)
+                    textAddr = addrCounter;
+                if (dataAddr < 0 && l == chunk.dataLine)
+                    dataAddr = addrCounter;
+            }
+        
+        }
+        
+        // bloco onde cada rotulo apareceu e foi definido (os rotulos de um bloco entram na tabela do mesmo jeito juntando ou montando de novo)
+        if (trace) {
+            trace->firstChunk.resize(labelList.size(), -1);
+            trace->defChunk.resize(labelList.size(), -1);
+            trace->redefined.resize(labelList.size(), 0);
+            for (int i = 0; i < chunk.labelList.size(); ++i) {
+                int found = labelList.find(chunk.labelList[i].id);
+                if (found < 0)
+                    continue;
+                if (trace->firstChunk[found] < 0)
+                    trace->firstChunk[found] = k;
+                if (chunk.labelList[i].isDefined && trace->defChunk[found] < 0)
+                    trace->defChunk[found] = k;
+                else if (chunk.labelList[i].isDefined && trace->defChunk[found] != (int) k)
+                    trace->redefined[found] = 1;
+            }
+        }
+    }
+    for (; srcNext < srcErrors.size(); ++srcNext)
+        errorList.push_back(srcErrors[srcNext]);
+    if (trace)
+        mark(chunks.size(), lines.size(), 1);
+    
+    if (sectionText == -1)
+        errorList.push_back(Error ("seção texto é obrigatória", "semântico", -1, "", 0));
+    
+    // resolve as listas de pendências (e reporta erros)
+    resolveCode (labelList, machineCode, lineDict, lines, errorList, nullptr, trace ? &trace->fixupAddress : nullptr);
+    
+    // escreve o codigo de maquina final no arquivo
+    writeCode (outFileName, machineCode, binary, textAddr, dataAddr);
+    
+    if (trace) {
+        // rotulo de cada erro das pendencias (os erros saem na ordem das pendencias, ja ordenadas pelo rotulo)
+        FixupTable &fixups = labelList.fixups;
+        int f = 0;
+        for (unsigned int e = 0; e < trace->fixupAddress.size(); ++e) {
+            while (fixups.address[f] != trace->fixupAddress[e])
+                f++;
+            trace->fixupLabel.push_back(fixups.label[f]);
+        }
+        trace->sectionText = sectionText;
+        trace->labelList = std::move(labelList);
+        trace->machineCode = std::move(machineCode);
+    }
+
+}
+
+
+
+/*
+assembleCodeParallel: faz a passagem de montagem dividindo o codigo em blocos montados em paralelo. o resultado (codigo e erros,
+na mesma ordem) eh igual ao do assembleCode:
+    - as linhas da passagem de macros sao lidas antes, em serie
+    - a secao no comeco de cada bloco eh calculada antes de montar
+    - cada bloco eh montado com enderecos a partir de 0 e tabela de simbolos propria
+    - os blocos sao juntados em ordem, somando os tamanhos para achar o endereco de cada um. um bloco que dependa
+      dos anteriores de um jeito que a montagem separada nao reproduz eh montado de novo, em serie
+entrada: estado da passagem de macros e do preprocessamento, nome do arquivo de saida '.o', tabelas, lista de erros, formato da saida (0: texto, 1: binario) e numero de threads
+saida: nenhuma (arquivo '.o' escrito)
+*/
+void assembleCodeParallel (McrState &mcr, PreState &pre, std::string outFileName, Tables &tables, std::vector<Error> &errorList, int binary, int numThreads) {
+    
+    LineDict lineDict (mcr.lineMap, pre.lineDict); // linha da saida das macros -> linha do arquivo original (composto so quando um erro eh reportado)
+    
+    RunArena arena; // memoria da montagem, liberada de uma vez no final
+    
+    std::pmr::vector<std::string_view> lines (arena.get()); // linhas da saida das macros, copiadas na arena
+    std::pmr::vector<Token> tokens (arena.get()); // tokens de todas as linhas, copiados na arena
+    std::pmr::vector<int> firstToken (1, 0, arena.get()); // linha -> primeiro token dela em 'tokens' (com uma posicao a mais no final)
+    
+    std::vector<int> srcMarks; // quantidade de erros das passagens anteriores quando cada linha foi lida
+    
+    // le todas as linhas. os erros das passagens anteriores sao separados para serem intercalados com os da montagem depois
+    unsigned int first = errorList.size();
+    TokenLine line;
+    while (mcrNextLine(mcr, pre, line, tables, errorList)) {
+        lines.push_back(arena.copy(line.text));
+        tokens.insert(tokens.end(), line.tokens, line.tokens + line.numTokens);
+        firstToken.push_back(tokens.size());
+        srcMarks.push_back(errorList.size() - first);
+    }
+    std::vector<Error> srcErrors (errorList.begin()+first, errorList.end());
+    errorList.erase(errorList.begin()+first, errorList.end());
+    
+    // linhas com os tokens (so depois de ler tudo, porque 'tokens' muda de lugar enquanto cresce)
+    std::pmr::vector<TokenLine> tokenLines (arena.get());
+    tokenLines.reserve(lines.size());
+    for (unsigned int l = 0; l < lines.size(); ++l)
+        tokenLines.push_back(TokenLine (lines[l], tokens.data() + firstToken[l], firstToken[l+1] - firstToken[l]));
+    
+    // divide as linhas em blocos
+    int numChunks = lines.size() / PAR_CHUNK_LINES;
+    if (numChunks > numThreads*4)
+        numChunks = numThreads*4;
+    if (numChunks < 1)
+        numChunks = 1;
+    std::vector<AsmChunk> chunks (numChunks);
+    for (int k = 0; k < numChunks; ++k) {
+        chunks[k].labelList.symbols = &pre.symbols;
+        chunks[k].begin = (long long) lines.size() * k / numChunks;
+        chunks[k].end = (long long) lines.size() * (k+1) / numChunks;
+    }
+    
+    // secao no comeco de cada bloco
+    runChunks (chunks, numThreads, 0, tokenLines, lineDict, tables);
+    int section = -1; // -1: nenhuma, 0: text, 1: data
+    for (int k = 0; k < numChunks; ++k) {
+        chunks[k].section = section;
+        if (chunks[k].endSection != -2)
+            section = chunks[k].endSection;
+    }
+    
+    // monta os blocos
+    runChunks (chunks, numThreads, 1, tokenLines, lineDict, tables);
+    
+    // junta os blocos e escreve o codigo
+    linkChunks (chunks, tokenLines, lines, lineDict, srcErrors, srcMarks, pre.symbols, outFileName, tables, errorList, binary);
+
+}
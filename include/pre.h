@@ -2,91 +2,125 @@
 
 
 
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// PreState: estado da passagem de preprocessamento, que entrega as linhas ja processadas uma a uma para a passagem seguinte
+struct PreState {
+    // membros
+    SourceFile asmFile; // arquivo de entrada '.asm', mapeado em memoria
+    Interner symbols; // nomes dos simbolos do arquivo, compartilhados pelas passagens de preprocessamento, macros e montagem
+    EquTable equTable; // rotulos definidos por EQU
+    LineMap lineDict; // dicionario de linhas em intervalos (linha de saida -> linha do arquivo '.asm')
+    std::vector<Token> tokens; // tokens da ultima linha entregue (reaproveitado entre as linhas)
+    int lineCounter; // linha atual do arquivo '.asm'
+    std::ofstream *preFile; // arquivo '.pre' onde as linhas sao copiadas (nullptr se nao for pedido)
+    LineTrace *trace; // registro do que aconteceu com cada linha (nullptr se nao for pedido)
+    RunStats *stats; // tempo e contadores da execucao (nullptr se nao forem pedidos)
+    int maxErrors; // com esse numero de erros, o arquivo para de ser lido (0: sem limite)
+    int stopped; // se o arquivo parou de ser lido por causa do limite de erros
+    // metodos
+    PreState (): lineCounter(1), preFile(nullptr), trace(nullptr), stats(nullptr), maxErrors(0), stopped(0) { equTable.symbols = &symbols; };
+};
+
+
+
 /*      DECLARAÇÕES DAS FUNÇÕES      */
-void preReadLine (std::string&, std::ifstream&, std::vector<Label>&);
-void appendNextLine (std::string&, std::stringstream&, std::ifstream&, std::vector<Label>&, int&);
-int equCommand (std::stringstream&, std::vector<Label>&, std::string&, int&);
-int ifCommand (std::stringstream&, std::ifstream&, int&, int&);
-void preParser (std::string&, std::ifstream&, std::vector<Label>&, int&, std::vector<Instr>&, std::vector<Dir>&, std::vector<Error>&);
-int preProcessFile (std::string, std::string, std::vector<int>&, std::vector<Instr>&, std::vector<Dir>&, std::vector<Error>&);
+Token makeToken (std::string_view, int, Interner&);
+void preReadLine (std::string&, std::vector<Token>&, SourceFile&, EquTable&);
+void appendNextLine (std::string&, std::vector<Token>&, TokenStream&, SourceFile&, EquTable&, int&);
+int equCommand (TokenStream&, EquTable&, std::string_view, int&);
+int ifCommand (TokenStream&, SourceFile&, int&, int&);
+int preParser (std::string&, std::vector<Token>&, SourceFile&, EquTable&, int&, Tables&, std::vector<Error>&);
+int preNextLine (PreState&, std::string&, Tables&, std::vector<Error>&);
+int preProcessFile (PreState&, Tables&, std::vector<Error>&);
 
 
 
 /*      DEFINIÇÕES DAS FUNÇÕES      */
 
 /*
-preReadLine: le uma linha do arquivo na etapa de preprocessamento e passa tudo para caixa alta, ignora comentários e ignora espaços em branco no começo e no final da linha. depois, procura por rotulos numa linha e substitui pela definicao se encontrar
-entrada: stream do arquivo de entrada e lista de rotulos definidos
-saida: nenhuma (string com a linha lida e alterada dada por referência)
+makeToken: classifica um token da linha normalizada e guarda o nome dele na tabela de nomes
+entrada: texto do token, posicao dele na linha e nomes dos simbolos
+saida: token
 */
-void preReadLine (std::string &line, std::ifstream &asmFile, std::vector<Label> &labelList)  {
+Token makeToken (std::string_view text, int column, Interner &symbols) {
+    
+    // o ':' de uma definicao de rotulo e a ',' depois de um operando nao fazem parte do nome
+    int kind = TOKEN_WORD;
+    std::string_view name = text;
+    if (!name.empty() && name.back() == ':') {
+        kind = TOKEN_LABEL;
+        name.remove_suffix(1);
+    } else if (!name.empty() && name.back() == ',') {
+        kind = TOKEN_COMMA;
+        name.remove_suffix(1);
+    }
     
-    // le uma linha do arquivo
-    getline(asmFile, line);
+    return Token (kind, symbols.intern(name), column, text.size());
+
+}
+
+
+
+/*
+preReadLine: le uma linha do arquivo na etapa de preprocessamento e passa tudo para caixa alta, ignora comentários e ignora espaços em branco no começo e no final da linha. cada token que for um rotulo definido por EQU eh substituido pela definicao enquanto a linha eh montada
+a linha eh lida direto do arquivo mapeado; a unica copia feita eh a da propria linha de saida, e os tokens dela saem prontos para as outras passagens
+entrada: arquivo de entrada mapeado e tabela de EQUs
+saida: nenhuma (string com a linha lida e alterada e os tokens dela dados por referência)
+*/
+void preReadLine (std::string &line, std::vector<Token> &tokens, SourceFile &asmFile, EquTable &equTable)  {
     
-    // transforma a string p caixa alta
-    std::transform (line.begin(), line.end(), line.begin(), ::toupper);
+    // le uma linha do arquivo
+    std::string_view rawLine;
+    asmFile.getLine(rawLine);
     
     // ignora os comentarios, se houver algum
-    std::stringstream lineStream (line);
-    getline(lineStream, line, ';');
-    
-    // retira os espaços em branco entre os tokens
-    lineStream.str(line);
-    lineStream.clear();
-    std::vector<std::string> tokenList;
-    while (!lineStream.eof()) {
-        std::string tempToken;
-        lineStream >> tempToken;
-        tokenList.push_back(tempToken);
-    }
-    line.clear();
-    for (unsigned int i = 0; i < tokenList.size(); ++i) {
-        line = line + tokenList[i] + ' ';
-        if (i == tokenList.size()-1)
-            line.pop_back();
-    }
-    
-    // retira os espaços em branco, caso existam, no final da linha
-    while (line.back() == ' ' || line.back() == '\t' || line.back() == '\n' || line.back() == '\v' || line.back() == '\f' || line.back() == '\r')
-        line.pop_back();
+    std::size_t comment = rawLine.find(';');
+    if (comment != std::string_view::npos)
+        rawLine = rawLine.substr(0, comment);
     
-    // retira os espaços em branco, caso existam, no começo da linha
-    while (line.front() == ' ' || line.front() == '\t' || line.front() == '\n' || line.front() == '\v' || line.front() == '\f' || line.front() == '\r')
-        line = line.substr(1);
-    
-    // itera na lista de rotulos definidos procurando por um desses rotulos na linha
-    for (unsigned int i = 0; i < labelList.size(); ++i) {
-        
-        // tamanho do nome do rótulo
-        int nameSize = labelList[i].name.size();
-        
-        // procura só a partir desta posição
-        std::size_t minPos = 0;
+    // junta os tokens separados por um espaço so (o que tambem retira os espaços do começo e do final da linha)
+    line.clear();
+    tokens.clear();
+    LineTokens lineStream (rawLine);
+    std::string upper; // token em caixa alta
+    std::string_view token;
+    while (!lineStream.rest.empty()) {
+        token = std::string_view();
+        lineStream >> token;
+        if (token.empty())
+            break;
         
-        // procura pelo nome do rotulo na linha
-        std::size_t pos = line.find(labelList[i].name, minPos);
+        // passa o token para caixa alta
+        upper.assign(token);
+        for (std::size_t i = 0; i < upper.size(); ++i) {
+            if (upper[i] >= 'a' && upper[i] <= 'z')
+                upper[i] = upper[i] - 'a' + 'A';
+        }
         
-        while (pos != std::string::npos) {
-            
-            // se encontrar em alguma posicao, substitui pelo texto associado ao rotulo
-            // verifica se o nome encontrado é um token individual
-            if (pos == 0) {
-                if (line[pos+nameSize] == ':' || line[pos+nameSize] == ' ' || pos+nameSize >= line.size())
-                    line.replace (pos, nameSize, labelList[i].equ);
-            } else {
-                if (line[pos-1] == ' ' && (line[pos+nameSize] == ' ' || pos+nameSize >= line.size()))
-                    line.replace (pos, nameSize, labelList[i].equ);
+        // procura o token na tabela de EQUs (o nome de um token sem ':' ou ',' no final eh o proprio token, entao a busca usa o identificador dele).
+        // no primeiro token, o rotulo tambem pode vir antes de um ':' (definicao de rotulo)
+        std::string_view name (upper), suffix;
+        Token lexed = makeToken(name, 0, *equTable.symbols);
+        const std::string_view *equ = (lexed.kind == TOKEN_WORD) ? equTable.find(lexed.id) : equTable.find(name);
+        if (!equ && line.empty()) {
+            for (std::size_t colon = name.find(':'); colon != std::string_view::npos && !equ; colon = name.find(':', colon+1)) {
+                equ = equTable.find(name.substr(0, colon));
+                if (equ)
+                    suffix = name.substr(colon);
             }
-            
-            // atualiza a posição mínima da busca
-            minPos = pos+1;
-            
-            // procura de novo
-            pos = line.find(labelList[i].name, minPos);
-            
         }
-            
+        
+        if (!line.empty())
+            line.push_back(' ');
+        lexed.column = line.size();
+        if (equ) {
+            line.append(*equ);
+            line.append(suffix);
+            lexed = makeToken(std::string_view(line).substr(lexed.column), lexed.column, *equTable.symbols);
+        } else
+            line.append(upper);
+        tokens.push_back(lexed);
     }
     
 }
@@ -95,22 +129,30 @@ void preReadLine (std::string &line, std::ifstream &asmFile, std::vector<Label>
 
 /*
 appendNextLine: le a proxima linha, anexa na atual e retorna a linha composta
-entrada: a linha atual, a stream da linha atual, a stream do arquivo e a lista de rotulos
-saida: nenhuma (linha e stream da linha alteradas por referencia)
+entrada: a linha atual, os tokens da linha atual e a leitura deles, o arquivo de entrada e a tabela de EQUs
+saida: nenhuma (linha, tokens e leitura dos tokens alterados por referencia)
 */
-void appendNextLine (std::string &line, std::stringstream &lineStream, std::ifstream &asmFile, std::vector<Label> &labelList, int &lineCounter) {
+void appendNextLine (std::string &line, std::vector<Token> &tokens, TokenStream &lineStream, SourceFile &asmFile, EquTable &equTable, int &lineCounter) {
     
     // le e anexa à linha atual a proxima linha
     std::string nextLine;
+    std::vector<Token> nextTokens;
     while (nextLine.size() == 0 && !asmFile.eof()) {
-        preReadLine (nextLine, asmFile, labelList);
+        preReadLine (nextLine, nextTokens, asmFile, equTable);
         lineCounter++;
     }
+    int shift = line.size() + 1;
     line = line + " " + nextLine;
     
-    // e corrige a stream da linha
-    lineStream.str(nextLine); // salva a linha anexada como stream
-    lineStream.clear(); // limpa as flags de estado
+    // os tokens da parte anexada vao para o final, com as posicoes na linha composta
+    int first = tokens.size();
+    for (unsigned int i = 0; i < nextTokens.size(); ++i) {
+        nextTokens[i].column += shift;
+        tokens.push_back(nextTokens[i]);
+    }
+    
+    // e passa a ler os tokens da parte anexada
+    lineStream = TokenStream (TokenLine (line, tokens.data(), tokens.size()), first);
     
 }
 
@@ -121,10 +163,10 @@ equCommand: associa um valor ao rotulo
 entrada: linha atual, stream da linha atual, lista de rotulos e nome do rotulo
 saida: inteiro indicando se houve erro (lista de rotulos alterada por referencia)
 */
-int equCommand (std::stringstream &lineStream, std::vector<Label> &labelList, std::string &token, int &pos) {
+int equCommand (TokenStream &lineStream, EquTable &equTable, std::string_view token, int &pos) {
     
     // le o texto a ser substituido
-    std::string equ;
+    std::string_view equ;
     lineStream >> equ;
     
     if (equ.empty()) // se nao foram passados argumentos
@@ -132,11 +174,10 @@ int equCommand (std::stringstream &lineStream, std::vector<Label> &labelList, st
         
     pos = equ.size()+1;
     
-    Label label (token, equ); // cria o rotulo com o valor associado
-    labelList.push_back(label); // coloca o rotulo na lista de rotulos definidos
+    equTable.define(token, equ); // associa o valor ao rotulo na tabela de EQUs
     
     // le um proximo token
-    std::string token2;
+    std::string_view token2;
     lineStream >> token2;
     
     if (!token2.empty()) // se nao estiver vazio, deu mais argumentos que o necessario
@@ -152,13 +193,13 @@ int equCommand (std::stringstream &lineStream, std::vector<Label> &labelList, st
 
 /*
 ifCommand: se o valor do if for 1, compila a linha abaixo, senao esvazia a linha
-entrada: linha atual, stream da linha atual, stream do arquivo de entrada e contador de linhas
+entrada: tokens da linha atual, arquivo de entrada e contador de linhas
 saida: retorna se o numero lido eh inteiro (linha e contador de linhas alterados por referencia)
 */
-int ifCommand (std::stringstream &lineStream, std::ifstream &asmFile, int &lineCounter, int &pos) {
+int ifCommand (TokenStream &lineStream, SourceFile &asmFile, int &lineCounter, int &pos) {
     
     // le o numero seguinte (a busca ja trocou o rotulo por um valor)
-    std::string value;
+    std::string_view value;
     lineStream >> value;
     
     if (value.empty())
@@ -176,14 +217,14 @@ int ifCommand (std::stringstream &lineStream, std::ifstream &asmFile, int &lineC
     // se conseguiu, executa a diretiva
     else {
         if (conv != 1) {
-            std::string line;
-            getline (asmFile, line); // le a proxima linha do arquivo (que vai ser descartada)
+            std::string_view line;
+            asmFile.getLine(line); // le a proxima linha do arquivo (que vai ser descartada)
             lineCounter++; // pula uma linha
         }
     }
     
     // le mais um token
-    std::string token2;
+    std::string_view token2;
     lineStream >> token2;
     
     // se nao estiver vazio, avisa que foram dados mais argumentos que o necessário
@@ -198,31 +239,33 @@ int ifCommand (std::stringstream &lineStream, std::ifstream &asmFile, int &lineC
 
 /*
 preParser: processa uma linha do arquivo fonte
-entrada: linha atual, stream do arquivo de entrada, a lista de rotulos e o contador de linhas
-saida: nenhuma (linha lida e contador de linhas alterados por referência)
+entrada: linha atual e tokens dela, arquivo de entrada, a lista de rotulos e o contador de linhas
+saida: 1 se a linha era uma diretiva do preprocessamento (EQU ou IF), 0 se nao (linha lida, tokens dela e contador de linhas alterados por referência)
 */
-void preParser (std::string &line, std::ifstream &asmFile, std::vector<Label> &labelList, int &lineCounter, std::vector<Instr> &instrList, std::vector<Dir> &dirList, std::vector<Error> &errorList) {
+int preParser (std::string &line, std::vector<Token> &tokens, SourceFile &asmFile, EquTable &equTable, int &lineCounter, Tables &tables, std::vector<Error> &errorList) {
     
-    // le uma linha, corrige algumas coisas e procura na linha por rotulos que ja tenham sido definidos por equs
-    preReadLine (line, asmFile, labelList);
+    // le uma linha, corrige algumas coisas e procura na linha por rotulos que ja tenham sido definidos por equs (e ja separa os tokens)
+    preReadLine (line, tokens, asmFile, equTable);
     
-    // cria um stream para a leitura de tokens
-    std::stringstream lineStream (line);
+    // le os tokens da linha
+    TokenStream lineStream (TokenLine (line, tokens.data(), tokens.size()));
     
     // le um token da linha
-    std::string token;
+    std::string_view token;
     lineStream >> token;
     
     // se o ultimo caracter for ':', entao ta definindo um rotulo
-    if (token.back() == ':') {
+    if (!token.empty() && token.back() == ':') {
         
         // pega o token seguinte
-        std::string token2;
+        std::string_view token2;
         lineStream >> token2;
         
-        // se token2 estiver vazio, anexa a proxima linha
+        // se token2 estiver vazio, anexa a proxima linha (o rotulo continua no começo da linha composta)
         if (token2.empty()) {
-            appendNextLine (line, lineStream, asmFile, labelList, lineCounter);
+            std::size_t tokenSize = token.size();
+            appendNextLine (line, tokens, lineStream, asmFile, equTable, lineCounter);
+            token = std::string_view(line).substr(0, tokenSize);
             lineStream >> token2; // pega o token correto
         }
         
@@ -230,9 +273,9 @@ void preParser (std::string &line, std::ifstream &asmFile, std::vector<Label> &l
         if (token2 == "EQU") {
             
             // verifica se o rótulo é válido
-            token.pop_back();
+            token.remove_suffix(1);
             int pos = 0;
-            int valid = labelCheck(token, instrList, dirList, pos);
+            int valid = labelCheck(token, tables, pos);
             if (valid == -1)
                 errorList.push_back(Error("tamanho do rótulo deve ser menor ou igual a 100 caracteres", "léxico", lineCounter, line, pos));
             else if (valid == -2)
@@ -246,7 +289,7 @@ void preParser (std::string &line, std::ifstream &asmFile, std::vector<Label> &l
             
             // executa o comando da diretiva
             pos = 0;
-            int status = equCommand (lineStream, labelList, token, pos);
+            int status = equCommand (lineStream, equTable, token, pos);
             pos += token.size()+1 + token2.size()+1 + 1;
             if (status == -1)
                 errorList.push_back(Error("definição de EQU vazia", "sintático", lineCounter, line, pos));
@@ -255,6 +298,8 @@ void preParser (std::string &line, std::ifstream &asmFile, std::vector<Label> &l
             
             // esvazia a string p nao salvar a linha no codigo
             line.clear();
+            tokens.clear();
+            return 1;
                 
         }
             
@@ -277,47 +322,88 @@ void preParser (std::string &line, std::ifstream &asmFile, std::vector<Label> &l
             
         // esvazia a string p nao salvar a linha no codigo
         line.clear();
+        tokens.clear();
+        return 1;
     }
+    
+    return 0;
         
 }
 
 
 
 /*
-preProcessFile: faz a passagem de preprocessamento no arquivo, que inclui:
-    - passa tudo para caixa alta
-    - ignora comentarios
-    - avalia EQU e IF
-    - (detectar erros)
-entrada: nome do arquivo de entrada '.asm', nome do arquivo de saida '.pre' e dicionario de linhas
-saida: inteiro indicando se houve erros
+preNextLine: processa o arquivo de entrada ate produzir a proxima linha nao vazia, que eh entregue para a passagem seguinte (e copiada no '.pre', se pedido)
+entrada: estado do preprocessamento, tabelas e lista de erros
+saida: 1 se uma linha foi produzida, 0 se o arquivo acabou (linha dada por referencia)
 */
-int preProcessFile (std::string inFileName, std::string preFileName, std::vector<int> &lineDict, std::vector<Instr> &instrList, std::vector<Dir> &dirList, std::vector<Error> &errorList) {
+int preNextLine (PreState &pre, std::string &line, Tables &tables, std::vector<Error> &errorList) {
     
-    std::ifstream asmFile (inFileName);
-    std::ofstream preFile (preFileName);
+    // o tempo ate a linha sair eh do preprocessamento (e volta a ser de quem pediu a linha)
+    int caller = pre.stats ? pre.stats->enter(STATS_PRE) : -1;
     
-    std::vector<Label> labelList;
-    
-    int lineCounter = 1;
-
-    while (!asmFile.eof()) {
+    while (!pre.asmFile.eof()) {
         
-        // chama o parser especifico do preprocessamento        
-        std::string line;
-        preParser(line, asmFile, labelList, lineCounter, instrList, dirList, errorList);
-            
-        // se a linha nao retornar vazia, copia no arquivo '.pre'        
-        if (!line.empty()) {
-            preFile << line << "\n";
-            lineDict.push_back(lineCounter);
+        // no limite de erros, as passagens seguintes veem o arquivo como se ele tivesse acabado
+        if (pre.maxErrors > 0 && (int) errorList.size() >= pre.maxErrors) {
+            pre.stopped = 1;
+            break;
         }
         
-        lineCounter++;
+        // chama o parser especifico do preprocessamento
+        line.clear();
+        int firstLine = pre.lineCounter;
+        int numErrors = errorList.size();
+        int numEqus = pre.equTable.size();
+        int directive = preParser(line, pre.tokens, pre.asmFile, pre.equTable, pre.lineCounter, tables, errorList);
+        
+        // se a linha nao retornar vazia, ela eh a proxima linha da saida
+        int produced = !line.empty();
+        if (produced) {
+            if (pre.preFile)
+                *pre.preFile << line << "\n";
+            pre.lineDict.push_back(pre.lineCounter);
+        }
+        
+        // registra as linhas lidas (a montagem incremental so reaproveita linhas que nao dependem das vizinhas)
+        if (pre.trace) {
+            pre.trace->preGroup(firstLine, pre.lineCounter, numErrors, produced, directive || (int) errorList.size() != numErrors);
+            if (pre.equTable.size() != numEqus) {
+                pre.trace->equLines.push_back(pre.lineCounter);
+                pre.trace->equIds.push_back(pre.equTable.last);
+            }
+        }
+        
+        pre.lineCounter++;
+        
+        if (produced) {
+            if (pre.stats)
+                pre.stats->enter(caller);
+            return 1;
+        }
     }
     
-    asmFile.close();
-    preFile.close();
+    if (pre.stats)
+        pre.stats->enter(caller);
+    return 0;
+}
+
+
+
+/*
+preProcessFile: faz a passagem de preprocessamento no arquivo inteiro (operacao -p), que inclui:
+    - passa tudo para caixa alta
+    - ignora comentarios
+    - avalia EQU e IF
+    - (detectar erros)
+entrada: estado do preprocessamento (com o arquivo '.asm' aberto e o '.pre' de saida), tabelas e lista de erros
+saida: inteiro indicando se houve erros
+*/
+int preProcessFile (PreState &pre, Tables &tables, std::vector<Error> &errorList) {
+    
+    // consome todas as linhas (que vao sendo copiadas no arquivo '.pre')
+    std::string line;
+    while (preNextLine(pre, line, tables, errorList));
     
     // futuramente, indicara erros no valor de retorno
     return 0;
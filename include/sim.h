@@ -0,0 +1,397 @@
+/*      SIM.H: simulador dos arquivos objeto gerados pela montagem (texto ou binário)        */
+
+
+
+/*      DEFINIÇÕES DAS INSTRUÇÕES       */
+
+// tipos de instrucao do simulador. a semantica vem do nome da instrucao na tabela, entao uma tabela com outros opcodes tambem funciona
+const int SIM_DECODE = 0; // endereco ainda nao decodificado (ou alterado por uma escrita na memoria)
+const int SIM_ADD = 1;
+const int SIM_SUB = 2;
+const int SIM_MULT = 3;
+const int SIM_DIV = 4;
+const int SIM_JMP = 5;
+const int SIM_JMPN = 6;
+const int SIM_JMPP = 7;
+const int SIM_JMPZ = 8;
+const int SIM_COPY = 9;
+const int SIM_LOAD = 10;
+const int SIM_STORE = 11;
+const int SIM_INPUT = 12;
+const int SIM_OUTPUT = 13;
+const int SIM_STOP = 14;
+const int SIM_FAULT = 15; // instrucao que nao pode ser executada (o motivo fica no operando 'a')
+const int SIM_NUM_KINDS = 16;
+
+// nomes e numero de operandos de cada tipo (na ordem das constantes acima)
+const char *const SIM_NAMES[SIM_NUM_KINDS] = {"", "ADD", "SUB", "MULT", "DIV", "JMP", "JMPN", "JMPP", "JMPZ", "COPY", "LOAD", "STORE", "INPUT", "OUTPUT", "STOP", ""};
+const int SIM_NUM_ARGS[SIM_NUM_KINDS] = {0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 0, 0};
+
+// erros de execucao
+const int SIM_OK = 0;
+const int SIM_BAD_OPCODE = 1;
+const int SIM_BAD_SIZE = 2;
+const int SIM_BAD_ADDRESS = 3;
+const int SIM_DIV_ZERO = 4;
+const int SIM_BAD_INPUT = 5;
+const int SIM_END_OF_MEMORY = 6;
+const char *const SIM_ERRORS[] = {"", "opcode inválido", "instrução passa do final da memória", "endereço fora da memória",
+    "divisão por zero", "entrada inválida ou final da entrada", "execução passou do final da memória"};
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// SimOp: instrucao ja decodificada, guardada no endereco onde ela comeca
+struct SimOp {
+    // membros
+    int kind; // SIM_*
+    int a, b; // operandos (enderecos ja conferidos)
+    int next; // endereco da instrucao seguinte
+    // metodos
+    SimOp (): kind(SIM_DECODE), a(0), b(0), next(0) {};
+};
+
+
+
+// SimInput: leitura bufferizada dos inteiros da entrada padrao para a instrucao INPUT
+struct SimInput {
+    // membros
+    int fd; // entrada
+    std::vector<char> buffer; // bytes lidos e ainda nao consumidos estao em [begin, end)
+    std::size_t begin, end;
+    int eofFlag; // se a entrada acabou
+    // metodos
+    SimInput (int f): fd(f), buffer(1 << 16), begin(0), end(0), eofFlag(0) {};
+    // proximo caractere sem consumir (-1 no final da entrada)
+    int peek () {
+        if (begin == end) {
+            if (eofFlag)
+                return -1;
+            ssize_t n;
+            do
+                n = ::read(fd, buffer.data(), buffer.size());
+            while (n < 0 && errno == EINTR);
+            if (n <= 0) {
+                eofFlag = 1;
+                return -1;
+            }
+            begin = 0;
+            end = n;
+        }
+        return (unsigned char) buffer[begin];
+    };
+    // se ja tem bytes lidos (senao a proxima leitura pode esperar pelo usuario)
+    bool ready () const { return begin < end; };
+    // le um inteiro em decimal, depois de espacos em branco. retorna 0 se a entrada acabou ou nao tem um numero
+    int getInt (int &value) {
+        int c;
+        while ((c = peek()) >= 0 && LineTokens::isBlank(c))
+            begin++;
+        long long number = 0;
+        int negative = 0, digits = 0;
+        if (c == '-' || c == '+') {
+            negative = (c == '-');
+            begin++;
+        }
+        while ((c = peek()) >= '0' && c <= '9') {
+            if (number < (1LL << 32))
+                number = number*10 + (c - '0');
+            digits++;
+            begin++;
+        }
+        value = (int) (std::uint32_t) (negative ? -number : number);
+        return digits > 0;
+    };
+};
+
+
+
+// SimMachine: programa carregado e estado da execucao
+struct SimMachine {
+    // membros
+    std::vector<int> memory; // imagem do programa (codigo e dados)
+    std::vector<SimOp> ops; // endereco -> instrucao decodificada que comeca nele (com uma posicao a mais no final)
+    std::vector<int> opKind; // opcode -> SIM_* (SIM_FAULT se nao estiver na tabela)
+    std::vector<int> opArgs; // opcode -> numero de operandos na tabela
+    int pc; // endereco da proxima instrucao
+    int acc; // acumulador
+    int error; // SIM_OK ou o erro que parou a execucao
+    std::uint64_t counts[SIM_NUM_KINDS]; // instrucoes executadas de cada tipo
+    // metodos
+    SimMachine (): pc(0), acc(0), error(SIM_OK) { memset(counts, 0, sizeof(counts)); };
+    // decodifica a instrucao que comeca no endereco (ja dentro da memoria), sem guardar
+    SimOp decoded (int address) const {
+        SimOp op;
+        int size = memory.size(), opcode = memory[address];
+        op.kind = (opcode >= 0 && opcode < (int) opKind.size()) ? opKind[opcode] : SIM_FAULT;
+        op.a = SIM_BAD_OPCODE;
+        op.b = 0;
+        op.next = address + 1;
+        if (op.kind == SIM_FAULT)
+            return op;
+        int numArgs = opArgs[opcode];
+        if (address + 1 + numArgs > size) {
+            op.kind = SIM_FAULT;
+            op.a = SIM_BAD_SIZE;
+            return op;
+        }
+        op.a = (numArgs > 0) ? memory[address+1] : 0;
+        op.b = (numArgs > 1) ? memory[address+2] : 0;
+        op.next = address + 1 + numArgs;
+        // todo operando eh um endereco (de dado ou de desvio)
+        if ((numArgs > 0 && (op.a < 0 || op.a >= size)) || (numArgs > 1 && (op.b < 0 || op.b >= size))) {
+            op.kind = SIM_FAULT;
+            op.a = SIM_BAD_ADDRESS;
+        }
+        return op;
+    };
+    void decode (int address) { ops[address] = decoded(address); };
+    // uma escrita no endereco desfaz as instrucoes decodificadas que podem ter uma palavra nele (codigo que se modifica)
+    void written (int address) {
+        ops[address].kind = SIM_DECODE;
+        if (address >= 1)
+            ops[address-1].kind = SIM_DECODE;
+        if (address >= 2)
+            ops[address-2].kind = SIM_DECODE;
+    };
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+int simLoad (SimMachine&, std::string, Tables&);
+int simRun (SimMachine&, SimInput&, OutputBuffer&);
+void simReport (SimMachine&, double, std::ostream&);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+simLoad: carrega um arquivo objeto no simulador. o formato binario eh reconhecido pelo magico (e comeca no ponto de entrada);
+o de texto (numeros separados por espaco) comeca no endereco 0
+entrada: maquina, nome do arquivo '.o' e tabelas (para saber o que cada opcode faz)
+saida: 1 se carregou, 0 se o arquivo nao existe ou nao eh um '.o' valido
+*/
+int simLoad (SimMachine &machine, std::string objFileName, Tables &tables) {
+    
+    ObjFile objFile;
+    if (objFile.open(objFileName)) {
+        machine.memory.resize(objFile.numWords());
+        for (int i = 0; i < objFile.numWords(); ++i)
+            machine.memory[i] = objFile.word(i);
+        machine.pc = objFile.entry;
+    } else {
+        SourceFile textFile;
+        if (!textFile.open(objFileName))
+            return 0;
+        std::string_view line, token;
+        while (!textFile.eof()) {
+            textFile.getLine(line);
+            LineTokens tokens (line);
+            while (1) {
+                token = std::string_view();
+                tokens >> token;
+                if (token.empty())
+                    break;
+                int value;
+                if (std::from_chars(token.data(), token.data() + token.size(), value).ptr != token.data() + token.size())
+                    return 0;
+                machine.memory.push_back(value);
+            }
+        }
+        machine.pc = 0;
+    }
+    
+    // o que cada opcode faz, pelo nome da instrucao
+    for (unsigned int i = 0; i < tables.instrList.size(); ++i) {
+        Instr &instr = tables.instrList[i];
+        if (instr.opcode < 0 || instr.opcode > 0xFFFF)
+            continue;
+        if (instr.opcode >= (int) machine.opKind.size()) {
+            machine.opKind.resize(instr.opcode+1, SIM_FAULT);
+            machine.opArgs.resize(instr.opcode+1, 0);
+        }
+        machine.opKind[instr.opcode] = SIM_FAULT;
+        for (int kind = SIM_ADD; kind <= SIM_STOP; ++kind) {
+            if (instr.name == SIM_NAMES[kind] && instr.numArg == SIM_NUM_ARGS[kind])
+                machine.opKind[instr.opcode] = kind;
+        }
+        machine.opArgs[instr.opcode] = instr.numArg;
+    }
+    
+    machine.ops.assign(machine.memory.size()+1, SimOp());
+    return 1;
+}
+
+
+
+/*
+simRun: executa o programa a partir de machine.pc ate o STOP ou um erro. as instrucoes sao decodificadas na primeira vez que sao
+executadas (e de novo se alguma escrita mexer nelas), e o laco pula direto para o codigo de cada tipo (goto computado no gcc e no clang,
+switch nos outros compiladores)
+entrada: maquina carregada, entrada dos INPUT e saida dos OUTPUT
+saida: SIM_OK se parou no STOP, senao o erro (o endereco da instrucao que falhou fica em machine.pc)
+*/
+int simRun (SimMachine &machine, SimInput &in, OutputBuffer &out) {
+    
+    SimOp *ops = machine.ops.data();
+    int *memory = machine.memory.data();
+    std::uint64_t *counts = machine.counts;
+    int pc = machine.pc, acc = machine.acc, size = machine.memory.size(), error = SIM_OK;
+    
+    // a posicao depois do final da memoria so eh alcancada passando do final
+    ops[size].kind = SIM_FAULT;
+    ops[size].a = SIM_END_OF_MEMORY;
+    if (pc < 0 || pc > size)
+        pc = size;
+
+#if defined(__GNUC__)
+    static const void *labels[SIM_NUM_KINDS] = {&&SIM_DECODE, &&SIM_ADD, &&SIM_SUB, &&SIM_MULT, &&SIM_DIV, &&SIM_JMP, &&SIM_JMPN, &&SIM_JMPP,
+        &&SIM_JMPZ, &&SIM_COPY, &&SIM_LOAD, &&SIM_STORE, &&SIM_INPUT, &&SIM_OUTPUT, &&SIM_STOP, &&SIM_FAULT};
+#define SIM_CASE(kind) kind:
+#define SIM_NEXT() goto *labels[ops[pc].kind]
+    SIM_NEXT();
+    {
+#else
+#define SIM_CASE(kind) case kind:
+#define SIM_NEXT() continue
+    while (1) switch (ops[pc].kind) {
+#endif
+    
+    SIM_CASE(SIM_DECODE)
+        machine.decode(pc);
+        SIM_NEXT();
+    
+    // a aritmetica da volta nos 32 bits, como numa maquina de verdade
+    SIM_CASE(SIM_ADD)
+        counts[SIM_ADD]++;
+        acc = (int) ((std::uint32_t) acc + (std::uint32_t) memory[ops[pc].a]);
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_SUB)
+        counts[SIM_SUB]++;
+        acc = (int) ((std::uint32_t) acc - (std::uint32_t) memory[ops[pc].a]);
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_MULT)
+        counts[SIM_MULT]++;
+        acc = (int) ((std::uint32_t) acc * (std::uint32_t) memory[ops[pc].a]);
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_DIV)
+        counts[SIM_DIV]++;
+        if (memory[ops[pc].a] == 0) {
+            error = SIM_DIV_ZERO;
+            goto done;
+        }
+        acc = (memory[ops[pc].a] == -1) ? (int) (0 - (std::uint32_t) acc) : acc / memory[ops[pc].a];
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_JMP)
+        counts[SIM_JMP]++;
+        pc = ops[pc].a;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_JMPN)
+        counts[SIM_JMPN]++;
+        pc = (acc < 0) ? ops[pc].a : ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_JMPP)
+        counts[SIM_JMPP]++;
+        pc = (acc > 0) ? ops[pc].a : ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_JMPZ)
+        counts[SIM_JMPZ]++;
+        pc = (acc == 0) ? ops[pc].a : ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_COPY)
+        counts[SIM_COPY]++;
+        memory[ops[pc].b] = memory[ops[pc].a];
+        machine.written(ops[pc].b);
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_LOAD)
+        counts[SIM_LOAD]++;
+        acc = memory[ops[pc].a];
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_STORE)
+        counts[SIM_STORE]++;
+        memory[ops[pc].a] = acc;
+        machine.written(ops[pc].a);
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    // antes de esperar pela entrada, mostra o que ja foi escrito
+    SIM_CASE(SIM_INPUT)
+        counts[SIM_INPUT]++;
+        if (!in.ready())
+            out.flush();
+        if (!in.getInt(memory[ops[pc].a])) {
+            error = SIM_BAD_INPUT;
+            goto done;
+        }
+        machine.written(ops[pc].a);
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_OUTPUT)
+        counts[SIM_OUTPUT]++;
+        out.putInt(memory[ops[pc].a]);
+        out.putChar('\n');
+        pc = ops[pc].next;
+        SIM_NEXT();
+    
+    SIM_CASE(SIM_STOP)
+        counts[SIM_STOP]++;
+        goto done;
+    
+    SIM_CASE(SIM_FAULT)
+        error = ops[pc].a;
+        goto done;
+    
+    }
+#undef SIM_CASE
+#undef SIM_NEXT
+
+done:
+    machine.pc = pc;
+    machine.acc = acc;
+    machine.error = error;
+    return error;
+}
+
+
+
+/*
+simReport: mostra quantas instrucoes foram executadas (no total, por segundo e de cada tipo)
+entrada: maquina depois da execucao, tempo da execucao em segundos e stream de saida
+saida: nenhuma
+*/
+void simReport (SimMachine &machine, double seconds, std::ostream &out) {
+    
+    std::uint64_t total = 0;
+    for (int kind = 0; kind < SIM_NUM_KINDS; ++kind)
+        total += machine.counts[kind];
+    
+    out << "instruções executadas: " << total << " em " << seconds << " s";
+    if (seconds > 0)
+        out << " (" << total / seconds / 1e6 << " milhões por segundo)";
+    out << "\n";
+    for (int kind = SIM_ADD; kind <= SIM_STOP; ++kind) {
+        if (machine.counts[kind] > 0)
+            out << "    " << SIM_NAMES[kind] << ": " << machine.counts[kind] << "\n";
+    }
+
+}
@@ -0,0 +1,136 @@
+/*      SRC.H: leitura do arquivo fonte mapeado em memória e separação de tokens sem cópias        */
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// SourceFile: arquivo de entrada mapeado em memoria (mmap). as linhas sao entregues como views do mapeamento, sem copias
+struct SourceFile {
+    // membros
+    const char *data; // inicio do arquivo mapeado
+    std::size_t size; // tamanho do arquivo
+    std::size_t next; // posicao do inicio da proxima linha
+    int eofFlag; // se a leitura ja chegou no final do arquivo (mesmo significado de eof() num ifstream)
+    // metodos
+    SourceFile (): data(nullptr), size(0), next(0), eofFlag(0) {};
+    SourceFile (const SourceFile&) = delete;
+    SourceFile& operator= (const SourceFile&) = delete;
+    ~SourceFile () { close(); };
+    // mapeia o arquivo. retorna 1 se conseguiu, 0 se nao
+    int open (const std::string &fileName) {
+        close();
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return 0;
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            ::close(fd);
+            return 0;
+        }
+        size = info.st_size;
+        // um arquivo vazio nao pode ser mapeado, mas tambem nao tem nada para ler
+        if (size > 0) {
+            void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                ::close(fd);
+                size = 0;
+                return 0;
+            }
+            madvise(map, size, MADV_SEQUENTIAL);
+            data = (const char*) map;
+        }
+        ::close(fd);
+        next = 0;
+        eofFlag = 0;
+        return 1;
+    };
+    // desfaz o mapeamento
+    void close () {
+        if (data)
+            munmap((void*) data, size);
+        data = nullptr;
+        size = 0;
+        next = 0;
+        eofFlag = 0;
+    };
+    // le a proxima linha, sem o '\n'. funciona como o getline: chegar no final do arquivo marca eof
+    void getLine (std::string_view &line) {
+        if (next >= size) {
+            line = std::string_view();
+            eofFlag = 1;
+            return;
+        }
+        const char *begin = data + next;
+        const char *end = (const char*) memchr(begin, '\n', size - next);
+        if (end) {
+            line = std::string_view(begin, end - begin);
+            next += (end - begin) + 1;
+        } else {
+            line = std::string_view(begin, size - next);
+            next = size;
+            eofFlag = 1;
+        }
+    };
+    bool eof () const { return eofFlag; };
+};
+
+
+
+// LineTokens: separa os tokens (delimitados por espacos em branco) de uma linha, como o '>>' de uma stringstream, mas devolvendo views da linha
+struct LineTokens {
+    // membros
+    std::string_view rest; // parte da linha que ainda nao foi lida
+    // metodos
+    LineTokens () {};
+    LineTokens (std::string_view ln): rest(ln) {};
+    // troca a linha sendo lida
+    void str (std::string_view ln) { rest = ln; };
+    // le o proximo token. se nao houver mais tokens, o token nao eh alterado (como acontece com uma stream)
+    LineTokens& operator>> (std::string_view &token) {
+        std::size_t i = 0;
+        while (i < rest.size() && isBlank(rest[i]))
+            ++i;
+        if (i == rest.size()) {
+            rest = std::string_view();
+            return *this;
+        }
+        std::size_t j = i;
+        while (j < rest.size() && !isBlank(rest[j]))
+            ++j;
+        token = rest.substr(i, j-i);
+        rest.remove_prefix(j);
+        return *this;
+    };
+    // mesmos caracteres de espaco em branco que o '>>' considera
+    static bool isBlank (char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; };
+};
+
+
+
+// TokenStream: le os tokens de uma linha ja separada (TokenLine), com o mesmo comportamento do '>>' da LineTokens, sem percorrer o texto de novo
+struct TokenStream {
+    // membros
+    TokenLine line; // linha sendo lida
+    int next; // proximo token a ser lido
+    int last; // ultimo token lido (-1 se nenhum)
+    // metodos
+    TokenStream (): next(0), last(-1) {};
+    TokenStream (const TokenLine &ln, int nx=0): line(ln), next(nx), last(nx-1) {};
+    // le o proximo token. se nao houver mais tokens, o token nao eh alterado (como acontece com uma stream)
+    TokenStream& operator>> (std::string_view &token) {
+        if (next < line.numTokens) {
+            last = next++;
+            token = line.text.substr(line.tokens[last].column, line.tokens[last].size);
+        }
+        return *this;
+    };
+    // identificador do nome e tipo do ultimo token lido
+    std::uint32_t id () const { return (last < 0) ? NO_SYMBOL : line.tokens[last].id; };
+    int kind () const { return (last < 0) ? TOKEN_WORD : line.tokens[last].kind; };
+    // posicao do proximo token na linha (se nao houver mais tokens, onde ele estaria: um espaco depois do ultimo token)
+    int nextColumn () const {
+        if (next < line.numTokens)
+            return line.tokens[next].column;
+        return (line.numTokens > 0) ? line.tokens[line.numTokens-1].column + line.tokens[line.numTokens-1].size + 1 : 0;
+    };
+};
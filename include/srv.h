@@ -0,0 +1,412 @@
+/*      SRV.H: modo servidor. o processo fica de pé com as tabelas prontas e atende requisições de montagem por um socket unix (ou pela entrada/saída padrão)        */
+
+
+
+/*      DEFINIÇÕES DO PROTOCOLO       */
+
+// cada requisicao eh uma linha de texto, com as palavras separadas por espacos:
+//     FILE [opcoes] operacao entrada.asm saida.o
+//         executa a operacao (-p, -m ou -o) sobre os arquivos, como na linha de comando
+//     SOURCE [opcoes] tamanho
+//         seguida de 'tamanho' bytes com o codigo fonte. monta o fonte (-o) e devolve o codigo objeto na resposta, sem escrever arquivos
+//     as opcoes aceitas sao --binary, --parallel, e, so com FILE, --keep ou --incremental (nao os dois juntos)
+// a resposta de uma requisicao que pode ser executada eh:
+//     OK numErros tamanhoObjeto
+//     uma linha por erro, na ordem das linhas: ERROR linha coluna tipo<TAB>mensagem<TAB>linha do fonte
+//         (linha -1 se o erro nao tem linha. TAB, '\n' e '\' dentro dos campos viram "\t", "\n" e "\\")
+//     'tamanhoObjeto' bytes do '.o' (so no SOURCE. no FILE o '.o' fica no arquivo pedido e o tamanho eh 0)
+// e a de uma requisicao invalida eh uma linha so: FAIL mensagem
+//     (um SOURCE com tamanho invalido tambem fecha a conexao: sem o tamanho nao da para saber onde comeca a proxima requisicao)
+// no socket cada conexao eh atendida por uma thread, entao requisicoes de conexoes diferentes sao montadas ao mesmo tempo
+const int SRV_MAX_SOURCE = 1 << 24; // maior fonte aceito numa requisicao SOURCE (16 MiB)
+
+
+
+/*      DEFINIÇÕES DOS TIPOS        */
+
+// SrvReader: leitura bufferizada das requisicoes de uma conexao (linhas e blocos de bytes)
+struct SrvReader {
+    // membros
+    int fd; // conexao (ou entrada padrao)
+    std::vector<char> buffer; // bytes lidos e ainda nao consumidos estao em [begin, end)
+    std::size_t begin, end;
+    // metodos
+    SrvReader (int f): fd(f), buffer(1 << 16), begin(0), end(0) {};
+    // le mais bytes da conexao. retorna 0 no final da conexao (ou erro)
+    int fill () {
+        if (begin == end)
+            begin = end = 0;
+        if (end == buffer.size()) {
+            if (begin == 0)
+                buffer.resize(buffer.size()*2);
+            else {
+                memmove(buffer.data(), buffer.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+        }
+        ssize_t n;
+        do
+            n = ::read(fd, buffer.data() + end, buffer.size() - end);
+        while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            return 0;
+        end += n;
+        return 1;
+    };
+    // le uma linha, sem o '\n' (nem um '\r' antes dele). retorna 0 se a conexao acabou antes
+    int getLine (std::string &line) {
+        std::size_t scanned = 0; // bytes a partir de 'begin' ja procurados (fill pode mover os bytes no buffer)
+        while (1) {
+            const char *found = (const char*) memchr(buffer.data() + begin + scanned, '\n', end - begin - scanned);
+            if (found) {
+                std::size_t stop = found - buffer.data();
+                line.assign(buffer.data() + begin, stop - begin);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                begin = stop + 1;
+                return 1;
+            }
+            scanned = end - begin;
+            if (!fill())
+                return 0;
+        }
+    };
+    // le exatamente 'n' bytes. retorna 0 se a conexao acabou antes
+    // (a memoria cresce conforme os bytes chegam: um tamanho grande sem os bytes nao reserva nada alem de um buffer)
+    int getBytes (std::string &bytes, std::size_t n) {
+        bytes.clear();
+        bytes.reserve(std::min(n, buffer.size()));
+        while (bytes.size() < n) {
+            if (begin == end && !fill())
+                return 0;
+            std::size_t part = std::min(n - bytes.size(), end - begin);
+            bytes.append(buffer.data() + begin, part);
+            begin += part;
+        }
+        return 1;
+    };
+};
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+void srvPutText (OutputBuffer&, std::string_view);
+void srvPutField (OutputBuffer&, std::string_view);
+void srvFail (OutputBuffer&, std::string_view);
+int srvMemoryFile (std::string&);
+int srvRequest (std::string&, SrvReader&, OutputBuffer&, Options&, Tables&);
+void srvSession (int, int, Options&, Tables&);
+void runServer (Options&, Tables&);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+srvPutText: anexa um texto a resposta
+entrada: saida e texto
+saida: nenhuma
+*/
+void srvPutText (OutputBuffer &out, std::string_view text) {
+    
+    out.putBytes(text.data(), text.size());
+
+}
+
+
+
+/*
+srvPutField: anexa um campo de um erro a resposta, trocando TAB, '\n' e '\' pelas sequencias de escape
+entrada: saida e texto do campo
+saida: nenhuma
+*/
+void srvPutField (OutputBuffer &out, std::string_view field) {
+    
+    for (unsigned int i = 0; i < field.size(); ++i) {
+        if (field[i] == '\t')
+            srvPutText (out, "\\t");
+        else if (field[i] == '\n')
+            srvPutText (out, "\\n");
+        else if (field[i] == '\\')
+            srvPutText (out, "\\\\");
+        else
+            out.putChar(field[i]);
+    }
+
+}
+
+
+
+/*
+srvFail: responde que a requisicao eh invalida
+entrada: saida e mensagem (sem '\n' no final)
+saida: nenhuma
+*/
+void srvFail (OutputBuffer &out, std::string_view message) {
+    
+    srvPutText (out, "FAIL ");
+    srvPutField (out, message);
+    out.putChar('\n');
+
+}
+
+
+
+/*
+srvMemoryFile: cria um arquivo anonimo em memoria, que as passagens abrem pelo nome como um arquivo comum
+entrada: string que recebe o nome do arquivo
+saida: descritor do arquivo (-1 se o sistema nao suporta)
+*/
+int srvMemoryFile (std::string &fileName) {
+
+#ifdef __linux__
+    int fd = memfd_create("sb", MFD_CLOEXEC);
+    if (fd >= 0)
+        fileName = "/proc/self/fd/" + std::to_string(fd);
+    return fd;
+#else
+    fileName.clear();
+    return -1;
+#endif
+
+}
+
+
+
+/*
+srvRequest: atende uma requisicao (ver o protocolo no comeco deste arquivo)
+entrada: linha da requisicao, leitura da conexao (para o fonte do SOURCE), saida, opcoes do servidor e tabelas (so lidas)
+saida: 1 se a conexao pode continuar, 0 se ela deve ser fechada (resposta anexada a saida)
+*/
+int srvRequest (std::string &request, SrvReader &in, OutputBuffer &out, Options &serverOptions, Tables &tables) {
+    
+    std::stringstream requestStream (request);
+    std::string command, word;
+    std::vector<std::string> args;
+    requestStream >> command;
+    
+    // opcoes da requisicao
+    Options options;
+    options.jobs = serverOptions.jobs;
+    std::string badOption;
+    while (requestStream >> word) {
+        if (word.substr(0, 2) != "--" || word.size() == 2)
+            args.push_back(word);
+        else if (word == "--binary")
+            options.binary = 1;
+        else if (word == "--parallel")
+            options.parallel = 1;
+        else if (word == "--keep" && command == "FILE")
+            options.keepIntermediates = 1;
+        else if (word == "--incremental" && command == "FILE")
+            options.incremental = 1;
+        else if (badOption.empty())
+            badOption = word;
+    }
+    
+    // o fonte do SOURCE eh lido antes de qualquer resposta, para a proxima requisicao comecar no lugar certo. sem um tamanho valido
+    // os bytes do fonte seriam lidos como requisicoes, entao a conexao eh fechada
+    std::string source;
+    int size = -1;
+    if (command == "SOURCE") {
+        if (args.size() != 1 || !integerCheck(args[0], size) || size < 0 || size > SRV_MAX_SOURCE) {
+            srvFail (out, "Tamanho do fonte inválido");
+            return 0;
+        }
+        if (!in.getBytes(source, size))
+            return 0;
+    }
+    if (!badOption.empty()) {
+        srvFail (out, "Opção inválida: " + badOption);
+        return 1;
+    }
+    if (options.incremental && options.keepIntermediates) {
+        srvFail (out, "--incremental não vale junto com --keep");
+        return 1;
+    }
+    
+    std::vector<Error> errorList;
+    std::string object;
+    
+    // montagem de arquivos, como na linha de comando
+    if (command == "FILE") {
+        
+        if (args.size() != 3) {
+            srvFail (out, "Número inválido de argumentos: " + std::to_string(args.size()) + " (3 esperados)");
+            return 1;
+        }
+        if (args[0] != "-p" && args[0] != "-m" && args[0] != "-o") {
+            srvFail (out, "Operação inválida: " + args[0]);
+            return 1;
+        }
+        std::ostringstream checkMessage;
+        if (fileCheck(args[1], args[2], checkMessage) == -1) {
+            std::string message = checkMessage.str();
+            message.pop_back();
+            srvFail (out, message);
+            return 1;
+        }
+        processFile (args[0], args[1], args[2], options, tables, errorList);
+    
+    // montagem do fonte que vem na requisicao. a entrada e o '.o' sao arquivos em memoria
+    } else if (command == "SOURCE") {
+        
+        std::string inFileName, outFileName;
+        int inFd = srvMemoryFile(inFileName), outFd = srvMemoryFile(outFileName);
+        if (inFd < 0 || outFd < 0) {
+            if (inFd >= 0)
+                close(inFd);
+            if (outFd >= 0)
+                close(outFd);
+            srvFail (out, "Fonte na requisição não suportado neste sistema");
+            return 1;
+        }
+        for (std::size_t done = 0; done < source.size(); ) {
+            ssize_t n = write(inFd, source.data() + done, source.size() - done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        processFile ("-o", inFileName, outFileName, options, tables, errorList);
+        struct stat info;
+        if (fstat(outFd, &info) == 0) {
+            object.resize(info.st_size);
+            std::size_t done = 0;
+            while (done < object.size()) {
+                ssize_t n = pread(outFd, &object[done], object.size() - done, done);
+                if (n <= 0)
+                    break;
+                done += n;
+            }
+            object.resize(done);
+        }
+        close(inFd);
+        close(outFd);
+    
+    } else {
+        srvFail (out, "Requisição inválida: " + command);
+        return 1;
+    }
+    
+    // coloca os erros na ordem, de acordo com o número da linha (como na linha de comando)
+    sortErrors (errorList);
+    
+    srvPutText (out, "OK ");
+    out.putInt(errorList.size());
+    out.putChar(' ');
+    out.putInt(object.size());
+    out.putChar('\n');
+    for (unsigned int i = 0; i < errorList.size(); ++i) {
+        srvPutText (out, "ERROR ");
+        out.putInt(errorList[i].lineNum);
+        out.putChar(' ');
+        out.putInt(errorList[i].pos);
+        out.putChar(' ');
+        srvPutField (out, errorList[i].type);
+        out.putChar('\t');
+        srvPutField (out, errorList[i].message);
+        out.putChar('\t');
+        srvPutField (out, errorList[i].line);
+        out.putChar('\n');
+    }
+    srvPutText (out, object);
+    
+    return 1;
+}
+
+
+
+/*
+srvSession: atende as requisicoes de uma conexao, uma depois da outra, ate ela ser fechada
+entrada: descritor de onde as requisicoes sao lidas e de onde as respostas sao escritas (o mesmo no socket), opcoes do servidor e tabelas
+saida: nenhuma (a conexao eh fechada no final)
+*/
+void srvSession (int inFd, int outFd, Options &options, Tables &tables) {
+    
+    SrvReader in (inFd);
+    OutputBuffer out;
+    out.fd = outFd;
+    
+    std::string request;
+    while (in.getLine(request)) {
+        if (request.empty())
+            continue;
+        int more = srvRequest (request, in, out, options, tables);
+        out.flush();
+        if (!more)
+            break;
+    }
+    
+    // a saida fecha o descritor dela. no socket ele eh o mesmo da entrada
+    out.close();
+    if (inFd != outFd)
+        close(inFd);
+
+}
+
+
+
+/*
+runServer: modo servidor. com '-' atende as requisicoes da entrada padrao e responde na saida padrao; senao escuta no socket unix
+e atende cada conexao numa thread, com as tabelas compartilhadas (so leitura), ate o processo ser terminado
+entrada: opcoes (com o caminho do socket) e tabelas
+saida: nenhuma
+*/
+void runServer (Options &options, Tables &tables) {
+    
+    // um cliente que fecha a conexao antes da resposta nao pode derrubar o servidor
+    signal(SIGPIPE, SIG_IGN);
+    
+    if (options.serverPath == "-") {
+        srvSession (0, 1, options, tables);
+        return;
+    }
+    
+    // cria o socket (um socket antigo com o mesmo caminho eh removido)
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (options.serverPath.size() >= sizeof(address.sun_path)) {
+        std::cout << "Caminho do socket muito longo: " << options.serverPath << "\n";
+        return;
+    }
+    memcpy(address.sun_path, options.serverPath.c_str(), options.serverPath.size());
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(options.serverPath.c_str());
+    if (server < 0 || bind(server, (sockaddr*) &address, sizeof(address)) < 0 || listen(server, SOMAXCONN) < 0) {
+        std::cout << "Erro ao criar o socket: " << options.serverPath << "\n";
+        if (server >= 0)
+            close(server);
+        return;
+    }
+    
+    // cada conexao eh atendida na sua propria thread, que termina sozinha. so eh preciso saber quantas ainda estao rodando
+    std::mutex activeMutex;
+    std::condition_variable activeCond;
+    int active = 0;
+    while (1) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock (activeMutex);
+            active++;
+        }
+        std::thread([client, &options, &tables, &activeMutex, &activeCond, &active] {
+            srvSession (client, client, options, tables);
+            std::lock_guard<std::mutex> lock (activeMutex);
+            active--;
+            activeCond.notify_all();
+        }).detach();
+    }
+    
+    // espera as conexoes abertas terminarem
+    close(server);
+    std::unique_lock<std::mutex> lock (activeMutex);
+    activeCond.wait(lock, [&active] { return active == 0; });
+
+}
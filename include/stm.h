@@ -0,0 +1,255 @@
+/*      STM.H: montagem em fluxo, com memoria limitada. as palavras vao para o disco assim que sao montadas e as pendencias sao corrigidas no arquivo no final        */
+
+
+
+/*      DECLARAÇÕES DAS FUNÇÕES      */
+int streamGet (const unsigned char*);
+void streamSet (unsigned char*, int);
+void streamLineTexts (const std::string&, std::vector<Error>&, std::size_t, std::vector<int>&);
+void assembleCodeStream (McrState&, PreState&, std::string, Tables&, std::vector<Error>&, int);
+
+
+
+/*      DEFINIÇÕES DAS FUNÇÕES      */
+
+/*
+streamGet: le uma palavra de 32 bits em little endian
+entrada: posicao da palavra
+saida: palavra
+*/
+int streamGet (const unsigned char *at) {
+    
+    return (std::int32_t) (at[0] | (at[1] << 8) | (at[2] << 16) | ((std::uint32_t) at[3] << 24));
+
+}
+
+
+
+/*
+streamSet: escreve uma palavra de 32 bits em little endian
+entrada: posicao da palavra e valor
+saida: nenhuma
+*/
+void streamSet (unsigned char *at, int value) {
+    
+    std::uint32_t bits = value;
+    for (int b = 0; b < 4; ++b)
+        at[b] = (bits >> (8*b)) & 0xFF;
+
+}
+
+
+
+/*
+streamLineTexts: completa o texto da linha dos erros reportados sem as linhas em memoria, relendo do disco so as linhas pedidas
+entrada: arquivo com as linhas da saida das macros (uma por linha), lista de erros, posicao do primeiro erro sem texto e linha da saida das macros de cada um
+saida: nenhuma (textos colocados nos erros)
+*/
+void streamLineTexts (const std::string &linesFileName, std::vector<Error> &errorList, std::size_t first, std::vector<int> &errorLines) {
+    
+    if (errorLines.empty())
+        return;
+    
+    // os erros na ordem das linhas, para ler o arquivo uma vez so
+    std::vector<int> order (errorLines.size());
+    for (unsigned int i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&errorLines] (int a, int b) { return errorLines[a] < errorLines[b]; });
+    
+    SourceFile linesFile;
+    if (!linesFile.open(linesFileName))
+        return;
+    std::string_view text;
+    int lineNum = 0;
+    for (unsigned int i = 0; i < order.size(); ++i) {
+        while (lineNum < errorLines[order[i]] && !linesFile.eof()) {
+            linesFile.getLine(text);
+            lineNum++;
+        }
+        if (lineNum == errorLines[order[i]])
+            errorList[first + order[i]].line = std::string(text);
+    }
+
+}
+
+
+
+/*
+assembleCodeStream: faz a passagem de montagem como o assembleCode, mas sem guardar o codigo e as linhas inteiros em memoria:
+    - o codigo de cada linha vai para um arquivo temporario assim que eh montado (palavras de 32 bits, entao cada endereco tem posicao fixa)
+    - as linhas da saida das macros tambem vao para um arquivo temporario, lido de novo so se alguma pendencia der erro
+    - no final, o arquivo das palavras eh mapeado e as pendencias (as unicas coisas que ficam em memoria, alem dos rotulos) sao corrigidas nele
+    - o formato binario vira o proprio '.o' (com o cabecalho preenchido no final) e o texto eh escrito a partir dele
+o '.o' e os erros sao os mesmos da montagem normal
+entrada: estado da passagem de macros e do preprocessamento, nome do arquivo de saida '.o', tabelas, lista de erros e formato da saida (0: texto, 1: binario)
+saida: nenhuma (arquivo '.o' escrito)
+*/
+void assembleCodeStream (McrState &mcr, PreState &pre, std::string outFileName, Tables &tables, std::vector<Error> &errorList, int binary) {
+    
+    LineDict lineDict (mcr.lineMap, pre.lineDict); // linha da saida das macros -> linha do arquivo original (composto so quando um erro eh reportado)
+    
+    SymbolTable labelList (pre.symbols); // tabela de simbolos (com os nomes compartilhados pelas passagens)
+    
+    std::vector<int> machineCode; // codigo de maquina da linha atual (esvaziado depois de ir para o arquivo)
+    
+    // arquivos temporarios ao lado do '.o': palavras (depois de um cabecalho, no formato binario) e linhas
+    std::string wordsFileName = outFileName + ".words", linesFileName = outFileName + ".lines";
+    std::size_t base = binary ? OBJ_HEADER_SIZE : 0; // posicao da primeira palavra no arquivo das palavras
+    OutputBuffer wordsFile, linesFile;
+    int wordsOpen = wordsFile.open(wordsFileName, O_RDWR);
+    int linesOpen = linesFile.open(linesFileName);
+    
+    // sem os arquivos temporarios, monta em memoria (nada foi lido ainda, entao a saida eh a mesma)
+    if (!wordsOpen || !linesOpen) {
+        if (wordsOpen) {
+            wordsFile.close();
+            unlink(wordsFileName.c_str());
+        }
+        if (linesOpen) {
+            linesFile.close();
+            unlink(linesFileName.c_str());
+        }
+        assembleCode (mcr, pre, outFileName, tables, errorList, binary);
+        return;
+    }
+    for (std::size_t b = 0; b < base; ++b)
+        wordsFile.putChar(0);
+    
+    int lineCounter = 1;
+    int addrCounter = 0;
+    int section = -1; // -1: nenhuma, 0: text, 1: data
+    int sectionText = -1; // -1: não encontrou seção texto, 0: encontrou
+    int textAddr = -1, dataAddr = -1; // endereço onde começa cada seção (para o cabeçalho do formato binário)
+    
+    RunStats *stats = mcr.stats;
+    int caller = stats ? stats->enter(STATS_ASM) : -1;
+    
+    TokenLine line;
+    while (mcrNextLine(mcr, pre, line, tables, errorList)) {
+        
+        // monta a linha (os erros copiam o texto dela na hora)
+        int lastSection = section;
+        asmParser(line, labelList, lineCounter, addrCounter, lineDict, tables, section, sectionText, machineCode, errorList);
+        
+        // guarda onde cada seção começou pela primeira vez
+        if (section != lastSection && section == 0 && textAddr < 0)
+            textAddr = addrCounter;
+        if (section != lastSection && section == 1 && dataAddr < 0)
+            dataAddr = addrCounter;
+        
+        // o codigo e a linha vao para o disco. os enderecos ja resolvidos so servem para a montagem em blocos
+        for (unsigned int i = 0; i < machineCode.size(); ++i)
+            putWord (wordsFile, machineCode[i]);
+        machineCode.clear();
+        labelList.resolvedList.clear();
+        linesFile.putBytes(line.text.data(), line.text.size());
+        linesFile.putChar('\n');
+        
+        lineCounter++;
+    
+    }
+    wordsFile.flush();
+    linesFile.close();
+    
+    // se o limite de erros interrompeu a leitura, o '.o' nao eh escrito (como na montagem normal)
+    if (pre.stopped) {
+        if (stats)
+            stats->enter(caller);
+        wordsFile.close();
+        unlink(wordsFileName.c_str());
+        unlink(linesFileName.c_str());
+        return;
+    }
+    
+    if (sectionText == -1)
+        errorList.push_back(Error ("seção texto é obrigatória", "semântico", -1, "", 0));
+    
+    // mapeia as palavras para corrigir as pendencias no proprio arquivo (um arquivo vazio nao pode ser mapeado, mas tambem nao tem pendencias)
+    if (stats)
+        stats->enter(STATS_FIXUP);
+    int numWords = addrCounter;
+    std::size_t size = base + (std::size_t) numWords * OBJ_WORD_SIZE;
+    unsigned char *words = nullptr;
+    if (size > 0) {
+        void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, wordsFile.fd, 0);
+        if (map != MAP_FAILED)
+            words = (unsigned char*) map;
+    }
+    
+    // sem o mapeamento as pendencias nao podem ser corrigidas, entao o '.o' nao eh escrito
+    if (size > 0 && !words) {
+        errorList.push_back(Error ("não foi possível mapear o arquivo temporário " + wordsFileName, "semântico", -1, "", 0));
+        if (stats)
+            stats->enter(caller);
+        wordsFile.close();
+        unlink(wordsFileName.c_str());
+        unlink(linesFileName.c_str());
+        return;
+    }
+    
+    // as pendencias passam a apontar para um vetor so com as palavras delas, que o resolveCode corrige como se fosse o codigo inteiro
+    FixupTable &fixups = labelList.fixups;
+    int numFixups = fixups.size();
+    std::vector<int> fixupCode (numFixups), fixupAddr (numFixups);
+    for (int k = 0; k < numFixups; ++k) {
+        fixupAddr[k] = fixups.address[k];
+        fixupCode[k] = streamGet(words + base + (std::size_t) fixups.address[k] * OBJ_WORD_SIZE);
+        fixups.address[k] = k;
+    }
+    std::pmr::vector<std::string_view> lines; // sem as linhas em memoria: os erros sao completados depois
+    std::vector<int> errorLines;
+    std::size_t firstError = errorList.size();
+    int numResolved = resolveCode(labelList, fixupCode, lineDict, lines, errorList, &errorLines);
+    if (words) {
+        for (int k = 0; k < numFixups; ++k)
+            streamSet (words + base + (std::size_t) fixupAddr[k] * OBJ_WORD_SIZE, fixupCode[k]);
+    }
+    streamLineTexts (linesFileName, errorList, firstError, errorLines);
+    unlink(linesFileName.c_str());
+    
+    // escreve o '.o': no binario, o cabecalho no comeco das palavras, e no texto as palavras convertidas
+    if (stats)
+        stats->enter(STATS_OUTPUT);
+    std::size_t numBytes = size;
+    if (binary) {
+        // a secao de texto vai do seu comeco ate o comeco da secao de dados (se vier depois) ou ate o final
+        int textSize = 0;
+        if (textAddr >= 0)
+            textSize = ((dataAddr > textAddr) ? dataAddr : numWords) - textAddr;
+        if (words)
+            objHeader ((char*) words, (textAddr < 0) ? 0 : textAddr, textSize, numWords);
+    } else {
+        OutputBuffer outFile;
+        outFile.open(outFileName);
+        for (int i = 0; i < numWords && words; ++i) {
+            outFile.putInt(streamGet(words + (std::size_t) i * OBJ_WORD_SIZE));
+            outFile.putChar(' ');
+        }
+        outFile.close();
+        numBytes = outFile.written;
+    }
+    if (words)
+        munmap(words, size);
+    wordsFile.close();
+    if (binary)
+        rename(wordsFileName.c_str(), outFileName.c_str());
+    else
+        unlink(wordsFileName.c_str());
+    
+    // contadores da montagem
+    if (stats) {
+        stats->enter(caller);
+        stats->linesIn[STATS_ASM] = lineCounter-1;
+        stats->linesOut[STATS_ASM] = numWords;
+        stats->linesIn[STATS_FIXUP] = numFixups;
+        stats->linesOut[STATS_FIXUP] = numResolved;
+        stats->linesIn[STATS_OUTPUT] = numWords;
+        stats->linesOut[STATS_OUTPUT] = numBytes;
+        stats->fixups = numFixups;
+        stats->words = numWords;
+        stats->bytesWritten += numBytes;
+        for (int i = 0; i < labelList.size(); ++i)
+            stats->labels += labelList[i].isDefined;
+    }
+
+}
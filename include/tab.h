@@ -0,0 +1,124 @@
+/*      TAB.H: tabelas de instruções e diretivas embutidas no executável        */
+
+
+
+/*      DEFINIÇÕES DAS TABELAS      */
+
+// InstrDef: uma linha da tabela de instruções (mesmo formato de tabl/tabInstr.txt)
+struct InstrDef {
+    const char *name; // nome da instrucao
+    int numArg, // numero de operandos
+        opcode; // opcode da instrucao
+};
+
+// tabela de instrucoes embutida (conteudo de tabl/tabInstr.txt)
+constexpr InstrDef INSTR_TAB[] = {
+    {"ADD",     1,  1},
+    {"SUB",     1,  2},
+    {"MULT",    1,  3},
+    {"DIV",     1,  4},
+    {"JMP",     1,  5},
+    {"JMPN",    1,  6},
+    {"JMPP",    1,  7},
+    {"JMPZ",    1,  8},
+    {"COPY",    2,  9},
+    {"LOAD",    1,  10},
+    {"STORE",   1,  11},
+    {"INPUT",   1,  12},
+    {"OUTPUT",  1,  13},
+    {"STOP",    0,  14}
+};
+
+// tabela de diretivas embutida (conteudo de tabl/tabDir.txt)
+constexpr const char *DIR_TAB[] = {
+    "SECTION",
+    "SPACE",
+    "CONST",
+    "EQU",
+    "IF",
+    "MACRO",
+    "END"
+};
+
+constexpr int INSTR_TAB_SIZE = sizeof(INSTR_TAB)/sizeof(INSTR_TAB[0]);
+constexpr int DIR_TAB_SIZE = sizeof(DIR_TAB)/sizeof(DIR_TAB[0]);
+
+
+
+/*      HASH PERFEITO      */
+
+// numero de posicoes de cada tabela hash e semente da funcao hash (escolhida para nao haver colisoes nas tabelas acima)
+constexpr int INSTR_SLOTS = 16;
+constexpr int DIR_SLOTS = 8;
+constexpr unsigned int TAB_SEED = 168213;
+
+// tabHash: hash FNV-1a de 32 bits com a semente acima e uma mistura final dos bits altos
+constexpr unsigned int tabMix (unsigned int x) { return x ^ (x >> 15); }
+constexpr unsigned int tabHashStep (const char *s, unsigned int x) { return (*s == '\0') ? tabMix(x) : tabHashStep(s+1, (x ^ (unsigned char)*s) * 16777619u); }
+constexpr unsigned int tabHash (const char *s) { return tabHashStep(s, TAB_SEED); }
+
+// versao de tempo de execucao, para strings que nao terminam em '\0' ou tem tamanho conhecido
+inline unsigned int tabHash (const char *s, std::size_t size) {
+    unsigned int x = TAB_SEED;
+    for (std::size_t i = 0; i < size; ++i)
+        x = (x ^ (unsigned char)s[i]) * 16777619u;
+    return tabMix(x);
+}
+
+// instrSlot/dirSlot: indice da entrada da tabela que cai na posicao 'slot' (-1 se nenhuma)
+constexpr int instrSlot (int slot, int i) { return (i == INSTR_TAB_SIZE) ? -1 : ((int)(tabHash(INSTR_TAB[i].name) % INSTR_SLOTS) == slot ? i : instrSlot(slot, i+1)); }
+constexpr int dirSlot (int slot, int i) { return (i == DIR_TAB_SIZE) ? -1 : ((int)(tabHash(DIR_TAB[i]) % DIR_SLOTS) == slot ? i : dirSlot(slot, i+1)); }
+
+// tabelas hash, construidas em tempo de compilacao
+constexpr int INSTR_HASH[INSTR_SLOTS] = {
+    instrSlot(0,0), instrSlot(1,0), instrSlot(2,0), instrSlot(3,0),
+    instrSlot(4,0), instrSlot(5,0), instrSlot(6,0), instrSlot(7,0),
+    instrSlot(8,0), instrSlot(9,0), instrSlot(10,0), instrSlot(11,0),
+    instrSlot(12,0), instrSlot(13,0), instrSlot(14,0), instrSlot(15,0)
+};
+constexpr int DIR_HASH[DIR_SLOTS] = {
+    dirSlot(0,0), dirSlot(1,0), dirSlot(2,0), dirSlot(3,0),
+    dirSlot(4,0), dirSlot(5,0), dirSlot(6,0), dirSlot(7,0)
+};
+
+// garante que o hash eh perfeito: toda entrada tem que estar na posicao calculada pra ela
+constexpr bool instrPerfect (int i) { return (i == INSTR_TAB_SIZE) || (INSTR_HASH[tabHash(INSTR_TAB[i].name) % INSTR_SLOTS] == i && instrPerfect(i+1)); }
+constexpr bool dirPerfect (int i) { return (i == DIR_TAB_SIZE) || (DIR_HASH[tabHash(DIR_TAB[i]) % DIR_SLOTS] == i && dirPerfect(i+1)); }
+static_assert(instrPerfect(0), "colisao na tabela hash de instrucoes: troque TAB_SEED ou INSTR_SLOTS");
+static_assert(dirPerfect(0), "colisao na tabela hash de diretivas: troque TAB_SEED ou DIR_SLOTS");
+
+
+
+/*      DEFINIÇÃO DO TIPO       */
+
+// Tables: tabelas de instrucoes e diretivas usadas pelo montador, embutidas ou lidas de arquivos
+struct Tables {
+    // membros
+    std::vector<Instr> instrList; // lista de instrucoes
+    std::vector<Dir> dirList; // lista de diretivas
+    int builtinInstr, // se a lista de instrucoes eh a embutida (usa o hash perfeito)
+        builtinDir; // se a lista de diretivas eh a embutida
+    std::unordered_map<std::string, int> instrIndex; // indice das instrucoes lidas de arquivo
+    std::unordered_map<std::string, int> dirIndex; // indice das diretivas lidas de arquivo
+    // metodos
+    Tables (): builtinInstr(0), builtinDir(0) {};
+    // procura uma instrucao pelo nome. retorna a posicao na lista ou -1
+    int findInstr (std::string_view name) const {
+        if (builtinInstr) {
+            int i = INSTR_HASH[tabHash(name.data(), name.size()) % INSTR_SLOTS];
+            return (i >= 0 && name == INSTR_TAB[i].name) ? i : -1;
+        }
+        std::unordered_map<std::string, int>::const_iterator it = instrIndex.find(std::string(name));
+        return (it == instrIndex.end()) ? -1 : it->second;
+    };
+    // procura uma diretiva pelo nome. retorna a posicao na lista ou -1
+    int findDir (std::string_view name) const {
+        if (builtinDir) {
+            int i = DIR_HASH[tabHash(name.data(), name.size()) % DIR_SLOTS];
+            return (i >= 0 && name == DIR_TAB[i]) ? i : -1;
+        }
+        std::unordered_map<std::string, int>::const_iterator it = dirIndex.find(std::string(name));
+        return (it == dirIndex.end()) ? -1 : it->second;
+    };
+};
+
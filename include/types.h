@@ -10,6 +10,30 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <unordered_map>
+#include <deque>
+#include <string_view>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <memory_resource>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <csignal>
+#include <cerrno>
 
 
 
@@ -18,8 +42,22 @@
 struct Instr;
 struct Dir;
 struct Label;
+struct Token;
+struct TokenLine;
+struct FixupTable;
+struct ChainTable;
+struct Interner;
+struct EquTable;
+struct SymbolTable;
 struct Macro;
+struct LineTrace;
+struct RunStats;
+struct LineRange;
+struct LineMap;
+struct LineDict;
+struct RunArena;
 struct Error;
+struct Options;
 
 
 
@@ -51,21 +89,335 @@ struct Dir {
 
 
 
+// identificador que nao corresponde a nenhum simbolo
+const std::uint32_t NO_SYMBOL = 0xFFFFFFFF;
+
+// tipos de token (ver Token)
+const int TOKEN_WORD = 0; // token comum
+const int TOKEN_LABEL = 1; // termina com ':' (definicao de rotulo)
+const int TOKEN_COMMA = 2; // termina com ',' (operando seguido de virgula)
+
+
+
 // Label: armazena um rotulo e suas caracteristicas
 struct Label {
     // membros
-    std::string name; // nome do rotulo
-    std::string equ; // definicao vinda de um equ
+    std::uint32_t id; // identificador do nome do rotulo (ver Interner)
     int value; // definicao do rotulo (um endereço)
-    int isDefined; // se o rotulo ja foi ou nao definido
-    std::vector<int> pendList; // lista de pendencias
-    std::vector<int> auxInfoList; // lista de informacoes auxiliares
-    std::vector<int> posList; // lista de posição do rótulo na linha
+    int isDefined; // se o rotulo ja foi ou nao definido (as pendencias ficam na FixupTable da tabela de simbolos ou encadeadas a partir de chain)
     int isConst; // se é um const ou não (0: nao eh const, 1: eh const, 2: é const = 0)
     int vectSize; // tamanho do vetor, para o caso de ser um space. 0 indica que o rótulo é da área de texto
+    int chain; // endereco da ultima referencia pendente, encadeada no codigo de maquina (-1 se nao ha; ver ChainTable)
+    // metodos
+    Label (): id(NO_SYMBOL), value(0), isDefined(0), isConst(0), vectSize(0), chain(-1) {};
+};
+
+
+
+// Token: um token de uma linha ja normalizada (em caixa alta, com os tokens separados por um espaco so). a linha eh separada em tokens uma vez so, no preprocessamento, e as outras passagens usam esses tokens
+struct Token {
+    // membros
+    int kind; // TOKEN_WORD, TOKEN_LABEL ou TOKEN_COMMA
+    std::uint32_t id; // identificador do nome do token, sem o ':' ou a ',' do final (ver Interner)
+    int column; // posicao do token na linha
+    int size; // tamanho do token (com o ':' ou a ',')
+    // metodos
+    Token () {};
+    Token (int kd, std::uint32_t nm, int col, int sz): kind(kd), id(nm), column(col), size(sz) {};
+};
+
+
+
+// TokenLine: uma linha e os tokens dela
+struct TokenLine {
+    // membros
+    std::string_view text; // texto da linha
+    const Token *tokens; // tokens da linha
+    int numTokens; // quantos tokens a linha tem
+    // metodos
+    TokenLine (): tokens(nullptr), numTokens(0) {};
+    TokenLine (std::string_view txt, const Token *tks, int ntk): text(txt), tokens(tks), numTokens(ntk) {};
+};
+
+
+
+// Interner: guarda uma unica copia de cada nome de simbolo (rotulos, EQUs e macros) e da a ele um identificador de 32 bits.
+// as tabelas das passagens comparam e indexam esses identificadores em vez das strings
+struct Interner {
+    // membros
+    std::deque<std::string> storage; // nomes (o deque nao move as strings, entao as views para elas continuam validas)
+    std::vector<std::string_view> names; // identificador -> nome
+    std::vector<std::uint32_t> slots; // tabela hash aberta (sondagem linear): pares (hash do nome, identificador). NO_SYMBOL marca posicao vazia
+    // metodos
+    Interner () {};
+    Interner (const Interner&) = delete;
+    Interner& operator= (const Interner&) = delete;
+    // identificador do nome, criando um novo se o nome ainda nao foi visto
+    std::uint32_t intern (std::string_view name) {
+        if (slots.empty())
+            grow();
+        std::uint32_t hash = hashName(name);
+        std::size_t slot = lookup(name, hash);
+        if (slots[slot+1] != NO_SYMBOL)
+            return slots[slot+1];
+        // mantem a tabela no maximo metade cheia
+        if ((names.size()+1) * 4 > slots.size()) {
+            grow();
+            slot = lookup(name, hash);
+        }
+        storage.push_back(std::string(name));
+        std::uint32_t id = names.size();
+        names.push_back(storage.back());
+        slots[slot] = hash;
+        slots[slot+1] = id;
+        return id;
+    };
+    // identificador do nome, ou NO_SYMBOL se o nome nunca foi visto (nao cria um novo)
+    std::uint32_t find (std::string_view name) const {
+        if (slots.empty())
+            return NO_SYMBOL;
+        return slots[lookup(name, hashName(name))+1];
+    };
+    // nome de um identificador
+    std::string_view name (std::uint32_t id) const { return names[id]; };
+    int size () const { return names.size(); };
+    // hash FNV-1a do nome
+    static std::uint32_t hashName (std::string_view name) {
+        std::uint32_t x = 2166136261u;
+        for (std::size_t i = 0; i < name.size(); ++i)
+            x = (x ^ (unsigned char) name[i]) * 16777619u;
+        return x;
+    };
+    // posicao (do par) onde o nome esta, ou da posicao vazia onde ele entraria. o nome so eh comparado quando o hash bate
+    std::size_t lookup (std::string_view name, std::uint32_t hash) const {
+        std::size_t mask = slots.size()/2 - 1;
+        std::size_t i = hash & mask;
+        while (slots[2*i+1] != NO_SYMBOL && (slots[2*i] != hash || names[slots[2*i+1]] != name))
+            i = (i+1) & mask;
+        return 2*i;
+    };
+    // dobra a tabela e reinsere os nomes
+    void grow () {
+        std::size_t numSlots = slots.empty() ? 64 : slots.size(); // numero de posicoes da tabela nova (cada uma tem 2 inteiros)
+        slots.assign(2*numSlots, NO_SYMBOL);
+        for (std::uint32_t id = 0; id < names.size(); ++id) {
+            std::uint32_t hash = hashName(names[id]);
+            std::size_t slot = lookup(names[id], hash);
+            slots[slot] = hash;
+            slots[slot+1] = id;
+        }
+    };
+};
+
+
+
+// EquTable: rotulos definidos por EQU, indexados pelo identificador do nome (a busca eh feita por token, sem alocar)
+struct EquTable {
+    // membros
+    Interner *symbols; // nomes dos simbolos (compartilhados com as outras passagens)
+    std::vector<std::uint32_t> values; // identificador do rotulo -> identificador do valor associado (NO_SYMBOL se nao foi definido por EQU)
+    int count; // quantos rotulos foram definidos
+    std::uint32_t last; // ultimo rotulo definido (NO_SYMBOL se nenhum)
+    // metodos
+    EquTable (): symbols(nullptr), count(0), last(NO_SYMBOL) {};
+    // associa um valor ao rotulo. se o rotulo ja existir, vale a primeira definicao
+    void define (std::string_view name, std::string_view equ) {
+        std::uint32_t id = symbols->intern(name);
+        if (id < values.size() && values[id] != NO_SYMBOL)
+            return;
+        define(id, symbols->intern(equ));
+    };
+    void define (std::uint32_t id, std::uint32_t value) {
+        if (id < values.size() && values[id] != NO_SYMBOL)
+            return;
+        if (id >= values.size())
+            values.resize(id+1, NO_SYMBOL);
+        values[id] = value;
+        last = id;
+        count++;
+    };
+    // procura o valor associado a um rotulo. retorna nullptr se o rotulo nao foi definido
+    const std::string_view* find (std::string_view name) const {
+        return find(symbols->find(name));
+    };
+    const std::string_view* find (std::uint32_t id) const {
+        if (id == NO_SYMBOL || id >= values.size() || values[id] == NO_SYMBOL)
+            return nullptr;
+        return &symbols->names[values[id]];
+    };
+    int size () const { return count; };
+};
+
+
+
+// FixupTable: pendencias de todos os rotulos (referencias feitas antes da definicao) numa tabela so, guardada como uma estrutura de vetores
+struct FixupTable {
+    // membros
+    std::vector<int> label; // posicao do rotulo na tabela de simbolos
+    std::vector<int> address; // endereco do codigo de maquina que recebe o valor do rotulo
+    std::vector<int> kind; // informacao auxiliar (0: instrucao padrao, 1: divisao, 2: pulo, 3: modifica a memoria)
+    std::vector<int> column; // posicao do rotulo na linha (para as mensagens de erro)
+    std::vector<int> line; // linha da saida das macros onde a referencia foi feita (idem)
+    // metodos
+    FixupTable () {};
+    void push (int lb, int addr, int kd, int col, int ln) {
+        label.push_back(lb);
+        address.push_back(addr);
+        kind.push_back(kd);
+        column.push_back(col);
+        line.push_back(ln);
+    };
+    int size () const { return label.size(); };
+    // ordena as pendencias pelo rotulo, mantendo dentro de cada rotulo a ordem em que foram feitas (counting sort, estavel)
+    void sortByLabel (int numLabels) {
+        std::vector<int> first (numLabels+1, 0);
+        for (unsigned int i = 0; i < label.size(); ++i)
+            first[label[i]+1]++;
+        for (int i = 0; i < numLabels; ++i)
+            first[i+1] += first[i];
+        std::vector<int> sortedLabel (label.size()), sortedAddress (label.size()), sortedKind (label.size()), sortedColumn (label.size()), sortedLine (label.size());
+        for (unsigned int i = 0; i < label.size(); ++i) {
+            int to = first[label[i]]++;
+            sortedLabel[to] = label[i];
+            sortedAddress[to] = address[i];
+            sortedKind[to] = kind[i];
+            sortedColumn[to] = column[i];
+            sortedLine[to] = line[i];
+        }
+        label.swap(sortedLabel);
+        address.swap(sortedAddress);
+        kind.swap(sortedKind);
+        column.swap(sortedColumn);
+        line.swap(sortedLine);
+    };
+};
+
+
+
+// ChainTable: pendencias encadeadas no proprio codigo de maquina (montagem serial). a palavra de cada referencia pendente guarda o endereco
+// da referencia anterior ao mesmo rotulo (o rotulo so guarda o comeco da cadeia), o tipo da instrucao e se ha deslocamento:
+//     bits 0-1: tipo (0: instrucao padrao, 1: divisao, 2: pulo, 3: modifica a memoria)
+//     bit 2: se a referencia tem deslocamento (rotulo + n), guardado a parte
+//     bits 3-31: endereco da referencia anterior + 1 (0 termina a cadeia; cabem enderecos ate 2^29 - 2, entao a partir de CHAIN_LIMIT palavras
+//     as pendencias passam para a FixupTable, ver SymbolTable::unchain)
+// a tabela guarda so o que nao cabe na palavra: a linha e a coluna de cada referencia, procuradas pelo endereco so quando um erro eh reportado,
+// e os deslocamentos, que sao raros
+const int CHAIN_LIMIT = 1 << 28; // tamanho do codigo a partir do qual as pendencias deixam de ser encadeadas (com folga para as palavras da ultima linha)
+struct ChainTable {
+    // membros
+    std::vector<int> address; // endereco de cada referencia (em ordem crescente, como sao montadas)
+    std::vector<int> column; // posicao do rotulo na linha
+    std::vector<int> line; // linha da saida das macros
+    std::vector<int> offsetAddress; // enderecos das referencias com deslocamento (em ordem crescente)
+    std::vector<int> offset; // deslocamento de cada uma
+    // metodos
+    ChainTable () {};
+    // guarda uma referencia e devolve a palavra que a encadeia depois da referencia anterior
+    int push (int addr, int prev, int kind, int col, int ln, int off) {
+        address.push_back(addr);
+        column.push_back(col);
+        line.push_back(ln);
+        if (off != 0) {
+            offsetAddress.push_back(addr);
+            offset.push_back(off);
+        }
+        return (int) (((std::uint32_t) (prev+1) << 3) | ((off != 0) << 2) | kind);
+    };
+    int size () const { return address.size(); };
+    // campos da palavra encadeada
+    static int prev (int word) { return (int) ((std::uint32_t) word >> 3) - 1; };
+    static int kind (int word) { return word & 3; };
+    static int hasOffset (int word) { return (word >> 2) & 1; };
+    // posicao da referencia no endereco dado (busca binaria)
+    int find (int addr) const { return std::lower_bound(address.begin(), address.end(), addr) - address.begin(); };
+    // deslocamento da referencia no endereco dado (so para as que tem o bit de deslocamento)
+    int offsetAt (int addr) const { return offset[std::lower_bound(offsetAddress.begin(), offsetAddress.end(), addr) - offsetAddress.begin()]; };
+};
+
+
+
+// SymbolTable: tabela de simbolos da montagem. guarda os rotulos na ordem em que aparecem e um indice pelo identificador do nome
+struct SymbolTable {
+    // membros
+    std::vector<Label> labelList; // lista de rotulos, na ordem de insercao
+    Interner *symbols; // nomes dos simbolos
+    std::vector<int> index; // identificador do nome -> posicao na lista de rotulos (-1 se nao esta na tabela)
+    FixupTable fixups; // pendencias dos rotulos, na ordem em que foram feitas
+    int chained; // 1: as pendencias ficam encadeadas no codigo de maquina (refs), 0: ficam em fixups (montagem em blocos e incremental, que realocam cada uma, e em fluxo, com o codigo no disco)
+    ChainTable refs; // linha, coluna e deslocamento das pendencias encadeadas
+    std::vector<int> resolvedList; // enderecos que receberam o valor de um rotulo ja definido (para a montagem em blocos realocar)
+    int lineNum; // linha da saida das macros sendo montada (vai para as pendencias feitas nela)
     // metodos
-    Label () {};
-    Label (std::string nm, std::string eq): name(nm), equ(eq) {};
+    SymbolTable (): symbols(nullptr), chained(0), lineNum(0) {};
+    SymbolTable (Interner &sym): symbols(&sym), chained(0), lineNum(0) {};
+    // procura um rotulo pelo nome (ou pelo identificador do nome). retorna a posicao na lista ou -1 se nao encontrar
+    int find (std::string_view name) const { return find(symbols->find(name)); };
+    int find (std::uint32_t id) const {
+        return (id == NO_SYMBOL || id >= index.size()) ? -1 : index[id];
+    };
+    // insere um rotulo novo (que ainda nao esta na tabela), ainda nao definido, e retorna a posicao dele
+    // (pelo identificador a tabela de nomes so eh lida, entao varias tabelas podem usar a mesma ao mesmo tempo)
+    int insert (std::string_view name) { return insert(symbols->intern(name)); };
+    int insert (std::uint32_t id) {
+        Label label;
+        label.id = id;
+        if (label.id >= index.size())
+            index.resize(label.id+1, -1);
+        index[label.id] = labelList.size();
+        labelList.push_back(label);
+        return labelList.size()-1;
+    };
+    // define um rotulo no endereco dado, criando ou completando uma entrada pendente. retorna a posicao ou -1 se ja estava definido
+    int define (std::uint32_t id, int value) {
+        int found = find(id);
+        if (found >= 0 && labelList[found].isDefined)
+            return -1;
+        if (found < 0)
+            found = insert(id);
+        labelList[found].value = value;
+        labelList[found].isDefined = 1;
+        labelList[found].vectSize = 0; // indica que é rotulo da area de texto (pode mudar se for chamada uma diretiva da área de dados)
+        labelList[found].isConst = 0;
+        return found;
+    };
+    // adiciona uma pendencia ao rotulo, criando uma entrada nao definida se ele ainda nao existir. retorna a palavra que vai no codigo de maquina:
+    // o deslocamento ou, com as pendencias encadeadas, o elo para a referencia anterior (o rotulo passa a apontar para esta)
+    int addPending (std::uint32_t id, int address, int auxInfo, int pos, int offset) {
+        int found = find(id);
+        if (found < 0)
+            found = insert(id);
+        if (!chained) {
+            fixups.push(found, address, auxInfo, pos, lineNum);
+            return offset;
+        }
+        int word = refs.push(address, labelList[found].chain, auxInfo, pos, lineNum, offset);
+        labelList[found].chain = address;
+        return word;
+    };
+    // passa as pendencias encadeadas no codigo dado para a tabela, na ordem em que foram feitas, e deixa as proximas na tabela tambem
+    // (para codigos maiores que os elos alcancam. as palavras voltam a ter so o deslocamento, como se tivessem sido feitas sem encadear)
+    void unchain (std::vector<int> &code) {
+        std::vector<int> owner (refs.size()); // rotulo de cada referencia
+        for (unsigned int i = 0; i < labelList.size(); ++i) {
+            for (int addr = labelList[i].chain; addr >= 0; addr = ChainTable::prev(code[addr]))
+                owner[refs.find(addr)] = i;
+            labelList[i].chain = -1;
+        }
+        for (int r = 0; r < refs.size(); ++r) {
+            int addr = refs.address[r], word = code[addr];
+            fixups.push(owner[r], addr, ChainTable::kind(word), refs.column[r], refs.line[r]);
+            code[addr] = ChainTable::hasOffset(word) ? refs.offsetAt(addr) : 0;
+        }
+        refs = ChainTable();
+        chained = 0;
+    };
+    // numero de pendencias feitas (na tabela ou encadeadas)
+    int numPending () const { return chained ? refs.size() : fixups.size(); };
+    // acesso direto aos rotulos
+    Label& operator[] (int i) { return labelList[i]; };
+    // nome do rotulo na posicao dada
+    std::string_view name (int i) const { return symbols->name(labelList[i].id); };
+    int size () const { return labelList.size(); };
 };
 
 
@@ -73,13 +425,248 @@ struct Label {
 // Macro: armazena uma macro e suas caracteristcas
 struct Macro {
     // membros
-    std::string name; // nome da macro
-    std::string definition; // definicao da macro
+    std::uint32_t id; // identificador do nome da macro (ver Interner)
+    std::string_view definition; // definicao da macro (o texto fica guardado uma vez so, no estado da passagem de macros)
+    std::vector<std::string_view> body; // linhas da definicao, ja separadas (pedacos de 'definition')
+    std::vector<Token> tokens; // tokens de todas as linhas da definicao
+    std::vector<int> firstToken; // linha da definicao -> primeiro token dela em 'tokens' (com uma posicao a mais no final)
     int initLine; // linha inicial da macro
     int numLines; // quantas linhas tem a macro
     // metodos
     Macro () {};
-    Macro (std::string nm, std::string df, int ln, int nl): name(nm), definition(df), initLine(ln), numLines(nl) {};
+    Macro (std::uint32_t nm, std::string_view df, int ln, int nl): id(nm), definition(df), initLine(ln), numLines(nl) {
+        std::size_t begin = 0;
+        while (begin < definition.size()) {
+            std::size_t end = definition.find('\n', begin);
+            if (end == std::string_view::npos)
+                end = definition.size();
+            body.push_back(definition.substr(begin, end-begin));
+            begin = end+1;
+        }
+    };
+    // linha da definicao com os tokens dela
+    TokenLine line (int k) const { return TokenLine (body[k], tokens.data() + firstToken[k], firstToken[k+1] - firstToken[k]); };
+};
+
+
+
+// LineRange: intervalo de linhas consecutivas de uma saida que vieram de linhas consecutivas da entrada
+struct LineRange {
+    // membros
+    int first; // primeira linha da saida no intervalo
+    int source; // linha da entrada que corresponde a 'first'
+    int count; // quantas linhas tem o intervalo
+    // metodos
+    LineRange () {};
+    LineRange (int fst, int src, int cnt): first(fst), source(src), count(cnt) {};
+};
+
+
+
+// LineMap: dicionario de linhas (linha de uma saida -> linha da entrada) guardado em intervalos de linhas consecutivas, com busca binaria
+struct LineMap {
+    // membros
+    std::vector<LineRange> ranges; // intervalos, em ordem, cobrindo as linhas [1, count]
+    int count; // quantas linhas de saida ja estao no dicionario
+    // metodos
+    LineMap (): count(0) {};
+    int size () const { return count; };
+    int empty () const { return count == 0; };
+    // linha da entrada da saida de indice 'index' (a partir de 0, como num vetor). o ultimo intervalo, o mais procurado durante as passagens, nao precisa da busca
+    int operator[] (int index) const {
+        int line = index+1;
+        if (line < 1 || line > count)
+            return 0;
+        if (line >= ranges.back().first)
+            return ranges.back().source + (line - ranges.back().first);
+        auto range = std::upper_bound(ranges.begin(), ranges.end(), line, [] (int l, const LineRange &r) { return l < r.first; }) - 1;
+        return range->source + (line - range->first);
+    };
+    // anexa 'n' linhas vindas das linhas da entrada a partir de 'source' (juntando com o intervalo anterior quando continua ele)
+    void append (int source, int n) {
+        if (n <= 0)
+            return;
+        if (!ranges.empty() && ranges.back().source + ranges.back().count == source)
+            ranges.back().count += n;
+        else
+            ranges.push_back(LineRange (count+1, source, n));
+        count += n;
+    };
+    void push_back (int source) { append(source, 1); };
+    // troca as entradas [first, last) pelas linhas 'sources' e soma 'shift' as linhas da entrada maiores que 'after' nas entradas seguintes
+    void splice (int first, int last, const std::vector<int> &sources, int after, int shift) {
+        LineMap result;
+        for (unsigned int r = 0; r < ranges.size(); ++r) {
+            int begin = ranges[r].first-1, end = begin + ranges[r].count;
+            if (begin < first)
+                result.append(ranges[r].source, std::min(end, first) - begin);
+        }
+        for (unsigned int i = 0; i < sources.size(); ++i)
+            result.push_back(sources[i]);
+        for (unsigned int r = 0; r < ranges.size(); ++r) {
+            int begin = std::max(ranges[r].first-1, last), end = ranges[r].first-1 + ranges[r].count;
+            int source = ranges[r].source + (begin - (ranges[r].first-1)), n = end - begin;
+            if (n <= 0)
+                continue;
+            int kept = std::min(n, std::max(0, after - source + 1)); // linhas ate 'after', que nao andam
+            result.append(source, kept);
+            result.append(source + kept + shift, n - kept);
+        }
+        ranges.swap(result.ranges);
+        count = result.count;
+    };
+};
+
+
+
+// LineDict: dicionario de linhas da saida das macros ate o '.asm', composto de dois dicionarios so quando uma linha eh consultada (nas mensagens de erro)
+struct LineDict {
+    // membros
+    const LineMap *outer; // linha da saida das macros -> linha da saida do preprocessamento (ou direto -> linha do '.asm', se 'inner' for nullptr)
+    const LineMap *inner; // linha da saida do preprocessamento -> linha do '.asm'
+    // metodos
+    LineDict (const LineMap &map): outer(&map), inner(nullptr) {};
+    LineDict (const LineMap &out, const LineMap &in): outer(&out), inner(&in) {};
+    int size () const { return outer->size(); };
+    // linha do '.asm' da linha de indice 'index' da saida das macros (a partir de 0; 0 se nao estiver no dicionario)
+    int operator[] (int index) const {
+        int line = (*outer)[index];
+        return (inner && line > 0) ? (*inner)[line-1] : line;
+    };
+    // dicionario ja composto (para guardar sem depender dos dicionarios das passagens)
+    LineMap compose () const {
+        if (!inner)
+            return *outer;
+        LineMap result;
+        for (unsigned int r = 0; r < outer->ranges.size(); ++r) {
+            const LineRange &range = outer->ranges[r];
+            int line = range.source, end = range.source + range.count; // linhas [line, end) da saida do preprocessamento
+            auto piece = std::upper_bound(inner->ranges.begin(), inner->ranges.end(), line, [] (int l, const LineRange &i) { return l < i.first; });
+            if (piece == inner->ranges.begin())
+                continue;
+            for (--piece; line < end && piece != inner->ranges.end(); ++piece) {
+                int n = std::min(end, piece->first + piece->count) - line;
+                result.append(piece->source + (line - piece->first), n);
+                line += n;
+            }
+        }
+        return result;
+    };
+};
+
+
+
+// marcas de uma linha do '.asm' no LineTrace
+const char TRACE_OUTPUT = 1; // a linha gerou uma linha da saida do preprocessamento
+const char TRACE_SPECIAL = 2; // o resultado da linha depende de outras linhas ou muda o das seguintes (EQU, IF, macros, rotulo sozinho, linhas com erro)
+const char TRACE_PRE_OPEN = 4; // o preprocessamento ainda usou a linha seguinte para terminar o que comecou nesta
+const char TRACE_MCR_OPEN = 8; // depois desta linha, a passagem de macros ainda dependia dela (definicao ou chamada de macro em andamento)
+
+// LineTrace: registro do que as passagens de preprocessamento e de macros fizeram com cada linha do '.asm' (usado pela montagem incremental)
+struct LineTrace {
+    // membros
+    std::vector<char> flags; // linha do '.asm' -> marcas (TRACE_*)
+    std::vector<int> errors; // linha do '.asm' -> quantos erros ja tinham sido encontrados quando ela comecou a ser processada
+    std::vector<int> outputs; // linha do '.asm' -> quantas linhas a passagem de macros entregou por causa dela
+    std::vector<int> entries; // linha do '.asm' -> quantas entradas ela colocou no dicionario de linhas composto
+    std::vector<int> equLines; // linha onde cada EQU foi definido, na ordem das definicoes
+    std::vector<std::uint32_t> equIds; // rotulo de cada EQU
+    // metodos
+    LineTrace () {};
+    // registra um grupo de linhas [first, last] que o preprocessamento tratou junto
+    void preGroup (int first, int last, int numErrors, int produced, int special) {
+        if (last > (int) flags.size()) {
+            flags.resize(last, 0);
+            errors.resize(last, 0);
+            outputs.resize(last, 0);
+            entries.resize(last, 0);
+        }
+        for (int i = first; i <= last; ++i) {
+            flags[i-1] = (first < last || special) ? TRACE_SPECIAL : 0;
+            if (i < last)
+                flags[i-1] |= TRACE_PRE_OPEN;
+            errors[i-1] = numErrors;
+        }
+        if (produced)
+            flags[last-1] |= TRACE_OUTPUT;
+    };
+    // registra as linhas [first, last] da saida do preprocessamento que a passagem de macros tratou juntas (lineDict leva ao '.asm')
+    void mcrGroup (const LineMap &lineDict, int first, int last, int numOutputs, int numEntries, int plain, int open) {
+        for (int k = first; k <= last && k <= lineDict.size(); ++k) {
+            int source = lineDict[k-1];
+            if (!plain)
+                flags[source-1] |= TRACE_SPECIAL;
+            if (k < last || open)
+                flags[source-1] |= TRACE_MCR_OPEN;
+            if (k == first) {
+                outputs[source-1] += numOutputs;
+                entries[source-1] += numEntries;
+            }
+        }
+    };
+};
+
+
+
+// etapas medidas pelo RunStats (as tres primeiras puxam as linhas umas das outras, entao o tempo de cada uma nao inclui o das que ela puxa)
+const int STATS_PRE = 0; // preprocessamento
+const int STATS_MCR = 1; // passagem de macros
+const int STATS_ASM = 2; // montagem das linhas
+const int STATS_FIXUP = 3; // resolucao das pendencias
+const int STATS_OUTPUT = 4; // escrita do '.o'
+const int STATS_NUM_STAGES = 5;
+const char* const STATS_STAGE_NAMES[STATS_NUM_STAGES] = {"pre", "mcr", "asm", "fixup", "output"};
+
+// RunStats: tempo e contadores de uma execucao, preenchidos pelas passagens quando pedidos (--stats)
+struct RunStats {
+    // membros
+    double seconds[STATS_NUM_STAGES]; // tempo de cada etapa
+    long long linesIn[STATS_NUM_STAGES], linesOut[STATS_NUM_STAGES]; // o que cada etapa recebeu e entregou (linhas, pendencias, palavras ou bytes)
+    double total; // tempo da execucao inteira
+    long long equs, macros, expansions, labels, fixups, errors, words; // EQU definidos, macros definidas, chamadas expandidas, rotulos definidos, pendencias, erros e palavras do codigo de maquina
+    long long bytesRead, bytesWritten; // tamanho do '.asm' e dos arquivos escritos
+    int stage; // etapa sendo medida agora (-1 se nenhuma)
+    std::chrono::steady_clock::time_point mark; // quando a etapa atual comecou a ser medida
+    // metodos
+    RunStats (): total(0), equs(0), macros(0), expansions(0), labels(0), fixups(0), errors(0), words(0), bytesRead(0), bytesWritten(0), stage(-1) {
+        for (int i = 0; i < STATS_NUM_STAGES; ++i) {
+            seconds[i] = 0;
+            linesIn[i] = 0;
+            linesOut[i] = 0;
+        }
+    };
+    // passa a medir o tempo na etapa dada (-1: nenhuma) e retorna a que estava sendo medida, para voltar para ela depois
+    int enter (int next) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (stage >= 0)
+            seconds[stage] += std::chrono::duration<double>(now - mark).count();
+        int previous = stage;
+        stage = next;
+        mark = now;
+        return previous;
+    };
+};
+
+
+
+// RunArena: memoria de uma montagem inteira. o que eh alocado nela (as linhas guardadas para as mensagens de erro, por exemplo) nao eh liberado linha a linha, e sim tudo de uma vez quando a montagem acaba
+struct RunArena {
+    // membros
+    std::pmr::monotonic_buffer_resource resource; // blocos cada vez maiores, pedidos ao new e devolvidos todos no destrutor
+    // metodos
+    RunArena (): resource(1 << 16) {};
+    RunArena (const RunArena&) = delete;
+    RunArena& operator= (const RunArena&) = delete;
+    // recurso de memoria para os containers da montagem (std::pmr)
+    std::pmr::memory_resource* get () { return &resource; };
+    // copia o texto para a arena e retorna a copia (que vale ate o fim da montagem)
+    std::string_view copy (std::string_view text) {
+        if (text.empty())
+            return std::string_view();
+        char *chars = (char*) resource.allocate(text.size(), 1);
+        memcpy(chars, text.data(), text.size());
+        return std::string_view(chars, text.size());
+    };
 };
 
 
@@ -94,5 +681,41 @@ struct Error {
     int pos; // posição na linha do erro
     // metodos
     Error () {};
-    Error (std::string msg, std::string tp, int lnn, std::string ln, int ps=0): message(msg), type(tp), lineNum(lnn), line(ln), pos(ps) {};
+    Error (std::string msg, std::string tp, int lnn, std::string_view ln, int ps=0): message(std::move(msg)), type(std::move(tp)), lineNum(lnn), line(ln), pos(ps) {};
+};
+
+
+
+// Options: argumentos da linha de comando
+struct Options {
+    // membros
+    std::string operation; // tipo de operacao (-p, -m ou -o)
+    std::string inFileName; // nome do arquivo de entrada '.asm'
+    std::string outFileName; // nome do arquivo de saida '.o'
+    std::string instrFileName; // tabela de instrucoes lida de arquivo (vazio: usa a embutida)
+    std::string dirFileName; // tabela de diretivas lida de arquivo (vazio: usa a embutida)
+    int keepIntermediates; // se deve escrever os arquivos '.pre' e '.mcr' mesmo na montagem
+    int batch; // modo em lote: varios arquivos de entrada montados em paralelo
+    int jobs; // numero de threads do modo em lote ou da montagem em blocos (0: numero de nucleos da maquina)
+    int parallel; // montagem de um arquivo so dividida em blocos montados em paralelo
+    int binary; // escreve o '.o' no formato binario (cabecalho e palavras em little endian) em vez de texto
+    int incremental; // guarda o estado da montagem e, na proxima, so processa de novo as linhas editadas
+    int stream; // montagem em fluxo: o codigo vai para o disco enquanto eh montado e as pendencias sao corrigidas no arquivo (memoria limitada)
+    std::string runFileName; // arquivo '.o' a ser executado pelo simulador (vazio: nao simula)
+    int jit; // no simulador, traduz o codigo para codigo nativo em vez de interpretar
+    std::string generateFileName; // arquivo '.asm' onde o gerador escreve um programa (vazio: nao gera)
+    int lines; // linhas de instrucao do programa gerado (0: padrao do gerador)
+    std::string mix; // composicao do programa gerado ("chave=valor,..."; ver GenConfig)
+    int bench; // mede o tempo de cada passagem sobre programas gerados
+    std::vector<int> benchSizes; // tamanhos dos programas medidos (vazio: os padroes)
+    int stats; // mostra o tempo e os contadores de cada etapa depois da execucao
+    std::string statsFileName; // arquivo onde as estatisticas sao escritas em JSON ('-': saida padrao; vazio: nao escreve)
+    int maxErrors; // com esse numero de erros o arquivo para de ser processado e so eles sao mostrados (0: sem limite)
+    int machineErrors; // mostra os erros sem cores, um por linha, no formato "arquivo:linha:coluna: erro tipo: mensagem"
+    std::string serverPath; // socket unix do modo servidor ('-': entrada e saida padrao; vazio: fora do modo servidor)
+    std::string manifestFileName; // arquivo com a lista de pares entrada/saida do modo em lote
+    std::vector<std::string> inFileNames; // arquivos de entrada do modo em lote
+    std::vector<std::string> outFileNames; // arquivos de saida correspondentes
+    // metodos
+    Options (): keepIntermediates(0), batch(0), jobs(0), parallel(0), binary(0), incremental(0), stream(0), jit(0), lines(0), bench(0), stats(0), maxErrors(0), machineErrors(0) {};
 };
\ No newline at end of file
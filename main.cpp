@@ -1,69 +1,115 @@
 #include "include/types.h"
+#include "include/src.h"
+#include "include/tab.h"
+#include "include/obj.h"
 #include "include/common.h"
 #include "include/pre.h"
 #include "include/mcr.h"
 #include "include/asm.h"
+#include "include/par.h"
+#include "include/inc.h"
+#include "include/stm.h"
+#include "include/batch.h"
+#include "include/srv.h"
+#include "include/sim.h"
+#include "include/jit.h"
+#include "include/bench.h"
 
 // compilar com
-// g++ -std=c++11 -Wall main.cpp -o main.out
+// g++ -std=c++17 -Wall -pthread main.cpp -o main.out
 // ou entao com CTRL SHIFT B no VSCODE
 
 // rodar com
-// ./main.out -x xxx.asm yyy.o
+// ./main.out [--instr-table tabl/tabInstr.txt] [--dir-table tabl/tabDir.txt] -x xxx.asm yyy.o
+// ou, no modo em lote
+// ./main.out --batch [--jobs n] [--manifest lista.txt] -x aaa.asm bbb.asm ...
+// ou, para montar um arquivo muito grande em paralelo
+// ./main.out --parallel [--jobs n] -o xxx.asm yyy.o
+// ou, para montar de novo so as linhas editadas desde a ultima montagem (guarda o estado em yyy.state)
+// ./main.out --incremental -o xxx.asm yyy.o
+// ou, para montar um arquivo muito grande com pouca memoria (o codigo vai para o disco enquanto eh montado)
+// ./main.out --stream -o xxx.asm yyy.o
+// ou, como servidor, com as tabelas carregadas uma vez, atendendo requisicoes num socket unix (ou na entrada/saida padrao, com '-')
+// ./main.out --server /tmp/sb.sock
+// ou, para executar um arquivo objeto no simulador
+// ./main.out --run [--jit] yyy.o
+// ou, para gerar um programa grande
+// ./main.out --generate xxx.asm [--lines n] [--mix labels=10,forward=50,...]
+// ou, para medir cada passagem sobre programas gerados
+// ./main.out --bench [--sizes 10000,100000] [--mix ...]
+// e, numa execucao normal, --stats (ou --stats-json arquivo.json) mostra o tempo e os contadores de cada etapa
 
 int main (int argc, char *argv[]) {
     
-    // nomes dos arquivos contendo as tabelas de intrucoes e diretivas
-    std::string instrFileName ("tabl/tabInstr.txt"),
-        dirFileName ("tabl/tabDir.txt");
+    // checa se houveram erros e le as opcoes
+    Options options;
+    if (errorCheck(argc, argv, options) == -1)
+        return 0;
+    
+    // constroi as tabelas de instrucoes e de diretivas (embutidas, a menos que tenha sido pedido um arquivo)
+    Tables tables = getTables (options.instrFileName, options.dirFileName);
     
-    // checa se houveram erros
-    if (errorCheck(argc, argv, instrFileName, dirFileName) == -1)
+    // simulador: executa o arquivo objeto
+    if (!options.runFileName.empty()) {
+        runSimulator (options, tables);
         return 0;
-            
-    // constroi a lista de instrucoes e de diretivas
-    std::vector<Instr> instrList = getInstrList (instrFileName);
-    std::vector<Dir> dirList = getDirList (dirFileName);
+    }
     
-    // coloca os argumentos em strings
-    std::string operation ( *(argv+1) ),
-        inFileName ( *(argv+2) ),
-        outFileName ( *(argv+3) );
+    // gerador: escreve um programa sintetico
+    if (!options.generateFileName.empty()) {
+        runGenerator (options);
+        return 0;
+    }
+    
+    // medicao: tempo e memoria de cada passagem sobre programas gerados
+    if (options.bench) {
+        runBench (options, tables);
+        return 0;
+    }
     
-    // cria os nomes dos arquivos com as extensoes '.pre' e '.mcr'
-    std::string preFileName (o2pre(outFileName)),
-        mcrFileName (o2mcr(outFileName));
+    // modo servidor: atende requisicoes de montagem ate ser terminado
+    if (!options.serverPath.empty()) {
+        runServer (options, tables);
+        return 0;
+    }
     
-    // cria o dicionario de linhas para o preprocessamento, para a passagem de macros e o dicionario composto dos dois
-    // o indice representa a linha atual, e o valor no indice é a linha original
-    std::vector<int> lineDictPre;
-    std::vector<int> lineDictMcr;
-    std::vector<int> lineDict;
+    // modo em lote: monta todos os arquivos em paralelo e mostra os erros agrupados por arquivo
+    if (options.batch) {
+        runBatch (options, tables);
+        return 0;
+    }
     
     // lista de erros a serem mostrados no final da execução
     std::vector<Error> errorList;
     
-    // passagem de pre processamento
-    if (operation == "-p" || operation == "-m" || operation == "-o")
-        preProcessFile (inFileName, preFileName, lineDictPre, instrList, dirList, errorList);
-    
-    // passagem de macros
-    if (operation == "-m" || operation == "-o")
-        expandMacros (preFileName, mcrFileName, lineDictMcr, lineDictPre, instrList, dirList, errorList);
+    // estatisticas da execucao (so preenchidas se pedidas)
+    RunStats stats;
+    int wantStats = options.stats || !options.statsFileName.empty();
     
-    // faz o dicionario "composto"
-    for (unsigned int i = 0; i < lineDictMcr.size(); ++i)
-        lineDict.push_back(lineDictPre[lineDictMcr[i]-1]);
+    // executa as passagens pedidas sobre o arquivo de entrada
+    int stopped = processFile(options.operation, options.inFileName, options.outFileName, options, tables, errorList, wantStats ? &stats : nullptr);
     
-    // passagem normal
-    if (operation == "-o")
-        assembleCode (mcrFileName, outFileName, lineDict, instrList, dirList, errorList);
-    
-    // coloca os erros na ordem, de acordo com o número da linha
-    std::sort (errorList.begin(), errorList.end());
+    // coloca os erros na ordem, de acordo com o número da linha (e fica so com os primeiros, se houver limite)
+    sortErrors (errorList);
+    std::string notice = limitErrors(errorList, options.maxErrors, stopped);
         
     // mostra todos os erros no terminal
-    reportList (errorList);
+    reportList (errorList, std::cout, options.inFileName, options.machineErrors);
+    std::cout << notice;
+        
+    // mostra (ou escreve em JSON) o tempo e os contadores de cada etapa
+    if (options.stats)
+        statsReport (stats, std::cout);
+    if (options.statsFileName == "-")
+        statsJson (stats, std::cout);
+    else if (!options.statsFileName.empty()) {
+        std::ofstream statsFile (options.statsFileName);
+        if (!statsFile.is_open()) {
+            std::cout << "Erro ao criar o arquivo: " << options.statsFileName << "\n";
+            return 1;
+        }
+        statsJson (stats, statsFile);
+    }
         
     return 0;
     